@@ -0,0 +1,237 @@
+// Times common::compressBlocks on every format and quality preset, on one
+// thread and banded over the job system, and measures the PSNR of the
+// result against the source image.
+//
+// Usage: bc-encode-bench [-n iterations] [-q quality] [file.tga | directory]...
+// With no paths given the asset directory is scanned for .tga files.
+// quality is 0 fast, 1 normal or 2 high, every preset is run if it's left out.
+// PSNR only counts the channels a format keeps, RGB for BC1, R for BC4, RG for BC5.
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <string>
+
+#include "../src/Common/settings.hpp"
+#include "../src/Common/bcn.hpp"
+#include "../src/Engine/jobs.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_TGA
+#include "../src/Common/stb_image.h"
+
+// Same band size the texture cook uses
+#define COOK_BAND_BLOCKS 1024
+
+static const common::BlockFormat FORMATS[] =
+{
+    common::BlockFormat::BC1, common::BlockFormat::BC3, common::BlockFormat::BC4,
+    common::BlockFormat::BC5, common::BlockFormat::BC7
+};
+
+static const char *QUALITY_NAMES[] = { "fast", "normal", "high" };
+
+static double bestOf(int iterations, const std::function<void()> &function)
+{
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+static int keptChannels(common::BlockFormat format)
+{
+    switch (format)
+    {
+        case common::BlockFormat::BC1:
+            return 3;
+        case common::BlockFormat::BC4:
+            return 1;
+        case common::BlockFormat::BC5:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+static double psnr(double squaredError, double samples)
+{
+    if (squaredError == 0.0) return 99.0;
+    return 10.0 * std::log10(255.0 * 255.0 * samples / squaredError);
+}
+
+// Totals of one format and preset over every file
+struct Totals
+{
+    double pixels = 0;
+    double singleMs = 0;
+    double bandedMs = 0;
+    double squaredError = 0;
+    double samples = 0;
+};
+
+int main(int argc, char **argv)
+{
+    int iterations = 3;
+    int onlyQuality = -1;
+    std::vector<std::string> roots;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            iterations = std::max(1, std::atoi(argv[++i]));
+            continue;
+        }
+        if (std::strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+        {
+            onlyQuality = std::atoi(argv[++i]);
+            continue;
+        }
+        roots.push_back(argv[i]);
+    }
+
+    if (onlyQuality > 2)
+    {
+        std::cout << "quality must be 0, 1 or 2\n";
+        return 1;
+    }
+
+    if (roots.empty()) roots.push_back(common::settings::ASSET_DIR);
+
+    std::vector<std::string> files;
+    for (const std::string &root : roots)
+    {
+        if (std::filesystem::is_directory(root))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".tga")
+                {
+                    files.push_back(entry.path().generic_string());
+                }
+            }
+        }
+        else if (std::filesystem::is_regular_file(root))
+        {
+            files.push_back(root);
+        }
+    }
+
+    if (files.empty())
+    {
+        std::cout << "No .tga files found\n";
+        return 1;
+    }
+
+    JobSystem &jobs = JobSystem::Get();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Best of " << iterations << " runs, " << jobs.WorkerCount() << " workers\n\n";
+    std::cout << std::setw(7) << "format" << std::setw(8) << "quality" << std::setw(11) << "1T MPix/s"
+        << std::setw(11) << "MT MPix/s" << std::setw(9) << "PSNR" << "  file\n";
+
+    Totals totals[sizeof(FORMATS) / sizeof(FORMATS[0])][3];
+    size_t skipped = 0;
+
+    for (const std::string &path : files)
+    {
+        int width, height, fileChannels;
+        stbi_uc *rgba = stbi_load(path.c_str(), &width, &height, &fileChannels, 4);
+        if (!rgba)
+        {
+            std::cout << std::setw(46) << "unreadable  " << path << "\n";
+            skipped++;
+            continue;
+        }
+
+        double pixels = (double) width * height;
+        int blocksWide = (width + 3) / 4;
+        int blocksHigh = (height + 3) / 4;
+        size_t bandRows = std::max((size_t) 1, (size_t) (COOK_BAND_BLOCKS / blocksWide));
+        std::vector<uint8_t> decoded((size_t) width * height * 4);
+
+        for (size_t f = 0; f < sizeof(FORMATS) / sizeof(FORMATS[0]); f++)
+        {
+            common::BlockFormat format = FORMATS[f];
+            std::vector<uint8_t> blocks(common::compressedSize(format, width, height));
+
+            for (int q = 0; q < 3; q++)
+            {
+                if (onlyQuality >= 0 && q != onlyQuality) continue;
+                common::BlockQuality quality = (common::BlockQuality) q;
+
+                double singleMs = bestOf(iterations, [&]()
+                {
+                    common::compressBlocks(format, quality, rgba, width, height, blocks.data(), 0, blocksHigh);
+                });
+
+                double bandedMs = bestOf(iterations, [&]()
+                {
+                    jobs.ParallelFor(0, blocksHigh, bandRows, [&](size_t begin, size_t end)
+                    {
+                        common::compressBlocks(format, quality, rgba, width, height, blocks.data(),
+                            (int) begin, (int) (end - begin));
+                    });
+                });
+
+                common::decompressBlocks(format, blocks.data(), width, height, decoded.data(), 0, blocksHigh);
+
+                int channels = keptChannels(format);
+                double squaredError = 0;
+                for (size_t i = 0; i < (size_t) width * height; i++)
+                {
+                    for (int c = 0; c < channels; c++)
+                    {
+                        double difference = (double) rgba[i * 4 + c] - decoded[i * 4 + c];
+                        squaredError += difference * difference;
+                    }
+                }
+                double samples = pixels * channels;
+
+                Totals &total = totals[f][q];
+                total.pixels += pixels;
+                total.singleMs += singleMs;
+                total.bandedMs += bandedMs;
+                total.squaredError += squaredError;
+                total.samples += samples;
+
+                std::cout << std::setw(6) << "BC" << (uint32_t) format << std::setw(8) << QUALITY_NAMES[q]
+                    << std::setw(11) << pixels / 1000.0 / singleMs << std::setw(11) << pixels / 1000.0 / bandedMs
+                    << std::setw(9) << psnr(squaredError, samples) << "  " << path
+                    << " (" << width << "x" << height << ")\n";
+            }
+        }
+
+        stbi_image_free(rgba);
+    }
+
+    std::cout << "\n";
+    for (size_t f = 0; f < sizeof(FORMATS) / sizeof(FORMATS[0]); f++)
+    {
+        for (int q = 0; q < 3; q++)
+        {
+            const Totals &total = totals[f][q];
+            if (total.pixels == 0) continue;
+
+            std::cout << std::setw(6) << "BC" << (uint32_t) FORMATS[f] << std::setw(8) << QUALITY_NAMES[q]
+                << std::setw(11) << total.pixels / 1000.0 / total.singleMs
+                << std::setw(11) << total.pixels / 1000.0 / total.bandedMs
+                << std::setw(9) << psnr(total.squaredError, total.samples) << "  total ("
+                << files.size() - skipped << " files)\n";
+        }
+    }
+
+    return 0;
+}
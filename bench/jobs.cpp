@@ -0,0 +1,98 @@
+// Job system microbenchmark: per job scheduling overhead and
+// parallel-for scaling from 1 thread (main only) up to N.
+//
+// Usage: jobs-bench [max threads]
+
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "../src/Engine/jobs.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Empty jobs, so all we measure is push, pop/steal and counter traffic
+static double emptyJobOverheadNs(JobSystem &jobs, size_t jobCount)
+{
+    double best = 1e30;
+    for (int run = 0; run < 5; run++)
+    {
+        auto start = Clock::now();
+
+        JobCounter counter;
+        for (size_t i = 0; i < jobCount; i++)
+        {
+            jobs.Run([]() {}, &counter);
+        }
+        jobs.Wait(counter);
+
+        best = std::min(best, elapsedMs(start));
+    }
+    return best * 1e6 / (double) jobCount;
+}
+
+// Roughly vertex processing sized work per element
+static double parallelForMs(JobSystem &jobs, std::vector<float> &data, size_t grainSize)
+{
+    double best = 1e30;
+    for (int run = 0; run < 5; run++)
+    {
+        auto start = Clock::now();
+
+        jobs.ParallelFor(0, data.size(), grainSize, [&data](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                float value = data[i];
+                for (int k = 0; k < 32; k++)
+                {
+                    value = std::sqrt(value * value + 1.0f) * 0.5f;
+                }
+                data[i] = value;
+            }
+        });
+
+        best = std::min(best, elapsedMs(start));
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = (int) std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1) maxThreads = std::max(1, std::atoi(argv[1]));
+
+    const size_t emptyJobCount = 200000;
+    const size_t grainSize = 4096;
+    std::vector<float> data(4 * 1024 * 1024, 1.0f);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "ns/empty job"
+        << std::setw(18) << "parallel for ms" << std::setw(10) << "speedup\n";
+
+    double singleThreadMs = 0;
+    for (int threads = 1; threads <= maxThreads; threads++)
+    {
+        // The main thread works too while it waits
+        JobSystem jobs(threads - 1);
+
+        double overhead = emptyJobOverheadNs(jobs, emptyJobCount);
+        double forMs = parallelForMs(jobs, data, grainSize);
+        if (threads == 1) singleThreadMs = forMs;
+
+        std::cout << std::setw(8) << threads << std::setw(16) << overhead
+            << std::setw(18) << forMs << std::setw(9) << singleThreadMs / forMs << "x\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Compares the ifstream and memory mapped PSK loaders on the same files.
+//
+// Usage: psk-loader-bench [-n iterations] [file.psk | directory]...
+// With no paths given the asset directory is scanned for .psk files.
+
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+
+#include "../src/Common/settings.hpp"
+#include "../src/Engine/UAM/psk.hpp"
+
+using namespace uam;
+
+typedef PSK_MeshData *(*LoaderFn)(const std::string &);
+
+static double timeLoader(LoaderFn loader, const std::string &path, int iterations)
+{
+    // Both loaders log; keep that out of the numbers we print
+    std::ostringstream sink;
+    std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf());
+
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        PSK_MeshData *data = loader(path);
+        auto end = std::chrono::steady_clock::now();
+        delete data;
+
+        sink.str("");
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::cout.rdbuf(coutBuf);
+    return best;
+}
+
+static bool sameMesh(const PSK_MeshData &a, const PSK_MeshData &b)
+{
+    if (a.points.size() != b.points.size() || a.wedges.size() != b.wedges.size()
+        || a.faces.size() != b.faces.size() || a.materials.size() != b.materials.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.points.size(); i++)
+    {
+        if (std::memcmp(&a.points[i], &b.points[i], sizeof(PSK_Point)) != 0) return false;
+    }
+
+    for (size_t i = 0; i < a.wedges.size(); i++)
+    {
+        if (std::memcmp(&a.wedges[i], &b.wedges[i], sizeof(PSK_Wedge)) != 0) return false;
+    }
+
+    for (size_t i = 0; i < a.faces.size(); i++)
+    {
+        const PSK_Face &fa = a.faces[i];
+        const PSK_Face &fb = b.faces[i];
+        if (fa.wedge0 != fb.wedge0 || fa.wedge1 != fb.wedge1 || fa.wedge2 != fb.wedge2
+            || fa.materialIndex != fb.materialIndex || fa.auxMaterialIndex != fb.auxMaterialIndex
+            || fa.smoothingGroups != fb.smoothingGroups)
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.materials.size(); i++)
+    {
+        if (a.materials[i].name != b.materials[i].name) return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 5;
+    std::vector<std::string> roots;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            iterations = std::max(1, std::atoi(argv[++i]));
+            continue;
+        }
+        roots.push_back(argv[i]);
+    }
+
+    if (roots.empty()) roots.push_back(common::settings::ASSET_DIR);
+
+    std::vector<std::string> files;
+    for (const std::string &root : roots)
+    {
+        if (std::filesystem::is_directory(root))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".psk")
+                {
+                    files.push_back(entry.path().generic_string());
+                }
+            }
+        }
+        else if (std::filesystem::is_regular_file(root))
+        {
+            files.push_back(root);
+        }
+    }
+
+    if (files.empty())
+    {
+        std::cout << "No .psk files found\n";
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Best of " << iterations << " runs per loader\n\n";
+    std::cout << std::setw(12) << "ifstream ms" << std::setw(12) << "mapped ms" << std::setw(10) << "speedup" << "  file\n";
+
+    double totalStream = 0;
+    double totalMapped = 0;
+    bool allMatch = true;
+
+    for (const std::string &path : files)
+    {
+        double streamMs = timeLoader(loadPSK, path, iterations);
+        double mappedMs = timeLoader(loadPSKMapped, path, iterations);
+
+        std::ostringstream sink;
+        std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf());
+        PSK_MeshData *streamData = loadPSK(path);
+        PSK_MeshData *mappedData = loadPSKMapped(path);
+        std::cout.rdbuf(coutBuf);
+
+        bool match = sameMesh(*streamData, *mappedData);
+        allMatch = allMatch && match;
+        delete streamData;
+        delete mappedData;
+
+        totalStream += streamMs;
+        totalMapped += mappedMs;
+
+        std::cout << std::setw(12) << streamMs << std::setw(12) << mappedMs
+            << std::setw(9) << streamMs / std::max(mappedMs, 1e-6) << "x  " << path
+            << (match ? "" : "  (MISMATCH)") << "\n";
+    }
+
+    std::cout << "\n" << std::setw(12) << totalStream << std::setw(12) << totalMapped
+        << std::setw(9) << totalStream / std::max(totalMapped, 1e-6) << "x  total (" << files.size() << " files)\n";
+
+    return allMatch ? 0 : 2;
+}
@@ -0,0 +1,174 @@
+// Compares stb_image against common::decodeTga on the same files.
+// Both decode from the already mapped file so only decoding is timed.
+//
+// Usage: tga-decode-bench [-n iterations] [-c channels] [file.tga | directory]...
+// With no paths given the asset directory is scanned for .tga files.
+// channels defaults to 4, what the material texture arrays ask for.
+
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <string>
+
+#include "../src/Common/settings.hpp"
+#include "../src/Common/mappedfile.hpp"
+#include "../src/Common/tga.hpp"
+#include "../src/Engine/jobs.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_TGA
+#include "../src/Common/stb_image.h"
+
+// Same band size the engine uses
+#define TGA_BAND_BYTES (256 * 1024)
+
+static double bestOf(int iterations, const std::function<void()> &function)
+{
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 5;
+    int channels = 4;
+    std::vector<std::string> roots;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            iterations = std::max(1, std::atoi(argv[++i]));
+            continue;
+        }
+        if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            channels = std::atoi(argv[++i]);
+            continue;
+        }
+        roots.push_back(argv[i]);
+    }
+
+    if (channels != 0 && channels != 1 && channels != 3 && channels != 4)
+    {
+        std::cout << "channels must be 0, 1, 3 or 4\n";
+        return 1;
+    }
+
+    if (roots.empty()) roots.push_back(common::settings::ASSET_DIR);
+
+    std::vector<std::string> files;
+    for (const std::string &root : roots)
+    {
+        if (std::filesystem::is_directory(root))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".tga")
+                {
+                    files.push_back(entry.path().generic_string());
+                }
+            }
+        }
+        else if (std::filesystem::is_regular_file(root))
+        {
+            files.push_back(root);
+        }
+    }
+
+    if (files.empty())
+    {
+        std::cout << "No .tga files found\n";
+        return 1;
+    }
+
+    JobSystem &jobs = JobSystem::Get();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Best of " << iterations << " runs, " << channels << " channels, "
+        << jobs.WorkerCount() << " workers\n\n";
+    std::cout << std::setw(10) << "stb ms" << std::setw(10) << "tga ms" << std::setw(11) << "banded ms"
+        << std::setw(9) << "speedup" << "  file\n";
+
+    double totalStb = 0;
+    double totalTga = 0;
+    double totalBanded = 0;
+    size_t skipped = 0;
+    bool allMatch = true;
+
+    for (const std::string &path : files)
+    {
+        common::MappedFile file;
+        common::TgaInfo info;
+        if (!file.open(path) || !common::readTgaInfo((const uint8_t *) file.data(), file.size(), info))
+        {
+            std::cout << std::setw(40) << "unsupported, stb only  " << path << "\n";
+            skipped++;
+            continue;
+        }
+
+        const uint8_t *data = (const uint8_t *) file.data();
+        int outChannels = channels ? channels : info.channels;
+        size_t rowBytes = (size_t) info.width * outChannels;
+        std::vector<uint8_t> pixels(rowBytes * info.height);
+
+        double stbMs = bestOf(iterations, [&]()
+        {
+            int width, height, fileChannels;
+            stbi_uc *decoded = stbi_load_from_memory(data, (int) file.size(), &width, &height, &fileChannels, channels);
+            stbi_image_free(decoded);
+        });
+
+        bool decoded = true;
+        double tgaMs = bestOf(iterations, [&]()
+        {
+            decoded = decoded && common::decodeTga(data, file.size(), info, pixels.data(), outChannels, 0, info.height);
+        });
+
+        // RLE can't be split, so banded is the same as whole for those
+        size_t bandRows = std::max((size_t) 1, TGA_BAND_BYTES / rowBytes);
+        double bandedMs = info.rle ? tgaMs : bestOf(iterations, [&]()
+        {
+            jobs.ParallelFor(0, info.height, bandRows, [&](size_t begin, size_t end)
+            {
+                common::decodeTga(data, file.size(), info, pixels.data(), outChannels, (int) begin, (int) (end - begin));
+            });
+        });
+
+        int width, height, fileChannels;
+        stbi_uc *reference = stbi_load_from_memory(data, (int) file.size(), &width, &height, &fileChannels, channels);
+        bool match = decoded && reference && width == info.width && height == info.height
+            && std::memcmp(reference, pixels.data(), pixels.size()) == 0;
+        stbi_image_free(reference);
+        allMatch = allMatch && match;
+
+        totalStb += stbMs;
+        totalTga += tgaMs;
+        totalBanded += bandedMs;
+
+        std::cout << std::setw(10) << stbMs << std::setw(10) << tgaMs << std::setw(11) << bandedMs
+            << std::setw(8) << stbMs / std::max(std::min(tgaMs, bandedMs), 1e-6) << "x  " << path
+            << " (" << info.width << "x" << info.height << "x" << info.channels << (info.rle ? " RLE" : "") << ")"
+            << (match ? "" : "  (MISMATCH)") << "\n";
+    }
+
+    std::cout << "\n" << std::setw(10) << totalStb << std::setw(10) << totalTga << std::setw(11) << totalBanded
+        << std::setw(8) << totalStb / std::max(std::min(totalTga, totalBanded), 1e-6) << "x  total ("
+        << files.size() - skipped << " files";
+    if (skipped) std::cout << ", " << skipped << " unsupported";
+    std::cout << ")\n";
+
+    return allMatch ? 0 : 2;
+}
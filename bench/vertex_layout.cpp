@@ -0,0 +1,221 @@
+// Times a position only (depth) pass over the interleaved and split
+// vertex layouts, in both the full and compact vertex formats.
+//
+// Usage: vertex-layout-bench [-n passes] [-g grid size] [file.psk]
+// With no file a grid mesh is generated, sized so vertex fetch dominates.
+// Run from the bin folder so shaders/ resolves.
+
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <numeric>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <SDL3/SDL.h>
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "../src/Engine/jobs.hpp"
+#include "../src/Engine/shader.hpp"
+#include "../src/Engine/UAM/mesh.hpp"
+
+using namespace uam;
+
+const int TARGET_SIZE = 1024;
+
+// Grid in the XY plane, shuffled rows keep it from being too cache friendly.
+// Fixed seed so runs stay comparable.
+static void buildGrid(int gridSize, MeshBuildData &data)
+{
+    data.vertices.resize((size_t) gridSize * gridSize);
+    for (int y = 0; y < gridSize; y++)
+    {
+        for (int x = 0; x < gridSize; x++)
+        {
+            CompleteVertex &vertex = data.vertices[(size_t) y * gridSize + x];
+            vertex.x = (float) x / (gridSize - 1) * 2.0f - 1.0f;
+            vertex.y = (float) y / (gridSize - 1) * 2.0f - 1.0f;
+            vertex.z = 0.0f;
+            vertex.u = (float) x / (gridSize - 1);
+            vertex.v = (float) y / (gridSize - 1);
+            vertex.materialIndex = 0;
+
+            vertex.nz = 1.0f;
+            vertex.tx = 1.0f;
+            vertex.tw = 1.0f;
+        }
+    }
+
+    std::vector<int> rows(gridSize > 1 ? gridSize - 1 : 0);
+    std::iota(rows.begin(), rows.end(), 0);
+    std::shuffle(rows.begin(), rows.end(), std::mt19937(1234));
+
+    for (int y : rows)
+    {
+        for (int x = 0; x + 1 < gridSize; x++)
+        {
+            GLuint i = (GLuint) (y * gridSize + x);
+            GLuint quad[6] = { i, i + 1, i + gridSize, i + 1, i + gridSize + 1, i + gridSize };
+            data.indices.insert(data.indices.end(), quad, quad + 6);
+        }
+    }
+
+    data.materialBatchSizes.push_back((uint32_t) data.indices.size());
+}
+
+static double timePass(MeshAsset &mesh, ShaderProgram &shader, int passes)
+{
+    GLuint query;
+    glGenQueries(1, &query);
+
+    // Warm up so the first timed pass doesn't pay for residency
+    mesh.DrawPositions(shader);
+    glFinish();
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int i = 0; i < passes; i++)
+    {
+        glClear(GL_DEPTH_BUFFER_BIT);
+        mesh.DrawPositions(shader);
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    glDeleteQueries(1, &query);
+
+    return (double) elapsed / 1e6 / passes;
+}
+
+int main(int argc, char **argv)
+{
+    int passes = 200;
+    int gridSize = 1024;
+    std::string pskPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) passes = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-g") == 0 && i + 1 < argc) gridSize = std::atoi(argv[++i]);
+        else pskPath = argv[i];
+    }
+
+    if (!SDL_Init(SDL_INIT_VIDEO))
+    {
+        std::cout << "Error initializing SDL: " << SDL_GetError() << "\n";
+        return 1;
+    }
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+    SDL_Window *window = SDL_CreateWindow("vertex-layout-bench", 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext glContext = SDL_GL_CreateContext(window);
+    if (!glContext || glewInit() != GLEW_OK)
+    {
+        std::cout << "Failed to create a GL context\n";
+        return 1;
+    }
+
+    std::cout << "OpenGL Vendor: " << glGetString(GL_VENDOR) << "\n";
+
+    // Quantization runs on the workers, start them from the GL thread
+    JobSystem::Get();
+
+    // Depth only target, no color writes
+    GLuint framebuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, TARGET_SIZE, TARGET_SIZE);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+    glEnable(GL_DEPTH_TEST);
+
+    ShaderProgram depthShader = ShaderProgram("shaders/depth.vert", "shaders/depth.frag");
+    depthShader.use();
+    depthShader.setMat4("modelMatrix", glm::mat4(1.0f));
+
+    // Grid fills the target, a loaded mesh gets a fixed camera in front of it
+    if (pskPath.empty())
+    {
+        depthShader.setMat4("viewMatrix", glm::mat4(1.0f));
+        depthShader.setMat4("projectionMatrix", glm::mat4(1.0f));
+    }
+    else
+    {
+        depthShader.setMat4("viewMatrix", glm::lookAt(glm::vec3(0.0f, 50.0f, 150.0f), glm::vec3(0.0f, 50.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+        depthShader.setMat4("projectionMatrix", glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 1000.0f));
+    }
+
+    struct Variant
+    {
+        const char *name;
+        VertexFormat format;
+        VertexLayout layout;
+    };
+
+    const Variant variants[] =
+    {
+        { "full, interleaved", VertexFormat::Full, VertexLayout::Interleaved },
+        { "full, split", VertexFormat::Full, VertexLayout::Split },
+        { "compact, interleaved", VertexFormat::Compact, VertexLayout::Interleaved },
+        { "compact, split", VertexFormat::Compact, VertexLayout::Split },
+    };
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (const Variant &variant : variants)
+    {
+        std::string name = pskPath.empty() ? "grid" : pskPath;
+        MeshAsset mesh(name, variant.format, variant.layout);
+
+        PreparedMesh prepared;
+        if (pskPath.empty())
+        {
+            buildGrid(gridSize, prepared.data);
+            prepareVertexStreams(prepared, variant.format, variant.layout);
+        }
+        else
+        {
+            // The loader logs, keep that out of the table
+            std::ostringstream sink;
+            std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf());
+            prepareMesh(pskPath, prepared, variant.format, variant.layout);
+            std::cout.rdbuf(coutBuf);
+        }
+
+        size_t vertexCount = prepared.vertices().size();
+        size_t positionBytes = variant.layout == VertexLayout::Split ? prepared.positionStream.size()
+            : variant.format == VertexFormat::Compact ? prepared.compactVertices.size() * sizeof(CompactVertex)
+            : vertexCount * sizeof(CompleteVertex);
+
+        mesh.Upload(prepared);
+
+        double ms = timePass(mesh, depthShader, passes);
+        std::cout << std::setw(22) << std::left << variant.name
+            << std::setw(10) << std::right << ms << " ms/pass  "
+            << std::setw(4) << positionBytes / vertexCount << " byte position stride, "
+            << vertexCount << " vertices\n";
+    }
+
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+
+    SDL_GL_DestroyContext(glContext);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,17 @@
+#version 430 core
+
+// Positions only, for depth prepass, shadow and picking passes
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+// Compact meshes store positions normalized to their bounds
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+void main() {
+
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos * positionScale + positionOffset, 1.0);
+}
\ No newline at end of file
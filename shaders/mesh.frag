@@ -1,19 +1,59 @@
 #version 430 core
 
-uniform sampler2DArray mainTextureArray;
-uniform sampler2D otherTextures[16];
+// Shared texture pool arrays, each texture is one layer of its array
+uniform sampler2DArray diffuseTexture;
+uniform sampler2DArray normalTexture;
+uniform sampler2DArray specPowerTexture;
+uniform sampler2DArray otherTextures[13];
+uniform int diffuseLayer;
+uniform int normalLayer;
+uniform int specPowerLayer;
+uniform int otherLayers[13];
 uniform int otherTexturesSize;
 
+// False when the material doesn't have one
+uniform bool hasNormalTexture;
+uniform bool hasSpecPowerTexture;
+
 out vec4 FragColor;
 in vec2 oTexCoord;
+in vec3 oViewPosition;
+in vec3 oNormal;
+in vec3 oTangent;
+in vec3 oBitangent;
+
+// Fixed light in view space, roughly over the camera's shoulder
+const vec3 LIGHT_DIRECTION = normalize(vec3(0.4, 0.6, 0.7));
+const float AMBIENT = 0.25;
 
 void main()
 {
-    // mainTextureArray consists of:
-    // diffuse, normal, specpower
-    // in that order
-    vec4 color = texture(mainTextureArray, vec3(oTexCoord, 0));
-    
-    // for now we will just use diffuse
-    FragColor = color;
+    vec4 color = texture(diffuseTexture, vec3(oTexCoord, diffuseLayer));
+
+    vec3 N = normalize(oNormal);
+    if (hasNormalTexture)
+    {
+        // Unreal normal maps are DirectX style, green points down the image.
+        // Images are uploaded top row first and UVs aren't flipped, so that's +v,
+        // which is where the bitangent points already.
+        // Only red and green are stored (BC5), z is rebuilt.
+        vec2 xy = texture(normalTexture, vec3(oTexCoord, normalLayer)).rg * 2.0 - 1.0;
+        float z = sqrt(max(1.0 - dot(xy, xy), 0.0));
+
+        mat3 TBN = mat3(normalize(oTangent), normalize(oBitangent), N);
+        N = normalize(TBN * vec3(xy, z));
+    }
+
+    vec3 V = normalize(-oViewPosition);
+    vec3 H = normalize(LIGHT_DIRECTION + V);
+    float diffuse = max(dot(N, LIGHT_DIRECTION), 0.0);
+
+    float specular = 0.0;
+    if (hasSpecPowerTexture)
+    {
+        float specPower = texture(specPowerTexture, vec3(oTexCoord, specPowerLayer)).r;
+        specular = pow(max(dot(N, H), 0.0), 1.0 + specPower * 63.0) * specPower;
+    }
+
+    FragColor = vec4(color.rgb * (AMBIENT + diffuse) + vec3(specular), color.a);
 }
\ No newline at end of file
@@ -3,15 +3,60 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 texCoord;
 layout (location = 2) in int materialIndex;
+layout (location = 3) in vec3 normal;
+layout (location = 4) in vec4 tangent;
+layout (location = 5) in vec4 qtangent;
 
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
+// Compact meshes store positions normalized to their bounds
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// Compact meshes pack the tangent frame into qtangent instead of normal/tangent
+uniform bool packedTangentFrame;
+
 out vec2 oTexCoord;
+out vec3 oViewPosition;
+out vec3 oNormal;
+out vec3 oTangent;
+out vec3 oBitangent;
+
+// Rebuilds the frame from a QTangent, the sign of w is the handedness
+void decodeQTangent(vec4 q, out vec3 n, out vec4 t)
+{
+    float handedness = q.w < 0.0 ? -1.0 : 1.0;
+    q = normalize(q);
+
+    t.xyz = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+    t.w = handedness;
+    n = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+}
 
 void main() {
 
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
+    mat4 modelView = viewMatrix * modelMatrix;
+    vec4 viewPosition = modelView * vec4(aPos * positionScale + positionOffset, 1.0);
+
+    // Models are only ever uniformly scaled, so the upper 3x3 is good enough for normals
+    vec3 frameNormal = normal;
+    vec4 frameTangent = tangent;
+    if (packedTangentFrame)
+    {
+        decodeQTangent(qtangent, frameNormal, frameTangent);
+    }
+
+    mat3 normalMatrix = mat3(modelView);
+    vec3 N = normalize(normalMatrix * frameNormal);
+    vec3 T = normalize(normalMatrix * frameTangent.xyz);
+
+    gl_Position = projectionMatrix * viewPosition;
     oTexCoord = texCoord;
+    oViewPosition = viewPosition.xyz;
+    oNormal = N;
+    oTangent = T;
+    // w holds the handedness, mirrored UVs flip the bitangent
+    oBitangent = cross(N, T) * frameTangent.w;
 }
\ No newline at end of file
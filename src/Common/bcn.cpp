@@ -0,0 +1,1280 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "cpu.hpp"
+#include "bcn.hpp"
+
+using namespace common;
+
+// One block's pixels as floats, each channel's 16 values side by side
+// so kernels can load 4 or 8 pixels of a channel at once
+struct BlockPixels
+{
+    alignas(32) float channels[4][16];
+};
+
+// Nearest palette entry of every pixel over all four channels, and its squared distance
+typedef void (*ColorIndexKernel)(const BlockPixels &, const float (*)[4], int, uint8_t *, float *);
+
+// Nearest of 8 palette values for 16 single channel values, returns the summed squared error
+typedef uint32_t (*ChannelIndexKernel)(const uint8_t *, const uint8_t *, uint8_t *);
+
+size_t common::blockSize(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t common::compressedSize(BlockFormat format, int width, int height)
+{
+    size_t blocksWide = ((size_t) width + 3) / 4;
+    size_t blocksHigh = ((size_t) height + 3) / 4;
+    return blocksWide * blocksHigh * blockSize(format);
+}
+
+/*************************** SCALAR ***************************/
+
+// x86 always has SSE2, so these only exist where it doesn't
+#ifndef COMMON_CPU_X86
+
+static void fitColorIndicesScalar(const BlockPixels &pixels, const float (*palette)[4], int paletteSize,
+    uint8_t *indices, float *errors)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        float bestDistance = 1e30f;
+        for (int p = 0; p < paletteSize; p++)
+        {
+            float dr = pixels.channels[0][i] - palette[p][0];
+            float dg = pixels.channels[1][i] - palette[p][1];
+            float db = pixels.channels[2][i] - palette[p][2];
+            float da = pixels.channels[3][i] - palette[p][3];
+            float distance = dr * dr + dg * dg + db * db + da * da;
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices[i] = (uint8_t) best;
+        errors[i] = bestDistance;
+    }
+}
+
+static uint32_t fitChannelIndicesScalar(const uint8_t *values, const uint8_t *palette, uint8_t *indices)
+{
+    uint32_t error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        int bestDistance = 256;
+        for (int p = 0; p < 8; p++)
+        {
+            int distance = std::abs(values[i] - palette[p]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices[i] = (uint8_t) best;
+        error += (uint32_t) (bestDistance * bestDistance);
+    }
+    return error;
+}
+
+#endif
+
+#ifdef COMMON_CPU_X86
+
+/*************************** SSE2 ***************************/
+
+// 4 pixels per register, the closest entry so far is tracked per lane
+static void fitColorIndicesSSE2(const BlockPixels &pixels, const float (*palette)[4], int paletteSize,
+    uint8_t *indices, float *errors)
+{
+    for (int i = 0; i < 16; i += 4)
+    {
+        __m128 r = _mm_load_ps(pixels.channels[0] + i);
+        __m128 g = _mm_load_ps(pixels.channels[1] + i);
+        __m128 b = _mm_load_ps(pixels.channels[2] + i);
+        __m128 a = _mm_load_ps(pixels.channels[3] + i);
+
+        __m128 best = _mm_set1_ps(1e30f);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int p = 0; p < paletteSize; p++)
+        {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+            __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[p][3]));
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                _mm_mul_ps(db, db)), _mm_mul_ps(da, da));
+
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            best = _mm_min_ps(distance, best);
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+        }
+
+        _mm_storeu_ps(errors + i, best);
+
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(bestIndex, bestIndex), bestIndex);
+        int lanes = _mm_cvtsi128_si32(packed);
+        std::memcpy(indices + i, &lanes, 4);
+    }
+}
+
+// All 16 values in one register. Distances are unsigned byte differences,
+// a lane moves to the next palette entry only when it's strictly closer.
+static uint32_t fitChannelIndicesSSE2(const uint8_t *values, const uint8_t *palette, uint8_t *indices)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *) values);
+    __m128i best = _mm_set1_epi8((char) 0xFF);
+    __m128i bestIndex = _mm_setzero_si128();
+
+    for (int p = 0; p < 8; p++)
+    {
+        __m128i entry = _mm_set1_epi8((char) palette[p]);
+        __m128i distance = _mm_or_si128(_mm_subs_epu8(v, entry), _mm_subs_epu8(entry, v));
+
+        __m128i nearest = _mm_min_epu8(distance, best);
+        __m128i notCloser = _mm_cmpeq_epi8(nearest, best);
+        best = nearest;
+        bestIndex = _mm_or_si128(_mm_and_si128(notCloser, bestIndex), _mm_andnot_si128(notCloser, _mm_set1_epi8((char) p)));
+    }
+
+    _mm_storeu_si128((__m128i *) indices, bestIndex);
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi8(best, zero);
+    __m128i high = _mm_unpackhi_epi8(best, zero);
+    __m128i sums = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t) _mm_cvtsi128_si32(sums);
+}
+
+/*************************** AVX2 ***************************/
+
+// Same as SSE2 with 8 pixels per register, so a block is two passes per entry
+COMMON_TARGET_AVX2
+static void fitColorIndicesAVX2(const BlockPixels &pixels, const float (*palette)[4], int paletteSize,
+    uint8_t *indices, float *errors)
+{
+    for (int i = 0; i < 16; i += 8)
+    {
+        __m256 r = _mm256_load_ps(pixels.channels[0] + i);
+        __m256 g = _mm256_load_ps(pixels.channels[1] + i);
+        __m256 b = _mm256_load_ps(pixels.channels[2] + i);
+        __m256 a = _mm256_load_ps(pixels.channels[3] + i);
+
+        __m256 best = _mm256_set1_ps(1e30f);
+        __m256 bestIndex = _mm256_setzero_ps();
+        for (int p = 0; p < paletteSize; p++)
+        {
+            __m256 dr = _mm256_sub_ps(r, _mm256_set1_ps(palette[p][0]));
+            __m256 dg = _mm256_sub_ps(g, _mm256_set1_ps(palette[p][1]));
+            __m256 db = _mm256_sub_ps(b, _mm256_set1_ps(palette[p][2]));
+            __m256 da = _mm256_sub_ps(a, _mm256_set1_ps(palette[p][3]));
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)),
+                _mm256_mul_ps(db, db)), _mm256_mul_ps(da, da));
+
+            __m256 closer = _mm256_cmp_ps(distance, best, _CMP_LT_OQ);
+            best = _mm256_min_ps(distance, best);
+            bestIndex = _mm256_blendv_ps(bestIndex, _mm256_castsi256_ps(_mm256_set1_epi32(p)), closer);
+        }
+
+        _mm256_storeu_ps(errors + i, best);
+
+        __m256i lanes = _mm256_castps_si256(bestIndex);
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+        _mm_storel_epi64((__m128i *) (indices + i), _mm_packus_epi16(words, words));
+    }
+}
+
+#endif
+
+/*************************** DISPATCH ***************************/
+
+static ColorIndexKernel selectColorIndexKernel()
+{
+#ifdef COMMON_CPU_X86
+    if (common::cpu::hasAVX2()) return fitColorIndicesAVX2;
+    return fitColorIndicesSSE2;
+#else
+    return fitColorIndicesScalar;
+#endif
+}
+
+static ChannelIndexKernel selectChannelIndexKernel()
+{
+#ifdef COMMON_CPU_X86
+    return fitChannelIndicesSSE2;
+#else
+    return fitChannelIndicesScalar;
+#endif
+}
+
+// Returns the summed squared error of the pixels in mask
+static float fitColorIndices(const BlockPixels &pixels, const float (*palette)[4], int paletteSize,
+    uint8_t *indices, float *errors, uint32_t mask = 0xFFFF)
+{
+    static const ColorIndexKernel kernel = selectColorIndexKernel();
+    kernel(pixels, palette, paletteSize, indices, errors);
+
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        if (mask & (1 << i)) error += errors[i];
+    }
+    return error;
+}
+
+static uint32_t fitChannelIndices(const uint8_t *values, const uint8_t *palette, uint8_t *indices)
+{
+    static const ChannelIndexKernel kernel = selectChannelIndexKernel();
+    return kernel(values, palette, indices);
+}
+
+/*************************** ENDPOINTS ***************************/
+
+// Endpoints at the extremes of the pixels in mask along their principal axis,
+// pulled in a little since the extremes are rarely hit exactly.
+// endpoint0 is the high end. Channels past channelCount are left at 0.
+static void fitEndpoints(const BlockPixels &pixels, uint32_t mask, int channelCount, float endpoint0[4], float endpoint1[4])
+{
+    float mean[4] = {};
+    int count = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        if (!(mask & (1 << i))) continue;
+        for (int c = 0; c < channelCount; c++) mean[c] += pixels.channels[c][i];
+        count++;
+    }
+    for (int c = 0; c < channelCount; c++) mean[c] /= (float) std::max(count, 1);
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        if (!(mask & (1 << i))) continue;
+        for (int c = 0; c < channelCount; c++)
+        {
+            for (int d = c; d < channelCount; d++)
+            {
+                covariance[c][d] += (pixels.channels[c][i] - mean[c]) * (pixels.channels[d][i] - mean[d]);
+            }
+        }
+    }
+
+    // Power iteration from the covariance column with the most variance,
+    // good enough after a handful of steps
+    int start = 0;
+    for (int c = 1; c < channelCount; c++)
+    {
+        if (covariance[c][c] > covariance[start][start]) start = c;
+    }
+
+    float axis[4] = {};
+    for (int c = 0; c < channelCount; c++)
+    {
+        axis[c] = c <= start ? covariance[c][start] : covariance[start][c];
+    }
+
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int c = 0; c < channelCount; c++)
+        {
+            for (int d = 0; d < channelCount; d++)
+            {
+                next[c] += (c <= d ? covariance[c][d] : covariance[d][c]) * axis[d];
+            }
+            length = std::max(length, std::fabs(next[c]));
+        }
+        if (length < 1e-6f) break;
+        for (int c = 0; c < channelCount; c++) axis[c] = next[c] / length;
+    }
+
+    // Flat blocks have no axis, any direction collapses to the mean
+    float axisLength = 0.0f;
+    for (int c = 0; c < channelCount; c++) axisLength += axis[c] * axis[c];
+    if (axisLength < 1e-6f)
+    {
+        for (int c = 0; c < channelCount; c++) axis[c] = 1.0f;
+        axisLength = (float) channelCount;
+    }
+
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        if (!(mask & (1 << i))) continue;
+
+        float projection = 0.0f;
+        for (int c = 0; c < channelCount; c++) projection += (pixels.channels[c][i] - mean[c]) * axis[c];
+        projection /= axisLength;
+
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    float inset = (maxProjection - minProjection) / 16.0f;
+    minProjection += inset;
+    maxProjection -= inset;
+
+    for (int c = 0; c < 4; c++)
+    {
+        endpoint0[c] = c < channelCount ? mean[c] + axis[c] * maxProjection : 0.0f;
+        endpoint1[c] = c < channelCount ? mean[c] + axis[c] * minProjection : 0.0f;
+    }
+}
+
+// Least squares endpoints for fixed indices. weights maps an index
+// to how much of endpoint1 it takes, 0 to 1.
+static bool refineEndpoints(const BlockPixels &pixels, uint32_t mask, int channelCount, const uint8_t *indices,
+    const float *weights, float endpoint0[4], float endpoint1[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        if (!(mask & (1 << i))) continue;
+
+        float b = weights[indices[i]];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channelCount; c++)
+        {
+            ax[c] += a * pixels.channels[c][i];
+            bx[c] += b * pixels.channels[c][i];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) return false;
+
+    for (int c = 0; c < channelCount; c++)
+    {
+        endpoint0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+        endpoint1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+    }
+    return true;
+}
+
+static float clampByte(float value)
+{
+    return std::min(std::max(value, 0.0f), 255.0f);
+}
+
+static void loadBlockPixels(const uint8_t *rgba, bool alpha, BlockPixels &pixels)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++) pixels.channels[c][i] = rgba[i * 4 + c];
+        pixels.channels[3][i] = alpha ? rgba[i * 4 + 3] : 0.0f;
+    }
+}
+
+// Quality presets, how many least squares passes each one gets
+static int refinePasses(BlockQuality quality)
+{
+    switch (quality)
+    {
+        case BlockQuality::Fast:
+            return 0;
+        case BlockQuality::Normal:
+            return 1;
+        case BlockQuality::High:
+            return 3;
+    }
+    return 1;
+}
+
+/*************************** COLOR (BC1) ***************************/
+
+static uint16_t packColor565(const float color[3])
+{
+    int r = (int) std::lround(clampByte(color[0]) * 31.0f / 255.0f);
+    int g = (int) std::lround(clampByte(color[1]) * 63.0f / 255.0f);
+    int b = (int) std::lround(clampByte(color[2]) * 31.0f / 255.0f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(uint16_t packed, uint8_t color[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (uint8_t) ((r << 3) | (r >> 2));
+    color[1] = (uint8_t) ((g << 2) | (g >> 4));
+    color[2] = (uint8_t) ((b << 3) | (b >> 2));
+}
+
+// Four color mode palette, whichever endpoint is larger ends up first when written
+static float evaluateColor565(const BlockPixels &pixels, uint16_t color0, uint16_t color1, uint8_t *indices)
+{
+    uint8_t unpacked[2][3];
+    unpackColor565(color0, unpacked[0]);
+    unpackColor565(color1, unpacked[1]);
+
+    float palette[4][4] = {};
+    for (int c = 0; c < 3; c++)
+    {
+        palette[0][c] = unpacked[0][c];
+        palette[1][c] = unpacked[1][c];
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    float errors[16];
+    return fitColorIndices(pixels, palette, 4, indices, errors);
+}
+
+static void writeColorBlock(uint8_t *out, uint16_t color0, uint16_t color1, const uint8_t *indices)
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 16; i++) packed |= (uint32_t) indices[i] << (2 * i);
+
+    // color0 > color1 selects the four color mode, swapping the endpoints
+    // swaps index 0 with 1 and 2 with 3
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+        packed ^= 0x55555555;
+    }
+    else if (color0 == color1)
+    {
+        packed = 0;
+    }
+
+    std::memcpy(out, &color0, 2);
+    std::memcpy(out + 2, &color1, 2);
+    std::memcpy(out + 4, &packed, 4);
+}
+
+static void encodeColorBlock(const uint8_t *rgba, BlockQuality quality, uint8_t *out)
+{
+    // How much of color1 each index takes
+    static const float WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    BlockPixels pixels;
+    loadBlockPixels(rgba, false, pixels);
+
+    float endpoint0[4], endpoint1[4];
+    fitEndpoints(pixels, 0xFFFF, 3, endpoint0, endpoint1);
+
+    uint16_t color0 = packColor565(endpoint0);
+    uint16_t color1 = packColor565(endpoint1);
+    uint8_t indices[16];
+    float error = evaluateColor565(pixels, color0, color1, indices);
+
+    for (int pass = 0; pass < refinePasses(quality) && error > 0.0f; pass++)
+    {
+        if (!refineEndpoints(pixels, 0xFFFF, 3, indices, WEIGHTS, endpoint0, endpoint1)) break;
+
+        uint16_t refined0 = packColor565(endpoint0);
+        uint16_t refined1 = packColor565(endpoint1);
+        uint8_t refinedIndices[16];
+        float refinedError = evaluateColor565(pixels, refined0, refined1, refinedIndices);
+        if (refinedError >= error) break;
+
+        color0 = refined0;
+        color1 = refined1;
+        error = refinedError;
+        std::memcpy(indices, refinedIndices, 16);
+    }
+
+    writeColorBlock(out, color0, color1, indices);
+}
+
+/*************************** CHANNEL (BC4) ***************************/
+
+// value0 > value1 interpolates six values between them, otherwise
+// four with 0 and 255 as the last two entries
+static void channelPalette(int value0, int value1, uint8_t palette[8])
+{
+    palette[0] = (uint8_t) value0;
+    palette[1] = (uint8_t) value1;
+    if (value0 > value1)
+    {
+        for (int p = 2; p < 8; p++) palette[p] = (uint8_t) (((8 - p) * value0 + (p - 1) * value1) / 7);
+    }
+    else
+    {
+        for (int p = 2; p < 6; p++) palette[p] = (uint8_t) (((6 - p) * value0 + (p - 1) * value1) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static uint32_t tryChannelEndpoints(const uint8_t values[16], int value0, int value1, uint32_t bestError,
+    uint8_t best[2], uint8_t bestIndices[16])
+{
+    uint8_t palette[8];
+    uint8_t indices[16];
+    channelPalette(value0, value1, palette);
+
+    uint32_t error = fitChannelIndices(values, palette, indices);
+    if (error < bestError)
+    {
+        best[0] = (uint8_t) value0;
+        best[1] = (uint8_t) value1;
+        std::memcpy(bestIndices, indices, 16);
+        return error;
+    }
+    return bestError;
+}
+
+// Eight value mode between the block's extremes. Normal also nudges both
+// endpoints inwards a step, High two and tries six value mode for blocks
+// that hit 0 or 255.
+// stride is the distance between a pixel's values, 4 for RGBA.
+static void encodeChannelBlock(const uint8_t *source, int stride, BlockQuality quality, uint8_t *out)
+{
+    uint8_t values[16];
+    uint8_t low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        values[i] = source[i * stride];
+        low = std::min(low, values[i]);
+        high = std::max(high, values[i]);
+    }
+
+    uint8_t endpoints[2] = { high, low };
+    uint8_t indices[16] = {};
+    uint32_t error = UINT32_MAX;
+    error = tryChannelEndpoints(values, high, low, error, endpoints, indices);
+
+    int maxInset = quality == BlockQuality::High ? 2 : quality == BlockQuality::Normal ? 1 : 0;
+    for (int highInset = 0; highInset <= maxInset && error > 0; highInset++)
+    {
+        for (int lowInset = 0; lowInset <= maxInset; lowInset++)
+        {
+            if ((highInset || lowInset) && high - highInset > low + lowInset)
+            {
+                error = tryChannelEndpoints(values, high - highInset, low + lowInset, error, endpoints, indices);
+            }
+        }
+    }
+
+    if (quality == BlockQuality::High && error > 0)
+    {
+
+        // Six value mode spends its range on what isn't 0 or 255
+        uint8_t innerLow = 255, innerHigh = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            if (values[i] == 0 || values[i] == 255) continue;
+            innerLow = std::min(innerLow, values[i]);
+            innerHigh = std::max(innerHigh, values[i]);
+        }
+        if (innerLow <= innerHigh)
+        {
+            error = tryChannelEndpoints(values, innerLow, innerHigh, error, endpoints, indices);
+        }
+    }
+
+    out[0] = endpoints[0];
+    out[1] = endpoints[1];
+
+    uint64_t packed = 0;
+    for (int i = 0; i < 16; i++) packed |= (uint64_t) indices[i] << (3 * i);
+    for (int i = 0; i < 6; i++) out[2 + i] = (uint8_t) (packed >> (8 * i));
+}
+
+/*************************** BC7 ***************************/
+
+// Fractions of endpoint1 out of 64 for 4 and 3 bit indices
+static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const int BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+// Two subset partitions, bit i set means pixel i is in subset 1
+static const uint16_t BC7_PARTITIONS2[64] =
+{
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+// Pixel whose index drops its top bit in subset 1, subset 0's is always pixel 0
+static const uint8_t BC7_ANCHORS2[64] =
+{
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+// Partitions High fully encodes, picked by a cheap estimate
+#define BC7_MODE1_CANDIDATES 4
+
+// 128 bit block, written least significant bit first
+struct BitWriter
+{
+    uint8_t *out;
+    int position = 0;
+
+    void put(uint32_t value, int count)
+    {
+        for (int i = 0; i < count; i++, position++)
+        {
+            if (value & (1u << i)) out[position >> 3] |= (uint8_t) (1 << (position & 7));
+        }
+    }
+};
+
+struct BitReader
+{
+    const uint8_t *in;
+    int position = 0;
+
+    uint32_t get(int count)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++, position++)
+        {
+            value |= (uint32_t) ((in[position >> 3] >> (position & 7)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+static int interpolateBC7(int value0, int value1, int weight)
+{
+    return ((64 - weight) * value0 + weight * value1 + 32) >> 6;
+}
+
+// Mode 6: one subset, RGBA endpoints of 7 bits plus a p-bit each, 4 bit indices
+struct Mode6Block
+{
+    int endpoints[2][4];
+    int pbits[2];
+    uint8_t indices[16];
+    float error = 1e30f;
+};
+
+static int quantize7(float value, int pbit)
+{
+    return std::min(std::max((int) std::lround((clampByte(value) - pbit) / 2.0f), 0), 127);
+}
+
+static float evaluateMode6(const BlockPixels &pixels, const float endpoint0[4], const float endpoint1[4],
+    int pbit0, int pbit1, Mode6Block &block)
+{
+    int expanded[2][4];
+    for (int c = 0; c < 4; c++)
+    {
+        block.endpoints[0][c] = quantize7(endpoint0[c], pbit0);
+        block.endpoints[1][c] = quantize7(endpoint1[c], pbit1);
+        expanded[0][c] = (block.endpoints[0][c] << 1) | pbit0;
+        expanded[1][c] = (block.endpoints[1][c] << 1) | pbit1;
+    }
+    block.pbits[0] = pbit0;
+    block.pbits[1] = pbit1;
+
+    float palette[16][4];
+    for (int p = 0; p < 16; p++)
+    {
+        for (int c = 0; c < 4; c++) palette[p][c] = (float) interpolateBC7(expanded[0][c], expanded[1][c], BC7_WEIGHTS4[p]);
+    }
+
+    float errors[16];
+    block.error = fitColorIndices(pixels, palette, 16, block.indices, errors);
+    return block.error;
+}
+
+// p-bit that loses the least when the endpoint is rounded to 7 bits
+static int closestPbit(const float endpoint[4])
+{
+    float error[2] = {};
+    for (int pbit = 0; pbit < 2; pbit++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            float difference = clampByte(endpoint[c]) - (float) ((quantize7(endpoint[c], pbit) << 1) | pbit);
+            error[pbit] += difference * difference;
+        }
+    }
+    return error[1] < error[0] ? 1 : 0;
+}
+
+static void encodeMode6(const BlockPixels &pixels, BlockQuality quality, Mode6Block &best)
+{
+    static const float WEIGHTS[16] =
+    {
+        0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+        34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f
+    };
+
+    float endpoint0[4], endpoint1[4];
+    fitEndpoints(pixels, 0xFFFF, 4, endpoint0, endpoint1);
+
+    for (int pass = 0; pass <= refinePasses(quality); pass++)
+    {
+        Mode6Block candidate;
+        if (quality == BlockQuality::Fast)
+        {
+            evaluateMode6(pixels, endpoint0, endpoint1, closestPbit(endpoint0), closestPbit(endpoint1), candidate);
+        }
+        else
+        {
+            for (int pbits = 0; pbits < 4; pbits++)
+            {
+                Mode6Block trial;
+                if (evaluateMode6(pixels, endpoint0, endpoint1, pbits & 1, pbits >> 1, trial) < candidate.error) candidate = trial;
+            }
+        }
+
+        if (candidate.error >= best.error) break;
+        best = candidate;
+
+        if (best.error == 0.0f || !refineEndpoints(pixels, 0xFFFF, 4, best.indices, WEIGHTS, endpoint0, endpoint1)) break;
+    }
+}
+
+static void writeMode6(Mode6Block block, uint8_t *out)
+{
+    // Pixel 0's index drops its top bit, so it has to be below 8
+    if (block.indices[0] & 8)
+    {
+        for (int c = 0; c < 4; c++) std::swap(block.endpoints[0][c], block.endpoints[1][c]);
+        std::swap(block.pbits[0], block.pbits[1]);
+        for (int i = 0; i < 16; i++) block.indices[i] = (uint8_t) (15 - block.indices[i]);
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer = { out };
+    writer.put(1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.put(block.endpoints[0][c], 7);
+        writer.put(block.endpoints[1][c], 7);
+    }
+    writer.put(block.pbits[0], 1);
+    writer.put(block.pbits[1], 1);
+
+    writer.put(block.indices[0], 3);
+    for (int i = 1; i < 16; i++) writer.put(block.indices[i], 4);
+}
+
+// Mode 1: two subsets, RGB endpoints of 6 bits plus a p-bit shared per subset, 3 bit indices.
+// Alpha is always 255.
+struct Mode1Block
+{
+    int partition = 0;
+    int endpoints[2][2][3]; // [subset][endpoint][channel]
+    int pbits[2];
+    uint8_t indices[16];
+    float error = 1e30f;
+};
+
+static int expand6(int value, int pbit)
+{
+    int seven = (value << 1) | pbit;
+    return (seven << 1) | (seven >> 6);
+}
+
+static int quantize6(float value, int pbit)
+{
+    float target = clampByte(value);
+    int guess = std::min(std::max((int) std::lround((target - 2 * pbit) / 4.0f), 0), 63);
+
+    // The 7 to 8 bit expansion isn't linear, so check the neighbours too
+    int best = guess;
+    for (int candidate = std::max(guess - 1, 0); candidate <= std::min(guess + 1, 63); candidate++)
+    {
+        if (std::fabs(expand6(candidate, pbit) - target) < std::fabs(expand6(best, pbit) - target)) best = candidate;
+    }
+    return best;
+}
+
+// Fits one subset with the given p-bit, fills its indices in block. Returns the subset's error.
+static float evaluateMode1Subset(const BlockPixels &pixels, uint32_t mask, const float endpoint0[4],
+    const float endpoint1[4], int pbit, int subset, Mode1Block &block)
+{
+    int expanded[2][3];
+    for (int c = 0; c < 3; c++)
+    {
+        block.endpoints[subset][0][c] = quantize6(endpoint0[c], pbit);
+        block.endpoints[subset][1][c] = quantize6(endpoint1[c], pbit);
+        expanded[0][c] = expand6(block.endpoints[subset][0][c], pbit);
+        expanded[1][c] = expand6(block.endpoints[subset][1][c], pbit);
+    }
+    block.pbits[subset] = pbit;
+
+    float palette[8][4];
+    for (int p = 0; p < 8; p++)
+    {
+        for (int c = 0; c < 3; c++) palette[p][c] = (float) interpolateBC7(expanded[0][c], expanded[1][c], BC7_WEIGHTS3[p]);
+        palette[p][3] = 255.0f;
+    }
+
+    uint8_t indices[16];
+    float errors[16];
+    float error = fitColorIndices(pixels, palette, 8, indices, errors, mask);
+    for (int i = 0; i < 16; i++)
+    {
+        if (mask & (1 << i)) block.indices[i] = indices[i];
+    }
+    return error;
+}
+
+// Every pixel's count, channels and channel products as integers,
+// so summing them over a subset vectorizes without reassociating floats
+struct PixelMoments
+{
+    alignas(32) int32_t values[10][16]; // 1, r, g, b, rr, rg, rb, gg, gb, bb
+
+    PixelMoments(const BlockPixels &pixels)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int32_t r = (int32_t) pixels.channels[0][i];
+            int32_t g = (int32_t) pixels.channels[1][i];
+            int32_t b = (int32_t) pixels.channels[2][i];
+            values[0][i] = 1;
+            values[1][i] = r;
+            values[2][i] = g;
+            values[3][i] = b;
+            values[4][i] = r * r;
+            values[5][i] = r * g;
+            values[6][i] = r * b;
+            values[7][i] = g * g;
+            values[8][i] = g * b;
+            values[9][i] = b * b;
+        }
+    }
+};
+
+// Sums over a subset's pixels, enough to get its covariance
+struct SubsetMoments
+{
+    int32_t sums[10] = {};
+
+    SubsetMoments() = default;
+
+    SubsetMoments(const PixelMoments &moments, uint32_t mask)
+    {
+        for (int k = 0; k < 10; k++)
+        {
+            int32_t sum = 0;
+            for (int i = 0; i < 16; i++) sum += moments.values[k][i] & -(int32_t) ((mask >> i) & 1);
+            sums[k] = sum;
+        }
+    }
+
+    SubsetMoments minus(const SubsetMoments &other) const
+    {
+        SubsetMoments difference;
+        for (int k = 0; k < 10; k++) difference.sums[k] = sums[k] - other.sums[k];
+        return difference;
+    }
+
+    // What a single line through the pixels can't represent, the scatter
+    // left over once its largest eigenvalue is taken out
+    float residual() const
+    {
+        if (sums[0] < 2) return 0.0f;
+
+        float inverseCount = 1.0f / (float) sums[0];
+        float mean[3] = { sums[1] * inverseCount, sums[2] * inverseCount, sums[3] * inverseCount };
+
+        float scatter[6];
+        scatter[0] = sums[4] - sums[1] * mean[0];
+        scatter[1] = sums[5] - sums[1] * mean[1];
+        scatter[2] = sums[6] - sums[1] * mean[2];
+        scatter[3] = sums[7] - sums[2] * mean[1];
+        scatter[4] = sums[8] - sums[2] * mean[2];
+        scatter[5] = sums[9] - sums[3] * mean[2];
+
+        float trace = scatter[0] + scatter[3] + scatter[5];
+        if (trace < 1e-3f) return 0.0f;
+
+        // A few power iterations, then the Rayleigh quotient for the eigenvalue
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        float next[3];
+        for (int iteration = 0; iteration < 4; iteration++)
+        {
+            next[0] = scatter[0] * axis[0] + scatter[1] * axis[1] + scatter[2] * axis[2];
+            next[1] = scatter[1] * axis[0] + scatter[3] * axis[1] + scatter[4] * axis[2];
+            next[2] = scatter[2] * axis[0] + scatter[4] * axis[1] + scatter[5] * axis[2];
+
+            float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+            if (length < 1e-6f) return trace;
+
+            float inverse = 1.0f / length;
+            for (int c = 0; c < 3; c++) axis[c] = next[c] * inverse;
+        }
+
+        next[0] = scatter[0] * axis[0] + scatter[1] * axis[1] + scatter[2] * axis[2];
+        next[1] = scatter[1] * axis[0] + scatter[3] * axis[1] + scatter[4] * axis[2];
+        next[2] = scatter[2] * axis[0] + scatter[4] * axis[1] + scatter[5] * axis[2];
+        float largest = (axis[0] * next[0] + axis[1] * next[1] + axis[2] * next[2])
+            / (axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        return std::max(trace - largest, 0.0f);
+    }
+};
+
+static void encodeMode1Partition(const BlockPixels &pixels, int partition, Mode1Block &best)
+{
+    static const float WEIGHTS[8] =
+    {
+        0 / 64.0f, 9 / 64.0f, 18 / 64.0f, 27 / 64.0f, 37 / 64.0f, 46 / 64.0f, 55 / 64.0f, 64 / 64.0f
+    };
+
+    Mode1Block block;
+    block.partition = partition;
+    block.error = 0.0f;
+
+    uint32_t masks[2] = { (uint32_t) (~BC7_PARTITIONS2[partition] & 0xFFFF), BC7_PARTITIONS2[partition] };
+    for (int subset = 0; subset < 2; subset++)
+    {
+        float endpoint0[4], endpoint1[4];
+        fitEndpoints(pixels, masks[subset], 3, endpoint0, endpoint1);
+
+        // The subsets don't share anything, so each keeps its own best p-bit and pass
+        float subsetError = 1e30f;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            Mode1Block trial = block;
+            float trialError = 1e30f;
+            for (int pbit = 0; pbit < 2; pbit++)
+            {
+                Mode1Block pbitTrial = block;
+                float error = evaluateMode1Subset(pixels, masks[subset], endpoint0, endpoint1, pbit, subset, pbitTrial);
+                if (error < trialError)
+                {
+                    trialError = error;
+                    trial = pbitTrial;
+                }
+            }
+
+            if (trialError >= subsetError) break;
+            subsetError = trialError;
+            std::memcpy(block.endpoints[subset], trial.endpoints[subset], sizeof(block.endpoints[subset]));
+            block.pbits[subset] = trial.pbits[subset];
+            std::memcpy(block.indices, trial.indices, 16);
+
+            if (!refineEndpoints(pixels, masks[subset], 3, block.indices, WEIGHTS, endpoint0, endpoint1)) break;
+        }
+        block.error += subsetError;
+    }
+
+    if (block.error < best.error) best = block;
+}
+
+static void encodeMode1(const BlockPixels &pixels, Mode1Block &best)
+{
+    int candidates[BC7_MODE1_CANDIDATES];
+    float estimates[BC7_MODE1_CANDIDATES];
+    int candidateCount = 0;
+
+    PixelMoments moments(pixels);
+    SubsetMoments block(moments, 0xFFFF);
+    for (int partition = 0; partition < 64; partition++)
+    {
+        SubsetMoments subset1(moments, BC7_PARTITIONS2[partition]);
+        float estimate = block.minus(subset1).residual() + subset1.residual();
+
+        // Keep the lowest few, sorted
+        int slot = candidateCount;
+        while (slot > 0 && estimates[slot - 1] > estimate) slot--;
+        if (slot >= BC7_MODE1_CANDIDATES) continue;
+
+        for (int i = std::min(candidateCount, BC7_MODE1_CANDIDATES - 1); i > slot; i--)
+        {
+            candidates[i] = candidates[i - 1];
+            estimates[i] = estimates[i - 1];
+        }
+        candidates[slot] = partition;
+        estimates[slot] = estimate;
+        candidateCount = std::min(candidateCount + 1, BC7_MODE1_CANDIDATES);
+    }
+
+    for (int i = 0; i < candidateCount; i++)
+    {
+        encodeMode1Partition(pixels, candidates[i], best);
+    }
+}
+
+static void writeMode1(Mode1Block block, uint8_t *out)
+{
+    uint32_t subset1 = BC7_PARTITIONS2[block.partition];
+    int anchors[2] = { 0, BC7_ANCHORS2[block.partition] };
+
+    // Each subset's anchor index drops its top bit, so it has to be below 4
+    for (int subset = 0; subset < 2; subset++)
+    {
+        if (!(block.indices[anchors[subset]] & 4)) continue;
+
+        for (int c = 0; c < 3; c++) std::swap(block.endpoints[subset][0][c], block.endpoints[subset][1][c]);
+        for (int i = 0; i < 16; i++)
+        {
+            if ((int) ((subset1 >> i) & 1) == subset) block.indices[i] = (uint8_t) (7 - block.indices[i]);
+        }
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer = { out };
+    writer.put(1 << 1, 2);
+    writer.put(block.partition, 6);
+    for (int c = 0; c < 3; c++)
+    {
+        writer.put(block.endpoints[0][0][c], 6);
+        writer.put(block.endpoints[0][1][c], 6);
+        writer.put(block.endpoints[1][0][c], 6);
+        writer.put(block.endpoints[1][1][c], 6);
+    }
+    writer.put(block.pbits[0], 1);
+    writer.put(block.pbits[1], 1);
+
+    for (int i = 0; i < 16; i++)
+    {
+        writer.put(block.indices[i], i == anchors[0] || i == anchors[1] ? 2 : 3);
+    }
+}
+
+// Mode 6 handles everything. High also tries mode 1 on opaque blocks,
+// which wins where a block has two distinct colors.
+static void encodeBC7Block(const uint8_t *rgba, BlockQuality quality, uint8_t *out)
+{
+    BlockPixels pixels;
+    loadBlockPixels(rgba, true, pixels);
+
+    Mode6Block mode6;
+    encodeMode6(pixels, quality, mode6);
+
+    bool opaque = true;
+    for (int i = 0; i < 16; i++) opaque = opaque && rgba[i * 4 + 3] == 255;
+
+    if (quality == BlockQuality::High && opaque && mode6.error > 0.0f)
+    {
+        Mode1Block mode1;
+        encodeMode1(pixels, mode1);
+        if (mode1.error < mode6.error)
+        {
+            writeMode1(mode1, out);
+            return;
+        }
+    }
+
+    writeMode6(mode6, out);
+}
+
+static void decodeBC7Block(const uint8_t *in, uint8_t *rgba)
+{
+    std::memset(rgba, 0, 64);
+
+    BitReader reader = { in };
+    int mode = 0;
+    while (mode < 8 && reader.get(1) == 0) mode++;
+
+    if (mode == 6)
+    {
+        int endpoints[2][4];
+        for (int c = 0; c < 4; c++)
+        {
+            endpoints[0][c] = (int) reader.get(7);
+            endpoints[1][c] = (int) reader.get(7);
+        }
+        int pbit0 = (int) reader.get(1);
+        int pbit1 = (int) reader.get(1);
+        for (int c = 0; c < 4; c++)
+        {
+            endpoints[0][c] = (endpoints[0][c] << 1) | pbit0;
+            endpoints[1][c] = (endpoints[1][c] << 1) | pbit1;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int index = (int) reader.get(i == 0 ? 3 : 4);
+            for (int c = 0; c < 4; c++)
+            {
+                rgba[i * 4 + c] = (uint8_t) interpolateBC7(endpoints[0][c], endpoints[1][c], BC7_WEIGHTS4[index]);
+            }
+        }
+    }
+    else if (mode == 1)
+    {
+        int partition = (int) reader.get(6);
+        int endpoints[2][2][3];
+        for (int c = 0; c < 3; c++)
+        {
+            for (int subset = 0; subset < 2; subset++)
+            {
+                endpoints[subset][0][c] = (int) reader.get(6);
+                endpoints[subset][1][c] = (int) reader.get(6);
+            }
+        }
+        int pbits[2] = { (int) reader.get(1), (int) reader.get(1) };
+
+        uint32_t subset1 = BC7_PARTITIONS2[partition];
+        for (int i = 0; i < 16; i++)
+        {
+            int subset = (subset1 >> i) & 1;
+            int index = (int) reader.get(i == 0 || i == BC7_ANCHORS2[partition] ? 2 : 3);
+            for (int c = 0; c < 3; c++)
+            {
+                rgba[i * 4 + c] = (uint8_t) interpolateBC7(expand6(endpoints[subset][0][c], pbits[subset]),
+                    expand6(endpoints[subset][1][c], pbits[subset]), BC7_WEIGHTS3[index]);
+            }
+            rgba[i * 4 + 3] = 255;
+        }
+    }
+}
+
+/*************************** DECODING ***************************/
+
+static void decodeColorBlock(const uint8_t *in, uint8_t *rgba)
+{
+    uint16_t color0, color1;
+    uint32_t packed;
+    std::memcpy(&color0, in, 2);
+    std::memcpy(&color1, in + 2, 2);
+    std::memcpy(&packed, in + 4, 4);
+
+    uint8_t palette[4][3];
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        if (color0 > color1)
+        {
+            palette[2][c] = (uint8_t) ((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = (uint8_t) ((palette[0][c] + 2 * palette[1][c]) / 3);
+        }
+        else
+        {
+            palette[2][c] = (uint8_t) ((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+        std::memcpy(rgba + i * 4, palette[(packed >> (2 * i)) & 3], 3);
+    }
+}
+
+static void decodeChannelBlock(const uint8_t *in, uint8_t *rgba, int channel)
+{
+    uint8_t palette[8];
+    channelPalette(in[0], in[1], palette);
+
+    uint64_t packed = 0;
+    for (int i = 0; i < 6; i++) packed |= (uint64_t) in[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++) rgba[i * 4 + channel] = palette[(packed >> (3 * i)) & 7];
+}
+
+/*************************** IMAGE ***************************/
+
+// Copies a 4x4 block out of the image, clamping at the right and bottom edges
+static void gatherBlock(const uint8_t *rgba, int width, int height, int blockX, int blockY, uint8_t block[64])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int sourceY = std::min(blockY * 4 + y, height - 1);
+        const uint8_t *row = rgba + (size_t) sourceY * width * 4;
+        for (int x = 0; x < 4; x++)
+        {
+            int sourceX = std::min(blockX * 4 + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, row + (size_t) sourceX * 4, 4);
+        }
+    }
+}
+
+void common::compressBlocks(BlockFormat format, BlockQuality quality, const uint8_t *rgba, int width, int height,
+    uint8_t *blocks, int firstBlockRow, int blockRowCount)
+{
+    int blocksWide = (width + 3) / 4;
+    size_t bytesPerBlock = blockSize(format);
+
+    uint8_t block[64];
+    for (int blockY = firstBlockRow; blockY < firstBlockRow + blockRowCount; blockY++)
+    {
+        uint8_t *out = blocks + (size_t) blockY * blocksWide * bytesPerBlock;
+        for (int blockX = 0; blockX < blocksWide; blockX++, out += bytesPerBlock)
+        {
+            gatherBlock(rgba, width, height, blockX, blockY, block);
+
+            switch (format)
+            {
+                case BlockFormat::BC1:
+                    encodeColorBlock(block, quality, out);
+                    break;
+                case BlockFormat::BC3:
+                    encodeChannelBlock(block + 3, 4, quality, out);
+                    encodeColorBlock(block, quality, out + 8);
+                    break;
+                case BlockFormat::BC4:
+                    encodeChannelBlock(block, 4, quality, out);
+                    break;
+                case BlockFormat::BC5:
+                    encodeChannelBlock(block, 4, quality, out);
+                    encodeChannelBlock(block + 1, 4, quality, out + 8);
+                    break;
+                case BlockFormat::BC7:
+                    encodeBC7Block(block, quality, out);
+                    break;
+            }
+        }
+    }
+}
+
+void common::decompressBlocks(BlockFormat format, const uint8_t *blocks, int width, int height, uint8_t *rgba,
+    int firstBlockRow, int blockRowCount)
+{
+    int blocksWide = (width + 3) / 4;
+    size_t bytesPerBlock = blockSize(format);
+
+    uint8_t block[64];
+    for (int blockY = firstBlockRow; blockY < firstBlockRow + blockRowCount; blockY++)
+    {
+        const uint8_t *in = blocks + (size_t) blockY * blocksWide * bytesPerBlock;
+        for (int blockX = 0; blockX < blocksWide; blockX++, in += bytesPerBlock)
+        {
+            // Opaque black until a channel is decoded
+            for (int i = 0; i < 16; i++)
+            {
+                block[i * 4] = block[i * 4 + 1] = block[i * 4 + 2] = 0;
+                block[i * 4 + 3] = 255;
+            }
+
+            switch (format)
+            {
+                case BlockFormat::BC1:
+                    decodeColorBlock(in, block);
+                    break;
+                case BlockFormat::BC3:
+                    decodeChannelBlock(in, block, 3);
+                    decodeColorBlock(in + 8, block);
+                    break;
+                case BlockFormat::BC4:
+                    decodeChannelBlock(in, block, 0);
+                    break;
+                case BlockFormat::BC5:
+                    decodeChannelBlock(in, block, 0);
+                    decodeChannelBlock(in + 8, block, 1);
+                    break;
+                case BlockFormat::BC7:
+                    decodeBC7Block(in, block);
+                    break;
+            }
+
+            // Only the part of the block inside the image
+            for (int y = 0; y < 4 && blockY * 4 + y < height; y++)
+            {
+                int columns = std::min(4, width - blockX * 4);
+                std::memcpy(rgba + ((size_t) (blockY * 4 + y) * width + blockX * 4) * 4, block + y * 16, columns * 4);
+            }
+        }
+    }
+}
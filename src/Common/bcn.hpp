@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace common
+{
+    // Block compressed formats, every one of them stores 4x4 pixel blocks
+    enum class BlockFormat : uint32_t
+    {
+        BC1 = 1, // RGB, 8 bytes
+        BC3 = 3, // RGBA, 16 bytes
+        BC4 = 4, // R, 8 bytes
+        BC5 = 5, // RG, 16 bytes
+        BC7 = 7  // RGBA, 16 bytes, modes 6 and 1 only
+    };
+
+    // How hard the encoder searches, the output size never changes
+    enum class BlockQuality : uint32_t
+    {
+        Fast,   // principal axis endpoints, no refinement
+        Normal, // plus a least squares pass, BC4 nudges its endpoints, BC7 tries every p-bit
+        High    // more passes, wider BC4 search, BC7 also tries two subsets on opaque blocks
+    };
+
+    size_t blockSize(BlockFormat format);
+
+    // Bytes needed for a whole width * height image
+    size_t compressedSize(BlockFormat format, int width, int height);
+
+    // Compresses block rows [firstBlockRow, firstBlockRow + blockRowCount) of an RGBA8
+    // image into blocks. blocks is always the start of a compressedSize buffer,
+    // so bands can be compressed in parallel into the same one.
+    // BC4 takes red, BC5 red and green. Blocks past the edge repeat the last pixel.
+    // Picks the widest instruction set the CPU supports the first time it's called.
+    void compressBlocks(BlockFormat format, BlockQuality quality, const uint8_t *rgba, int width, int height,
+        uint8_t *blocks, int firstBlockRow, int blockRowCount);
+
+    // The reverse, for checking the encoder. Banded the same way, rgba is the
+    // whole width * height * 4 image. Missing channels come out as 0, alpha as 255.
+    // BC7 blocks in modes the encoder never writes decode to zero.
+    void decompressBlocks(BlockFormat format, const uint8_t *blocks, int width, int height, uint8_t *rgba,
+        int firstBlockRow, int blockRowCount);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Runtime CPU feature checks for picking SIMD kernels
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COMMON_CPU_X86 1
+#endif
+
+#ifdef COMMON_CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions marked for it,
+// MSVC always accepts the intrinsics
+#if defined(COMMON_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define COMMON_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define COMMON_TARGET_AVX2
+#endif
+
+namespace common
+{
+    namespace cpu
+    {
+        inline bool hasAVX2()
+        {
+#if !defined(COMMON_CPU_X86)
+            return false;
+#elif defined(_MSC_VER)
+            static const bool supported = []()
+            {
+                int info[4];
+                __cpuid(info, 0);
+                if (info[0] < 7) return false;
+
+                __cpuid(info, 1);
+                bool osxsave = (info[2] & (1 << 27)) != 0;
+                bool avx = (info[2] & (1 << 28)) != 0;
+                if (!osxsave || !avx) return false;
+
+                // OS has to save the YMM registers
+                if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+                __cpuidex(info, 7, 0);
+                return (info[1] & (1 << 5)) != 0;
+            }();
+            return supported;
+#else
+            static const bool supported = __builtin_cpu_supports("avx2");
+            return supported;
+#endif
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mappedfile.hpp"
+
+using namespace common;
+
+MappedFile::MappedFile(const std::string &path)
+{
+    open(path);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this == &other) return *this;
+
+    close();
+
+    std::swap(mapData, other.mapData);
+    std::swap(mapSize, other.mapSize);
+#ifdef _WIN32
+    std::swap(fileHandle, other.fileHandle);
+    std::swap(mappingHandle, other.mappingHandle);
+#else
+    std::swap(fileDescriptor, other.fileDescriptor);
+#endif
+
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    mapData = (const char *) view;
+    mapSize = (size_t) fileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapData) UnmapViewOfFile(mapData);
+    if (mappingHandle) CloseHandle((HANDLE) mappingHandle);
+    if (fileHandle) CloseHandle((HANDLE) fileHandle);
+
+    mapData = nullptr;
+    mapSize = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // We walk the chunks front to back
+    madvise(view, (size_t) fileStat.st_size, MADV_SEQUENTIAL);
+
+    fileDescriptor = fd;
+    mapData = (const char *) view;
+    mapSize = (size_t) fileStat.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapData) munmap((void *) mapData, mapSize);
+    if (fileDescriptor >= 0) ::close(fileDescriptor);
+
+    mapData = nullptr;
+    mapSize = 0;
+    fileDescriptor = -1;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+
+namespace common
+{
+    // Read-only view of an entire file mapped into memory.
+    // The mapping lives as long as the object, so anything
+    // pointing into data() must not outlive it.
+    class MappedFile
+    {
+        const char *mapData = nullptr;
+        size_t mapSize = 0;
+
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#else
+        int fileDescriptor = -1;
+#endif
+
+    public:
+        MappedFile() = default;
+        MappedFile(const std::string &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        // Returns false if the file can't be opened or is empty
+        bool open(const std::string &path);
+        void close();
+
+        bool isOpen() const { return mapData != nullptr; }
+        const char *data() const { return mapData; }
+        size_t size() const { return mapSize; }
+    };
+}
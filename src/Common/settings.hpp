@@ -4,6 +4,47 @@ namespace common
 {
     namespace settings
     {
-        const char* ASSET_DIR = "assets"; 
+        inline const char* ASSET_DIR = "assets";
+
+        // Upload meshes as 20 byte quantized vertices (QTangent frame) instead of 52 byte floats
+        inline bool COMPACT_VERTICES = true;
+
+        // Upload positions as their own stream so depth only passes fetch just those
+        inline bool SPLIT_VERTEX_STREAMS = false;
+
+        // LODs built per mesh at cook time, 1 turns them off
+        inline unsigned MESH_LOD_COUNT = 4;
+
+        // Coarsest LOD whose error projects under this many pixels gets drawn
+        inline float LOD_PIXEL_ERROR = 1.0f;
+
+        // Cull meshlets against the frustum before drawing
+        inline bool MESHLET_CULLING = true;
+
+        // Also cull meshlets by their normal cones, and back faces with GL_CULL_FACE to match.
+        // Off since PSK winding (mirrored by the Y/Z swap) hasn't been checked on real assets,
+        // and the viewer draws both sides of hair cards and cloth without it.
+        inline bool MESHLET_CONE_CULLING = false;
+
+        // Load textures from their block compressed .ctex files, cooking them on first use
+        inline bool COOKED_TEXTURES = true;
+
+        // How hard the cook searches for block endpoints, 0 fast, 1 normal, 2 high
+        inline unsigned TEXTURE_COOK_QUALITY = 1;
+
+        // Cook color textures as BC7 instead of BC1/BC3, twice the size of BC1 but sharper.
+        // Neither setting recooks what's already cooked, run texture-cooker -f for that.
+        inline bool COLOR_TEXTURES_BC7 = false;
+
+        // Persistently mapped unpack buffer textures are decoded into, 0 uploads from client memory
+        inline unsigned TEXTURE_STAGING_RING_MB = 128;
+
+        // Texture bytes issued to GL per frame while streaming, 0 issues everything at once
+        inline float TEXTURE_UPLOAD_BUDGET_MB = 16.0f;
+
+        // Textures of the same size and format share arrays, each one twice the layers
+        // of the one before, up to this many layers and MB
+        inline unsigned TEXTURE_POOL_LAYERS = 16;
+        inline unsigned TEXTURE_POOL_ARRAY_MB = 64;
     }
 }
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include <cstring>
+#include <algorithm>
+
+#include "cpu.hpp"
+#include "tga.hpp"
+
+using namespace common;
+
+typedef void (*RowKernel)(uint8_t *, const uint8_t *, size_t);
+
+/*************************** SCALAR ***************************/
+
+// Any stored format to any output format, matching stb_image's conversions
+static void convertRowScalar(uint8_t *dst, int dstChannels, const uint8_t *src, int srcChannels, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t r, g, b, a = 255;
+        if (srcChannels == 1)
+        {
+            r = g = b = src[0];
+        }
+        else
+        {
+            b = src[0];
+            g = src[1];
+            r = src[2];
+            if (srcChannels == 4) a = src[3];
+        }
+
+        if (dstChannels == 1)
+        {
+            dst[0] = srcChannels == 1 ? r : (uint8_t) ((r * 77 + g * 150 + b * 29) >> 8);
+        }
+        else
+        {
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            if (dstChannels == 4) dst[3] = a;
+        }
+
+        src += srcChannels;
+        dst += dstChannels;
+    }
+}
+
+static void bgraToRgbaScalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t pixel;
+        std::memcpy(&pixel, src + i * 4, 4);
+        pixel = (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16);
+        std::memcpy(dst + i * 4, &pixel, 4);
+    }
+}
+
+static void bgrToRgbaScalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    convertRowScalar(dst, 4, src, 3, count);
+}
+
+static void bgrToRgbScalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t b = src[i * 3];
+        dst[i * 3] = src[i * 3 + 2];
+        dst[i * 3 + 1] = src[i * 3 + 1];
+        dst[i * 3 + 2] = b;
+    }
+}
+
+#ifdef COMMON_CPU_X86
+
+/*************************** SSE2 ***************************/
+
+// Swaps bytes 0 and 2 of every pixel, 4 pixels per register
+static void bgraToRgbaSSE2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const __m128i keepGA = _mm_set1_epi32((int) 0xFF00FF00);
+    const __m128i keepBR = _mm_set1_epi32(0x00FF00FF);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (src + i * 4));
+        __m128i br = _mm_and_si128(pixels, keepBR);
+        __m128i rb = _mm_or_si128(_mm_srli_epi32(br, 16), _mm_slli_epi32(br, 16));
+        _mm_storeu_si128((__m128i *) (dst + i * 4), _mm_or_si128(_mm_and_si128(pixels, keepGA), rb));
+    }
+
+    bgraToRgbaScalar(dst + i * 4, src + i * 4, count - i);
+}
+
+/*************************** AVX2 ***************************/
+
+COMMON_TARGET_AVX2
+static void bgraToRgbaAVX2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const __m256i swizzle = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + i * 4 + 32));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_shuffle_epi8(a, swizzle));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4 + 32), _mm256_shuffle_epi8(b, swizzle));
+    }
+
+    bgraToRgbaSSE2(dst + i * 4, src + i * 4, count - i);
+}
+
+// 4 BGR pixels (12 bytes) per lane, the upper lane loads 12 bytes in.
+// Each lane reads 16 bytes, so the loop stops while 4 spare bytes remain.
+COMMON_TARGET_AVX2
+static void bgrToRgbaAVX2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const __m256i swizzle = _mm256_setr_epi8(
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8)
+    {
+        const uint8_t *in = src + i * 3;
+        __m256i pixels = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) in)),
+            _mm_loadu_si128((const __m128i *) (in + 12)), 1);
+
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, swizzle), alpha));
+    }
+
+    bgrToRgbaScalar(dst + i * 4, src + i * 3, count - i);
+}
+
+// 5 pixels (15 bytes) per 16 byte register. Every store writes one byte
+// past its pixels, which the next store overwrites, so the loop stops
+// while a spare pixel remains.
+COMMON_TARGET_AVX2
+static void bgrToRgbAVX2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 11 <= count; i += 10)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i * 3));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i * 3 + 15));
+        _mm_storeu_si128((__m128i *) (dst + i * 3), _mm_shuffle_epi8(a, swizzle));
+        _mm_storeu_si128((__m128i *) (dst + i * 3 + 15), _mm_shuffle_epi8(b, swizzle));
+    }
+
+    bgrToRgbScalar(dst + i * 3, src + i * 3, count - i);
+}
+
+#endif
+
+/*************************** DISPATCH ***************************/
+
+static RowKernel selectBgraToRgbaKernel()
+{
+#ifdef COMMON_CPU_X86
+    if (cpu::hasAVX2()) return bgraToRgbaAVX2;
+    return bgraToRgbaSSE2;
+#else
+    return bgraToRgbaScalar;
+#endif
+}
+
+static RowKernel selectBgrToRgbaKernel()
+{
+#ifdef COMMON_CPU_X86
+    if (cpu::hasAVX2()) return bgrToRgbaAVX2;
+#endif
+    return bgrToRgbaScalar;
+}
+
+static RowKernel selectBgrToRgbKernel()
+{
+#ifdef COMMON_CPU_X86
+    if (cpu::hasAVX2()) return bgrToRgbAVX2;
+#endif
+    return bgrToRgbScalar;
+}
+
+// The conversions the engine actually hits (RGBA for texture arrays,
+// stored channels for everything else) get their own kernels,
+// the rest is rare enough for the scalar path
+static void convertRow(uint8_t *dst, int dstChannels, const uint8_t *src, int srcChannels, size_t count)
+{
+    static const RowKernel bgraToRgba = selectBgraToRgbaKernel();
+    static const RowKernel bgrToRgba = selectBgrToRgbaKernel();
+    static const RowKernel bgrToRgb = selectBgrToRgbKernel();
+
+    if (dstChannels == 4 && srcChannels == 4) bgraToRgba(dst, src, count);
+    else if (dstChannels == 4 && srcChannels == 3) bgrToRgba(dst, src, count);
+    else if (dstChannels == 3 && srcChannels == 3) bgrToRgb(dst, src, count);
+    else if (dstChannels == 1 && srcChannels == 1) std::memcpy(dst, src, count);
+    else convertRowScalar(dst, dstChannels, src, srcChannels, count);
+}
+
+/*************************** DECODING ***************************/
+
+bool common::readTgaInfo(const uint8_t *data, size_t size, TgaInfo &info)
+{
+    if (size < 18) return false;
+
+    uint8_t idLength = data[0];
+    uint8_t colorMapType = data[1];
+    uint8_t imageType = data[2];
+    int width = data[12] | (data[13] << 8);
+    int height = data[14] | (data[15] << 8);
+    uint8_t bitsPerPixel = data[16];
+    uint8_t descriptor = data[17];
+
+    if (colorMapType != 0) return false;
+    if (width == 0 || height == 0) return false;
+
+    // Right to left storage, never seen in practice
+    if (descriptor & 0x10) return false;
+
+    bool gray = imageType == 3 || imageType == 11;
+    bool trueColor = imageType == 2 || imageType == 10;
+    if (gray && bitsPerPixel != 8) return false;
+    if (trueColor && bitsPerPixel != 24 && bitsPerPixel != 32) return false;
+    if (!gray && !trueColor) return false;
+
+    info.width = width;
+    info.height = height;
+    info.channels = bitsPerPixel / 8;
+    info.rle = imageType >= 9;
+    info.topDown = (descriptor & 0x20) != 0;
+    info.pixelOffset = 18 + (size_t) idLength;
+
+    return info.pixelOffset <= size;
+}
+
+static bool decodeUncompressed(const uint8_t *data, size_t size, const TgaInfo &info, uint8_t *pixels, int channels,
+    int firstRow, int rowCount)
+{
+    size_t srcStride = (size_t) info.width * info.channels;
+    size_t dstStride = (size_t) info.width * channels;
+    if (size - info.pixelOffset < srcStride * info.height) return false;
+
+    const uint8_t *base = data + info.pixelOffset;
+    for (int y = firstRow; y < firstRow + rowCount; y++)
+    {
+        int storedRow = info.topDown ? y : info.height - 1 - y;
+        convertRow(pixels + y * dstStride, channels, base + storedRow * srcStride, info.channels, info.width);
+    }
+    return true;
+}
+
+static void fillPixels(uint8_t *dst, const uint8_t *pixel, int channels, size_t count)
+{
+    if (channels == 4)
+    {
+        uint32_t value;
+        std::memcpy(&value, pixel, 4);
+        for (size_t i = 0; i < count; i++) std::memcpy(dst + i * 4, &value, 4);
+    }
+    else if (channels == 1)
+    {
+        std::memset(dst, pixel[0], count);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++) std::memcpy(dst + i * channels, pixel, channels);
+    }
+}
+
+// Packets may run across rows, so they're split at row ends
+static bool decodeRLE(const uint8_t *data, size_t size, const TgaInfo &info, uint8_t *pixels, int channels)
+{
+    const uint8_t *src = data + info.pixelOffset;
+    const uint8_t *end = data + size;
+
+    size_t dstStride = (size_t) info.width * channels;
+    size_t remaining = (size_t) info.width * info.height;
+
+    int storedRow = 0;
+    int column = 0;
+    auto rowStart = [&](int row) { return pixels + (info.topDown ? row : info.height - 1 - row) * dstStride; };
+    uint8_t *row = rowStart(0);
+
+    while (remaining > 0)
+    {
+        if (src == end) return false;
+
+        uint8_t header = *src++;
+        size_t count = std::min((size_t) (header & 0x7F) + 1, remaining);
+        bool run = (header & 0x80) != 0;
+
+        // A run is one stored pixel, converted once and repeated
+        uint8_t runPixel[4];
+        if (run)
+        {
+            if ((size_t) (end - src) < (size_t) info.channels) return false;
+            convertRowScalar(runPixel, channels, src, info.channels, 1);
+            src += info.channels;
+        }
+        else if ((size_t) (end - src) < count * info.channels)
+        {
+            return false;
+        }
+
+        while (count > 0)
+        {
+            size_t span = std::min(count, (size_t) (info.width - column));
+            uint8_t *dst = row + (size_t) column * channels;
+
+            if (run)
+            {
+                fillPixels(dst, runPixel, channels, span);
+            }
+            else
+            {
+                convertRow(dst, channels, src, info.channels, span);
+                src += span * info.channels;
+            }
+
+            count -= span;
+            remaining -= span;
+            column += (int) span;
+            if (column == info.width && remaining > 0)
+            {
+                column = 0;
+                row = rowStart(++storedRow);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool common::decodeTga(const uint8_t *data, size_t size, const TgaInfo &info, uint8_t *pixels, int channels,
+    int firstRow, int rowCount)
+{
+    if (channels != 1 && channels != 3 && channels != 4) return false;
+    if (firstRow < 0 || rowCount < 0 || firstRow + rowCount > info.height) return false;
+
+    if (info.rle)
+    {
+        if (firstRow != 0 || rowCount != info.height) return false;
+        return decodeRLE(data, size, info, pixels, channels);
+    }
+
+    return decodeUncompressed(data, size, info, pixels, channels, firstRow, rowCount);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace common
+{
+    // What the decoder needs from a .tga header
+    struct TgaInfo
+    {
+        int width = 0;
+        int height = 0;
+        int channels = 0;       // as stored: 1 (gray), 3 (BGR) or 4 (BGRA)
+        bool rle = false;
+        bool topDown = false;   // rows stored top first, bottom first otherwise
+        size_t pixelOffset = 0; // from the start of the file
+    };
+
+    // Accepts uncompressed and RLE true color (24/32 bit) and grayscale (8 bit)
+    // images without a color map. Returns false for anything else (color mapped,
+    // 16 bit, right to left), stb_image handles those.
+    bool readTgaInfo(const uint8_t *data, size_t size, TgaInfo &info);
+
+    // Decodes rows [firstRow, firstRow + rowCount) of the image, counted from the
+    // top, into pixels. pixels is always the start of a width * height * channels
+    // buffer, so bands can be decoded in parallel into the same one.
+    // channels is 1, 3 or 4 and converts like stb_image does: RGB(A) order, gray
+    // expands to all three, missing alpha is 255.
+    // RLE images can only be decoded whole. Returns false on truncated data.
+    bool decodeTga(const uint8_t *data, size_t size, const TgaInfo &info, uint8_t *pixels, int channels,
+        int firstRow, int rowCount);
+}
@@ -0,0 +1,637 @@
+#include <cstring>
+#include <algorithm>
+
+#include "../../Common/cpu.hpp"
+#include "meshopt.hpp"
+
+using namespace uam;
+
+/*************************** INDEX CODEC ***************************/
+
+// Every triangle gets one code byte, anything that doesn't fit in it goes
+// to a varint data stream stored after all the code bytes.
+//
+// High nibble: which recent edge the triangle shares, or INDEX_NO_EDGE.
+// Low nibble (shared edge only), for the third vertex:
+//   0                   it's the next never seen vertex
+//   1..14               it's in the vertex FIFO, 1 is the newest
+//   INDEX_EXPLICIT      zigzag delta from the last explicit vertex follows in the data stream
+//
+// Triangles without a shared edge write a token per vertex to the data stream:
+//   0 next, 1..15 vertex FIFO, 16 + zigzag delta otherwise.
+//
+// Triangles keep their winding but may come back rotated.
+
+#define INDEX_EDGE_FIFO 16
+#define INDEX_VERTEX_FIFO 16
+#define INDEX_NO_EDGE 15
+#define INDEX_EXPLICIT 15
+#define INDEX_TOKEN_EXPLICIT 16
+
+struct IndexCodecState
+{
+    GLuint edges[INDEX_EDGE_FIFO][2] = {};
+    GLuint vertices[INDEX_VERTEX_FIFO] = {};
+    uint32_t edgeOffset = 0;
+    uint32_t vertexOffset = 0;
+
+    GLuint next = 0;
+    GLuint last = 0;
+
+    void pushEdge(GLuint a, GLuint b)
+    {
+        edges[edgeOffset][0] = a;
+        edges[edgeOffset][1] = b;
+        edgeOffset = (edgeOffset + 1) % INDEX_EDGE_FIFO;
+    }
+
+    void pushVertex(GLuint v)
+    {
+        vertices[vertexOffset] = v;
+        vertexOffset = (vertexOffset + 1) % INDEX_VERTEX_FIFO;
+    }
+
+    // distance 0 is the newest entry
+    const GLuint *edge(uint32_t distance) const
+    {
+        return edges[(edgeOffset + INDEX_EDGE_FIFO - 1 - distance) % INDEX_EDGE_FIFO];
+    }
+
+    GLuint vertex(uint32_t distance) const
+    {
+        return vertices[(vertexOffset + INDEX_VERTEX_FIFO - 1 - distance) % INDEX_VERTEX_FIFO];
+    }
+
+    int findVertex(GLuint v, uint32_t maxDistance) const
+    {
+        for (uint32_t distance = 0; distance < maxDistance; distance++)
+        {
+            if (vertex(distance) == v) return (int) distance;
+        }
+        return -1;
+    }
+};
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+static void writeVarint(std::vector<uint8_t> &data, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    data.push_back((uint8_t) value);
+}
+
+static bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7)
+    {
+        if (data == end) return false;
+
+        uint8_t byte = *data++;
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+static void encodeVertexToken(IndexCodecState &state, std::vector<uint8_t> &data, GLuint v)
+{
+    if (v == state.next)
+    {
+        data.push_back(0);
+        state.next++;
+        state.pushVertex(v);
+        return;
+    }
+
+    int distance = state.findVertex(v, INDEX_TOKEN_EXPLICIT - 1);
+    if (distance >= 0)
+    {
+        data.push_back((uint8_t) (distance + 1));
+        return;
+    }
+
+    writeVarint(data, INDEX_TOKEN_EXPLICIT + zigzag((int32_t) (v - state.last)));
+    state.last = v;
+    state.pushVertex(v);
+}
+
+static bool decodeVertexToken(IndexCodecState &state, const uint8_t *&data, const uint8_t *end, GLuint &v)
+{
+    uint32_t token;
+    if (!readVarint(data, end, token)) return false;
+
+    if (token == 0)
+    {
+        v = state.next++;
+        state.pushVertex(v);
+    }
+    else if (token < INDEX_TOKEN_EXPLICIT)
+    {
+        v = state.vertex(token - 1);
+    }
+    else
+    {
+        v = state.last + (GLuint) unzigzag(token - INDEX_TOKEN_EXPLICIT);
+        state.last = v;
+        state.pushVertex(v);
+    }
+    return true;
+}
+
+void uam::encodeIndexBuffer(const GLuint *indices, size_t indexCount, std::vector<uint8_t> &encoded)
+{
+    size_t triangleCount = indexCount / 3;
+
+    std::vector<uint8_t> codes(triangleCount);
+    std::vector<uint8_t> data;
+    data.reserve(triangleCount);
+
+    IndexCodecState state;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const GLuint *triangle = indices + t * 3;
+
+        // Look for a recent edge matching any rotation of the triangle
+        int edgeDistance = -1;
+        int rotation = 0;
+        for (int distance = 0; distance < INDEX_NO_EDGE && edgeDistance < 0; distance++)
+        {
+            const GLuint *edge = state.edge((uint32_t) distance);
+            for (int r = 0; r < 3; r++)
+            {
+                if (edge[0] == triangle[r] && edge[1] == triangle[(r + 1) % 3])
+                {
+                    edgeDistance = distance;
+                    rotation = r;
+                    break;
+                }
+            }
+        }
+
+        if (edgeDistance < 0)
+        {
+            GLuint a = triangle[0], b = triangle[1], c = triangle[2];
+            codes[t] = INDEX_NO_EDGE << 4;
+
+            encodeVertexToken(state, data, a);
+            encodeVertexToken(state, data, b);
+            encodeVertexToken(state, data, c);
+
+            state.pushEdge(b, a);
+            state.pushEdge(c, b);
+            state.pushEdge(a, c);
+            continue;
+        }
+
+        GLuint a = triangle[rotation], b = triangle[(rotation + 1) % 3], c = triangle[(rotation + 2) % 3];
+
+        uint8_t third;
+        if (c == state.next)
+        {
+            third = 0;
+            state.next++;
+            state.pushVertex(c);
+        }
+        else
+        {
+            int vertexDistance = state.findVertex(c, INDEX_EXPLICIT - 1);
+            if (vertexDistance >= 0)
+            {
+                third = (uint8_t) (vertexDistance + 1);
+            }
+            else
+            {
+                third = INDEX_EXPLICIT;
+                writeVarint(data, zigzag((int32_t) (c - state.last)));
+                state.last = c;
+                state.pushVertex(c);
+            }
+        }
+
+        codes[t] = (uint8_t) ((edgeDistance << 4) | third);
+
+        state.pushEdge(c, b);
+        state.pushEdge(a, c);
+    }
+
+    encoded.clear();
+    encoded.reserve(codes.size() + data.size());
+    encoded.insert(encoded.end(), codes.begin(), codes.end());
+    encoded.insert(encoded.end(), data.begin(), data.end());
+}
+
+bool uam::decodeIndexBuffer(const uint8_t *encoded, size_t encodedSize, GLuint *indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (indexCount % 3 != 0 || encodedSize < triangleCount) return false;
+
+    const uint8_t *codes = encoded;
+    const uint8_t *data = encoded + triangleCount;
+    const uint8_t *end = encoded + encodedSize;
+
+    IndexCodecState state;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        uint8_t code = codes[t];
+        uint32_t edgeDistance = code >> 4;
+        uint32_t third = code & 15;
+
+        GLuint a, b, c;
+        if (edgeDistance == INDEX_NO_EDGE)
+        {
+            if (!decodeVertexToken(state, data, end, a)) return false;
+            if (!decodeVertexToken(state, data, end, b)) return false;
+            if (!decodeVertexToken(state, data, end, c)) return false;
+
+            state.pushEdge(b, a);
+            state.pushEdge(c, b);
+            state.pushEdge(a, c);
+        }
+        else
+        {
+            const GLuint *edge = state.edge(edgeDistance);
+            a = edge[0];
+            b = edge[1];
+
+            if (third == 0)
+            {
+                c = state.next++;
+                state.pushVertex(c);
+            }
+            else if (third < INDEX_EXPLICIT)
+            {
+                c = state.vertex(third - 1);
+            }
+            else
+            {
+                uint32_t delta;
+                if (!readVarint(data, end, delta)) return false;
+
+                c = state.last + (GLuint) unzigzag(delta);
+                state.last = c;
+                state.pushVertex(c);
+            }
+
+            state.pushEdge(c, b);
+            state.pushEdge(a, c);
+        }
+
+        if (a >= vertexCount || b >= vertexCount || c >= vertexCount) return false;
+
+        indices[t * 3 + 0] = a;
+        indices[t * 3 + 1] = b;
+        indices[t * 3 + 2] = c;
+    }
+
+    return data == end;
+}
+
+/*************************** VERTEX CODEC ***************************/
+
+// Vertices are cut into blocks and each block is stored byte transposed:
+// byte k of every vertex, then byte k + 1 and so on. Every byte is
+// replaced by its zigzagged difference from the same byte of the previous
+// vertex, which is small whenever neighbouring vertices are alike (they
+// are, after optimizeVertexFetch).
+//
+// Each column is split into groups of 16 bytes. A 2 bit mode per group,
+// four to a header byte at the start of the column, says how many bits
+// every delta in the group takes: 0, 2, 4 or 8.
+//
+// 4 bit groups hold values i and i + 8 in byte i, 2 bit groups hold
+// values i, i + 4, i + 8 and i + 12 in byte i. Both unpack straight
+// into a SIMD register.
+
+#define VERTEX_BLOCK_SIZE 256
+#define VERTEX_GROUP_SIZE 16
+#define VERTEX_MAX_SIZE 256
+
+static const uint32_t GROUP_BITS[4] = { 0, 2, 4, 8 };
+
+static size_t groupDataSize(uint32_t mode)
+{
+    return GROUP_BITS[mode] * VERTEX_GROUP_SIZE / 8;
+}
+
+static uint8_t zigzagByte(uint8_t value)
+{
+    return (uint8_t) ((value << 1) ^ (uint8_t) ((int8_t) value >> 7));
+}
+
+static void encodeGroup(const uint8_t *values, uint32_t mode, std::vector<uint8_t> &encoded)
+{
+    if (mode == 1)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            encoded.push_back((uint8_t) (values[i] | (values[i + 4] << 2) | (values[i + 8] << 4) | (values[i + 12] << 6)));
+        }
+    }
+    else if (mode == 2)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            encoded.push_back((uint8_t) (values[i] | (values[i + 8] << 4)));
+        }
+    }
+    else if (mode == 3)
+    {
+        encoded.insert(encoded.end(), values, values + VERTEX_GROUP_SIZE);
+    }
+}
+
+void uam::encodeVertexBuffer(const void *vertices, size_t vertexCount, size_t vertexSize, std::vector<uint8_t> &encoded)
+{
+    encoded.clear();
+
+    const uint8_t *bytes = (const uint8_t *) vertices;
+    uint8_t last[VERTEX_MAX_SIZE] = {};
+
+    for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VERTEX_BLOCK_SIZE)
+    {
+        size_t blockVertices = std::min((size_t) VERTEX_BLOCK_SIZE, vertexCount - blockStart);
+        size_t groupCount = (blockVertices + VERTEX_GROUP_SIZE - 1) / VERTEX_GROUP_SIZE;
+
+        for (size_t k = 0; k < vertexSize; k++)
+        {
+            // Deltas for the whole column, padding repeats the last vertex
+            uint8_t deltas[VERTEX_BLOCK_SIZE] = {};
+            uint8_t previous = last[k];
+            for (size_t i = 0; i < blockVertices; i++)
+            {
+                uint8_t value = bytes[(blockStart + i) * vertexSize + k];
+                deltas[i] = zigzagByte((uint8_t) (value - previous));
+                previous = value;
+            }
+            last[k] = previous;
+
+            size_t headerStart = encoded.size();
+            encoded.resize(headerStart + (groupCount + 3) / 4, 0);
+
+            for (size_t g = 0; g < groupCount; g++)
+            {
+                const uint8_t *values = deltas + g * VERTEX_GROUP_SIZE;
+                uint8_t largest = *std::max_element(values, values + VERTEX_GROUP_SIZE);
+
+                uint32_t mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+                encoded[headerStart + g / 4] |= (uint8_t) (mode << ((g % 4) * 2));
+                encodeGroup(values, mode, encoded);
+            }
+        }
+    }
+}
+
+#ifdef COMMON_CPU_X86
+
+static __m128i decodeGroup(const uint8_t *data, uint32_t mode)
+{
+    const __m128i lowBits = _mm_set1_epi8(mode == 1 ? 0x03 : 0x0F);
+
+    if (mode == 0)
+    {
+        return _mm_setzero_si128();
+    }
+    else if (mode == 1)
+    {
+        int32_t packed;
+        std::memcpy(&packed, data, 4);
+        __m128i x = _mm_cvtsi32_si128(packed);
+
+        __m128i v0 = _mm_and_si128(x, lowBits);
+        __m128i v1 = _mm_and_si128(_mm_srli_epi16(x, 2), lowBits);
+        __m128i v2 = _mm_and_si128(_mm_srli_epi16(x, 4), lowBits);
+        __m128i v3 = _mm_and_si128(_mm_srli_epi16(x, 6), lowBits);
+        return _mm_unpacklo_epi64(_mm_unpacklo_epi32(v0, v1), _mm_unpacklo_epi32(v2, v3));
+    }
+    else if (mode == 2)
+    {
+        __m128i x = _mm_loadl_epi64((const __m128i *) data);
+        __m128i low = _mm_and_si128(x, lowBits);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), lowBits);
+        return _mm_unpacklo_epi64(low, high);
+    }
+
+    return _mm_loadu_si128((const __m128i *) data);
+}
+
+// Undoes the zigzag and the deltas, returns the absolute bytes.
+// previous has the byte before the group in every lane.
+static __m128i integrateGroup(__m128i deltas, __m128i previous)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low7 = _mm_set1_epi8(0x7F);
+
+    __m128i halved = _mm_and_si128(_mm_srli_epi16(deltas, 1), low7);
+    __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(deltas, one));
+    __m128i x = _mm_xor_si128(halved, sign);
+
+    // Prefix sum across the 16 lanes
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+    return _mm_add_epi8(x, previous);
+}
+
+// Copies byte 15 into every lane, staying in registers
+static __m128i broadcastLastByte(__m128i x)
+{
+    x = _mm_unpackhi_epi8(x, x);
+    x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_unpackhi_epi64(x, x);
+}
+
+// 4 columns of 16 bytes into rows[r] holding vertices 4r..4r+3, 4 bytes each
+static void transposeColumns4(const uint8_t *columns, size_t columnStride, __m128i rows[4])
+{
+    __m128i c0 = _mm_loadu_si128((const __m128i *) (columns + columnStride * 0));
+    __m128i c1 = _mm_loadu_si128((const __m128i *) (columns + columnStride * 1));
+    __m128i c2 = _mm_loadu_si128((const __m128i *) (columns + columnStride * 2));
+    __m128i c3 = _mm_loadu_si128((const __m128i *) (columns + columnStride * 3));
+
+    __m128i t0 = _mm_unpacklo_epi8(c0, c1);
+    __m128i t1 = _mm_unpackhi_epi8(c0, c1);
+    __m128i t2 = _mm_unpacklo_epi8(c2, c3);
+    __m128i t3 = _mm_unpackhi_epi8(c2, c3);
+
+    rows[0] = _mm_unpacklo_epi16(t0, t2);
+    rows[1] = _mm_unpackhi_epi16(t0, t2);
+    rows[2] = _mm_unpacklo_epi16(t1, t3);
+    rows[3] = _mm_unpackhi_epi16(t1, t3);
+}
+
+// 16 columns into 16 vertices of 16 bytes each
+static void transposeColumns16(const uint8_t *columns, size_t columnStride, uint8_t *vertices, size_t vertexSize)
+{
+    __m128i quads[4][4];
+    for (int q = 0; q < 4; q++)
+    {
+        transposeColumns4(columns + columnStride * 4 * q, columnStride, quads[q]);
+    }
+
+    // Each vertex takes one dword from every quad
+    for (int r = 0; r < 4; r++)
+    {
+        __m128i a = _mm_unpacklo_epi32(quads[0][r], quads[1][r]);
+        __m128i b = _mm_unpackhi_epi32(quads[0][r], quads[1][r]);
+        __m128i c = _mm_unpacklo_epi32(quads[2][r], quads[3][r]);
+        __m128i d = _mm_unpackhi_epi32(quads[2][r], quads[3][r]);
+
+        _mm_storeu_si128((__m128i *) (vertices + (r * 4 + 0) * vertexSize), _mm_unpacklo_epi64(a, c));
+        _mm_storeu_si128((__m128i *) (vertices + (r * 4 + 1) * vertexSize), _mm_unpackhi_epi64(a, c));
+        _mm_storeu_si128((__m128i *) (vertices + (r * 4 + 2) * vertexSize), _mm_unpacklo_epi64(b, d));
+        _mm_storeu_si128((__m128i *) (vertices + (r * 4 + 3) * vertexSize), _mm_unpackhi_epi64(b, d));
+    }
+}
+
+// 4 columns into 16 vertices of 4 bytes each, for whatever 16 columns leave over
+static void transposeColumns(const uint8_t *columns, size_t columnStride, uint8_t *vertices, size_t vertexSize)
+{
+    __m128i rows[4];
+    transposeColumns4(columns, columnStride, rows);
+
+    for (int r = 0; r < 4; r++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            int32_t value = _mm_cvtsi128_si32(rows[r]);
+            std::memcpy(vertices + (r * 4 + i) * vertexSize, &value, 4);
+            rows[r] = _mm_srli_si128(rows[r], 4);
+        }
+    }
+}
+
+#endif
+
+// Decodes groupCount groups of one column, returns where the next column
+// starts or nullptr if the stream runs out. last carries the column's
+// final byte from block to block.
+static const uint8_t *decodeColumn(const uint8_t *data, const uint8_t *end, const uint8_t *header, size_t groupCount,
+    uint8_t *column, uint8_t &last)
+{
+#ifdef COMMON_CPU_X86
+    __m128i previous = _mm_set1_epi8((char) last);
+#else
+    uint8_t previous = last;
+#endif
+
+    for (size_t g = 0; g < groupCount; g++)
+    {
+        uint32_t mode = (header[g / 4] >> ((g % 4) * 2)) & 3;
+        size_t dataSize = groupDataSize(mode);
+        if ((size_t) (end - data) < dataSize) return nullptr;
+
+        uint8_t *values = column + g * VERTEX_GROUP_SIZE;
+#ifdef COMMON_CPU_X86
+        // decodeGroup reads exactly dataSize bytes
+        __m128i decoded = integrateGroup(decodeGroup(data, mode), previous);
+        _mm_storeu_si128((__m128i *) values, decoded);
+        previous = broadcastLastByte(decoded);
+#else
+        for (size_t i = 0; i < VERTEX_GROUP_SIZE; i++)
+        {
+            uint8_t delta = 0;
+            if (mode == 1) delta = (data[i % 4] >> ((i / 4) * 2)) & 3;
+            else if (mode == 2) delta = (data[i % 8] >> ((i / 8) * 4)) & 15;
+            else if (mode == 3) delta = data[i];
+
+            previous = (uint8_t) (previous + (uint8_t) ((delta >> 1) ^ -(delta & 1)));
+            values[i] = previous;
+        }
+#endif
+        data += dataSize;
+    }
+
+    last = column[groupCount * VERTEX_GROUP_SIZE - 1];
+    return data;
+}
+
+size_t uam::minimumEncodedVertexBufferSize(size_t vertexCount, size_t vertexSize)
+{
+    // Every column of every block has its headers, even when all its deltas are zero
+    size_t fullBlocks = vertexCount / VERTEX_BLOCK_SIZE;
+    size_t lastGroups = (vertexCount % VERTEX_BLOCK_SIZE + VERTEX_GROUP_SIZE - 1) / VERTEX_GROUP_SIZE;
+    size_t fullHeaderSize = (VERTEX_BLOCK_SIZE / VERTEX_GROUP_SIZE + 3) / 4;
+
+    return (fullBlocks * fullHeaderSize + (lastGroups + 3) / 4) * vertexSize;
+}
+
+bool uam::decodeVertexBuffer(const uint8_t *encoded, size_t encodedSize, void *vertices, size_t vertexCount, size_t vertexSize)
+{
+    if (vertexSize == 0 || vertexSize > VERTEX_MAX_SIZE || vertexSize % 4 != 0) return false;
+
+    const uint8_t *data = encoded;
+    const uint8_t *end = encoded + encodedSize;
+    uint8_t *output = (uint8_t *) vertices;
+
+    uint8_t last[VERTEX_MAX_SIZE] = {};
+
+    // Decoded block, column by column
+    std::vector<uint8_t> columns(vertexSize * VERTEX_BLOCK_SIZE);
+    uint8_t tail[VERTEX_GROUP_SIZE * VERTEX_MAX_SIZE];
+
+    for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VERTEX_BLOCK_SIZE)
+    {
+        size_t blockVertices = std::min((size_t) VERTEX_BLOCK_SIZE, vertexCount - blockStart);
+        size_t groupCount = (blockVertices + VERTEX_GROUP_SIZE - 1) / VERTEX_GROUP_SIZE;
+        size_t headerSize = (groupCount + 3) / 4;
+
+        for (size_t k = 0; k < vertexSize; k++)
+        {
+            if ((size_t) (end - data) < headerSize) return false;
+            const uint8_t *header = data;
+            data += headerSize;
+
+            data = decodeColumn(data, end, header, groupCount, columns.data() + k * VERTEX_BLOCK_SIZE, last[k]);
+            if (!data) return false;
+        }
+
+        // Back to interleaved vertices
+        for (size_t g = 0; g < groupCount; g++)
+        {
+            size_t first = g * VERTEX_GROUP_SIZE;
+            size_t count = std::min((size_t) VERTEX_GROUP_SIZE, blockVertices - first);
+            uint8_t *destination = count == VERTEX_GROUP_SIZE ? output + (blockStart + first) * vertexSize : tail;
+
+#ifdef COMMON_CPU_X86
+            size_t k = 0;
+            for (; k + 16 <= vertexSize; k += 16)
+            {
+                transposeColumns16(columns.data() + k * VERTEX_BLOCK_SIZE + first, VERTEX_BLOCK_SIZE, destination + k, vertexSize);
+            }
+            for (; k < vertexSize; k += 4)
+            {
+                transposeColumns(columns.data() + k * VERTEX_BLOCK_SIZE + first, VERTEX_BLOCK_SIZE, destination + k, vertexSize);
+            }
+#else
+            for (size_t i = 0; i < VERTEX_GROUP_SIZE; i++)
+            {
+                for (size_t k = 0; k < vertexSize; k++)
+                {
+                    destination[i * vertexSize + k] = columns[k * VERTEX_BLOCK_SIZE + first + i];
+                }
+            }
+#endif
+
+            if (destination == tail)
+            {
+                std::memcpy(output + (blockStart + first) * vertexSize, tail, count * vertexSize);
+            }
+        }
+    }
+
+    return data == end;
+}
@@ -0,0 +1,347 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include "../../Common/settings.hpp"
+#include "../jobs.hpp"
+#include "cooked.hpp"
+#include "meshopt.hpp"
+
+using namespace uam;
+
+// Sections start 16 byte aligned so the mapping can be read in place
+#define COOKED_SECTION_ALIGN 16
+
+static uint64_t alignSection(uint64_t offset)
+{
+    return (offset + COOKED_SECTION_ALIGN - 1) & ~(uint64_t) (COOKED_SECTION_ALIGN - 1);
+}
+
+std::string uam::cookedMeshPath(const std::string &pskPath)
+{
+    return std::filesystem::path(pskPath).replace_extension(".cmesh").generic_string();
+}
+
+bool uam::isCookedMeshFresh(const std::string &pskPath, const std::vector<std::string> &materialFiles)
+{
+    std::error_code error;
+    std::filesystem::path cookedPath = cookedMeshPath(pskPath);
+
+    if (!std::filesystem::exists(cookedPath, error)) return false;
+
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, error);
+    if (error) return false;
+
+    // Material texture paths are baked in, so the .skmap and .mat files count too
+    std::vector<std::string> sources = materialFiles;
+    sources.push_back(pskPath);
+    sources.push_back(std::filesystem::path(pskPath).replace_extension(".skmap").generic_string());
+
+    for (const std::string &source : sources)
+    {
+        auto sourceTime = std::filesystem::last_write_time(source, error);
+        if (error || sourceTime > cookedTime) return false;
+    }
+
+    return true;
+}
+
+/*************************** WRITING ***************************/
+
+static void writeAt(std::ofstream &file, uint64_t offset, const void *data, size_t size)
+{
+    // Pad up to the section start
+    static const char zeros[COOKED_SECTION_ALIGN] = {};
+    uint64_t position = (uint64_t) file.tellp();
+    if (position < offset) file.write(zeros, (std::streamsize) (offset - position));
+
+    if (size) file.write((const char *) data, (std::streamsize) size);
+}
+
+bool uam::writeCookedMesh(const std::string &cookedPath, const MeshBuildData &data)
+{
+    std::vector<CookedMaterial> materials;
+    std::vector<CookedTexture> textures;
+    std::vector<CookedSource> sources;
+    std::string strings;
+
+    for (const auto &materialTextures : data.materials)
+    {
+        CookedMaterial material;
+        material.firstTexture = (uint32_t) textures.size();
+        material.textureCount = (uint32_t) materialTextures.size();
+        materials.push_back(material);
+
+        for (const auto &texture : materialTextures)
+        {
+            CookedTexture cookedTexture;
+            cookedTexture.roleOffset = (uint32_t) strings.size();
+            cookedTexture.roleLength = (uint32_t) texture.first.size();
+            strings += texture.first;
+
+            cookedTexture.pathOffset = (uint32_t) strings.size();
+            cookedTexture.pathLength = (uint32_t) texture.second.size();
+            strings += texture.second;
+
+            textures.push_back(cookedTexture);
+        }
+    }
+
+    for (const std::string &materialFile : data.materialFiles)
+    {
+        sources.push_back({ (uint32_t) strings.size(), (uint32_t) materialFile.size() });
+        strings += materialFile;
+    }
+
+    std::vector<uint8_t> encodedVertices;
+    std::vector<uint8_t> encodedIndices;
+    encodeVertexBuffer(data.vertices.data(), data.vertices.size(), sizeof(CompleteVertex), encodedVertices);
+    encodeIndexBuffer(data.indices.data(), data.indices.size(), encodedIndices);
+
+    std::cout << "Compressed \"" << cookedPath << "\": vertices " << data.vertices.size() * sizeof(CompleteVertex)
+        << " -> " << encodedVertices.size() << " bytes, indices " << data.indices.size() * sizeof(GLuint)
+        << " -> " << encodedIndices.size() << " bytes\n";
+
+    CookedMeshHeader header = {};
+    header.magic = COOKED_MESH_MAGIC;
+    header.version = COOKED_MESH_VERSION;
+
+    header.vertexStride = sizeof(CompleteVertex);
+    header.vertexCount = (uint32_t) data.vertices.size();
+    header.vertexOffset = alignSection(sizeof(CookedMeshHeader));
+    header.vertexEncodedSize = encodedVertices.size();
+
+    header.indexCount = (uint32_t) data.indices.size();
+    header.indexOffset = alignSection(header.vertexOffset + header.vertexEncodedSize);
+    header.indexEncodedSize = encodedIndices.size();
+
+    header.batchCount = (uint32_t) data.materialBatchSizes.size();
+    header.batchOffset = alignSection(header.indexOffset + header.indexEncodedSize);
+
+    header.lodCount = data.lodCount;
+    header.lodSetting = common::settings::MESH_LOD_COUNT;
+    header.lodOffset = alignSection(header.batchOffset + data.materialBatchSizes.size() * sizeof(uint32_t));
+
+    header.materialCount = (uint32_t) materials.size();
+    header.materialOffset = alignSection(header.lodOffset + data.lodErrors.size() * sizeof(float));
+
+    header.textureCount = (uint32_t) textures.size();
+    header.textureOffset = alignSection(header.materialOffset + materials.size() * sizeof(CookedMaterial));
+
+    header.sourceCount = (uint32_t) sources.size();
+    header.sourceOffset = alignSection(header.textureOffset + textures.size() * sizeof(CookedTexture));
+
+    header.stringsOffset = alignSection(header.sourceOffset + sources.size() * sizeof(CookedSource));
+    header.stringsSize = strings.size();
+
+    // Write to a temporary file first so a crash never leaves a
+    // half written cache that looks fresh
+    std::string tempPath = cookedPath + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to create cooked mesh: " << cookedPath << "\n";
+        return false;
+    }
+
+    writeAt(file, 0, &header, sizeof(header));
+    writeAt(file, header.vertexOffset, encodedVertices.data(), encodedVertices.size());
+    writeAt(file, header.indexOffset, encodedIndices.data(), encodedIndices.size());
+    writeAt(file, header.batchOffset, data.materialBatchSizes.data(), data.materialBatchSizes.size() * sizeof(uint32_t));
+    writeAt(file, header.lodOffset, data.lodErrors.data(), data.lodErrors.size() * sizeof(float));
+    writeAt(file, header.materialOffset, materials.data(), materials.size() * sizeof(CookedMaterial));
+    writeAt(file, header.textureOffset, textures.data(), textures.size() * sizeof(CookedTexture));
+    writeAt(file, header.sourceOffset, sources.data(), sources.size() * sizeof(CookedSource));
+    writeAt(file, header.stringsOffset, strings.data(), strings.size());
+
+    file.close();
+    if (!file)
+    {
+        std::cout << "Failed to write cooked mesh: " << cookedPath << "\n";
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cookedPath, error);
+    if (error)
+    {
+        std::cout << "Failed to write cooked mesh: " << cookedPath << " (" << error.message() << ")\n";
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    return true;
+}
+
+/*************************** READING ***************************/
+
+static bool sectionFits(uint64_t offset, uint64_t count, uint64_t stride, size_t fileSize)
+{
+    if (offset > fileSize) return false;
+    if (stride && count > (fileSize - offset) / stride) return false;
+    return true;
+}
+
+bool CookedMesh::open(const std::string &cookedPath, const std::string &pskPath)
+{
+    header = nullptr;
+
+    if (!file.open(cookedPath)) return false;
+    if (file.size() < sizeof(CookedMeshHeader)) return false;
+
+    const CookedMeshHeader *candidate = (const CookedMeshHeader *) file.data();
+    if (candidate->magic != COOKED_MESH_MAGIC || candidate->version != COOKED_MESH_VERSION
+        || candidate->lodSetting != common::settings::MESH_LOD_COUNT)
+    {
+        std::cout << "Cooked mesh is out of date: " << cookedPath << "\n";
+        return false;
+    }
+
+    if (candidate->vertexStride != sizeof(CompleteVertex)
+        || !sectionFits(candidate->vertexOffset, candidate->vertexEncodedSize, 1, file.size())
+        || !sectionFits(candidate->indexOffset, candidate->indexEncodedSize, 1, file.size())
+        || !sectionFits(candidate->batchOffset, candidate->batchCount, sizeof(uint32_t), file.size())
+        || candidate->lodCount == 0 || candidate->batchCount % candidate->lodCount != 0
+        || !sectionFits(candidate->lodOffset, candidate->lodCount, sizeof(float), file.size())
+        || !sectionFits(candidate->materialOffset, candidate->materialCount, sizeof(CookedMaterial), file.size())
+        || !sectionFits(candidate->textureOffset, candidate->textureCount, sizeof(CookedTexture), file.size())
+        || !sectionFits(candidate->sourceOffset, candidate->sourceCount, sizeof(CookedSource), file.size())
+        || !sectionFits(candidate->stringsOffset, candidate->stringsSize, 1, file.size()))
+    {
+        std::cout << "Cooked mesh is corrupt: " << cookedPath << "\n";
+        return false;
+    }
+
+    // Checked before decoding anything
+    std::vector<std::string> materialFiles;
+    const CookedSource *sources = (const CookedSource *) (file.data() + candidate->sourceOffset);
+    for (uint32_t i = 0; i < candidate->sourceCount; i++)
+    {
+        if ((uint64_t) sources[i].pathOffset + sources[i].pathLength > candidate->stringsSize)
+        {
+            std::cout << "Cooked mesh is corrupt: " << cookedPath << "\n";
+            return false;
+        }
+        materialFiles.emplace_back(file.data() + candidate->stringsOffset + sources[i].pathOffset, sources[i].pathLength);
+    }
+
+    if (!isCookedMeshFresh(pskPath, materialFiles)) return false;
+
+    // Counts have to fit what's actually encoded before anything gets sized
+    // from them, indices take at least a code byte per triangle
+    if (candidate->indexCount % 3 != 0 || candidate->indexCount / 3 > candidate->indexEncodedSize
+        || minimumEncodedVertexBufferSize(candidate->vertexCount, sizeof(CompleteVertex)) > candidate->vertexEncodedSize)
+    {
+        std::cout << "Cooked mesh is corrupt: " << cookedPath << "\n";
+        return false;
+    }
+
+    // Every LOD's batches together cover the index buffer exactly
+    const uint32_t *batchSizes = (const uint32_t *) (file.data() + candidate->batchOffset);
+    uint64_t batchTotal = 0;
+    for (uint32_t i = 0; i < candidate->batchCount; i++)
+    {
+        if (batchSizes[i] % 3 != 0) batchTotal = UINT64_MAX;
+        else if (batchTotal != UINT64_MAX) batchTotal += batchSizes[i];
+    }
+
+    if (batchTotal != candidate->indexCount)
+    {
+        std::cout << "Cooked mesh is corrupt: " << cookedPath << "\n";
+        return false;
+    }
+
+    // Indices decode on the pool while this thread does the vertices
+    decodedVertices.resize(candidate->vertexCount);
+    decodedIndices.resize(candidate->indexCount);
+
+    const uint8_t *base = (const uint8_t *) file.data();
+    bool indicesDecoded = false;
+
+    JobSystem &jobs = JobSystem::Get();
+    JobCounter counter;
+    jobs.Run([&]()
+    {
+        indicesDecoded = decodeIndexBuffer(base + candidate->indexOffset, candidate->indexEncodedSize,
+            decodedIndices.data(), decodedIndices.size(), decodedVertices.size());
+    }, &counter);
+
+    bool verticesDecoded = decodeVertexBuffer(base + candidate->vertexOffset, candidate->vertexEncodedSize,
+        decodedVertices.data(), decodedVertices.size(), sizeof(CompleteVertex));
+    jobs.Wait(counter);
+
+    if (!verticesDecoded || !indicesDecoded)
+    {
+        std::cout << "Cooked mesh is corrupt: " << cookedPath << "\n";
+        decodedVertices = std::vector<CompleteVertex>();
+        decodedIndices = std::vector<GLuint>();
+        return false;
+    }
+
+    header = candidate;
+    return true;
+}
+
+template <typename T>
+static ChunkSpan<T> sectionSpan(const char *base, uint64_t offset, uint32_t count)
+{
+    ChunkSpan<T> span;
+    span.data = (const T *) (base + offset);
+    span.count = count;
+    return span;
+}
+
+ChunkSpan<CompleteVertex> CookedMesh::vertices() const
+{
+    ChunkSpan<CompleteVertex> span;
+    span.data = decodedVertices.data();
+    span.count = decodedVertices.size();
+    return span;
+}
+
+ChunkSpan<GLuint> CookedMesh::indices() const
+{
+    ChunkSpan<GLuint> span;
+    span.data = decodedIndices.data();
+    span.count = decodedIndices.size();
+    return span;
+}
+
+ChunkSpan<uint32_t> CookedMesh::materialBatchSizes() const
+{
+    return sectionSpan<uint32_t>(file.data(), header->batchOffset, header->batchCount);
+}
+
+ChunkSpan<float> CookedMesh::lodErrors() const
+{
+    return sectionSpan<float>(file.data(), header->lodOffset, header->lodCount);
+}
+
+size_t CookedMesh::materialCount() const
+{
+    return header->materialCount;
+}
+
+std::map<std::string, std::string> CookedMesh::materialTextures(size_t material) const
+{
+    const CookedMaterial &cookedMaterial = ((const CookedMaterial *) (file.data() + header->materialOffset))[material];
+    const CookedTexture *textures = (const CookedTexture *) (file.data() + header->textureOffset);
+    const char *strings = file.data() + header->stringsOffset;
+
+    std::map<std::string, std::string> result;
+    for (uint32_t i = 0; i < cookedMaterial.textureCount; i++)
+    {
+        uint64_t index = (uint64_t) cookedMaterial.firstTexture + i;
+        if (index >= header->textureCount) break;
+
+        const CookedTexture &texture = textures[index];
+        if ((uint64_t) texture.roleOffset + texture.roleLength > header->stringsSize) continue;
+        if ((uint64_t) texture.pathOffset + texture.pathLength > header->stringsSize) continue;
+
+        result[std::string(strings + texture.roleOffset, texture.roleLength)]
+            = std::string(strings + texture.pathOffset, texture.pathLength);
+    }
+
+    return result;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "types.hpp"
+#include "psk.hpp"
+#include "../../Common/mappedfile.hpp"
+
+namespace uam
+{
+    // Cooked meshes (.cmesh) hold the final vertex and index streams
+    // plus resolved material textures. Every section is referenced by a byte
+    // offset from the start of the file. Vertices and indices are compressed
+    // (see encodeVertexBuffer/encodeIndexBuffer) and decoded on open,
+    // everything else is used in place from the mapping.
+    //
+    // [CookedMeshHeader]
+    // [uint8_t * vertexEncodedSize]      CompleteVertex * vertexCount once decoded
+    // [uint8_t * indexEncodedSize]       GLuint * indexCount once decoded
+    // [uint32_t * batchCount]            material batch sizes, lodCount sets of them
+    // [float * lodCount]                 LOD errors
+    // [CookedMaterial * materialCount]
+    // [CookedTexture * textureCount]
+    // [CookedSource * sourceCount]       .mat files read while cooking
+    // [char * stringsSize]               role and path strings, not terminated
+
+#define COOKED_MESH_MAGIC 0x48534D43 // "CMSH"
+#define COOKED_MESH_VERSION 8
+
+    struct CookedMeshHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+
+        uint32_t vertexStride;
+        uint32_t vertexCount;
+        uint64_t vertexOffset;
+        uint64_t vertexEncodedSize;
+
+        uint32_t indexCount;
+        uint32_t batchCount;
+        uint64_t indexOffset;
+        uint64_t indexEncodedSize;
+        uint64_t batchOffset;
+
+        uint32_t lodCount;
+        uint32_t lodSetting; // MESH_LOD_COUNT it was cooked with, lodCount can be lower
+        uint64_t lodOffset;
+
+        uint32_t materialCount;
+        uint32_t textureCount;
+        uint64_t materialOffset;
+        uint64_t textureOffset;
+
+        uint32_t sourceCount;
+        uint32_t sourcePadding;
+        uint64_t sourceOffset;
+
+        uint64_t stringsOffset;
+        uint64_t stringsSize;
+    };
+
+    struct CookedMaterial
+    {
+        uint32_t firstTexture;
+        uint32_t textureCount;
+    };
+
+    struct CookedTexture
+    {
+        uint32_t roleOffset;
+        uint32_t roleLength;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    struct CookedSource
+    {
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    class CookedMesh
+    {
+        common::MappedFile file;
+        const CookedMeshHeader *header = nullptr;
+
+        std::vector<CompleteVertex> decodedVertices;
+        std::vector<GLuint> decodedIndices;
+
+    public:
+        // Maps the file, validates every section against its size
+        // and decodes the vertices and indices. Fails without decoding if it
+        // was cooked with other settings or any of its sources changed since.
+        bool open(const std::string &cookedPath, const std::string &pskPath);
+
+        ChunkSpan<CompleteVertex> vertices() const;
+        ChunkSpan<GLuint> indices() const;
+        ChunkSpan<uint32_t> materialBatchSizes() const;
+        ChunkSpan<float> lodErrors() const;
+
+        size_t materialCount() const;
+        std::map<std::string, std::string> materialTextures(size_t material) const;
+    };
+
+    // Where the cooked file for a .psk lives
+    std::string cookedMeshPath(const std::string &pskPath);
+
+    // True if the cooked file exists and is at least as new as the .psk,
+    // its .skmap and every one of materialFiles
+    bool isCookedMeshFresh(const std::string &pskPath, const std::vector<std::string> &materialFiles);
+
+    bool writeCookedMesh(const std::string &cookedPath, const MeshBuildData &data);
+}
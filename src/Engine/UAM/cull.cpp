@@ -0,0 +1,148 @@
+#include <cmath>
+
+#include "../../Common/cpu.hpp"
+#include "cull.hpp"
+
+using namespace uam;
+
+CullView uam::makeCullView(const glm::mat4 &modelViewMatrix, const glm::mat4 &projectionMatrix, bool cullBackfaces)
+{
+    CullView view;
+    view.cullBackfaces = cullBackfaces;
+
+    // Gribb and Hartmann, rows of the combined matrix give mesh space planes
+    glm::mat4 matrix = glm::transpose(projectionMatrix * modelViewMatrix);
+    view.planes[0] = matrix[3] + matrix[0]; // left
+    view.planes[1] = matrix[3] - matrix[0]; // right
+    view.planes[2] = matrix[3] + matrix[1]; // bottom
+    view.planes[3] = matrix[3] - matrix[1]; // top
+    view.planes[4] = matrix[3] + matrix[2]; // near
+    view.planes[5] = matrix[3] - matrix[2]; // far
+
+    for (glm::vec4 &plane : view.planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    view.cameraPosition = glm::vec3(glm::inverse(modelViewMatrix)[3]);
+    return view;
+}
+
+void MeshletCullData::build(const std::vector<Meshlet> &meshlets)
+{
+    count = meshlets.size();
+
+    centerX.resize(count); centerY.resize(count); centerZ.resize(count);
+    radius.resize(count);
+    axisX.resize(count); axisY.resize(count); axisZ.resize(count);
+    cutoff.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        centerX[i] = meshlets[i].center[0];
+        centerY[i] = meshlets[i].center[1];
+        centerZ[i] = meshlets[i].center[2];
+        radius[i] = meshlets[i].radius;
+        axisX[i] = meshlets[i].coneAxis[0];
+        axisY[i] = meshlets[i].coneAxis[1];
+        axisZ[i] = meshlets[i].coneAxis[2];
+        cutoff[i] = meshlets[i].coneCutoff;
+    }
+}
+
+static uint8_t cullOne(const MeshletCullData &data, size_t i, const CullView &view)
+{
+    glm::vec3 center(data.centerX[i], data.centerY[i], data.centerZ[i]);
+
+    for (const glm::vec4 &plane : view.planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -data.radius[i]) return 0;
+    }
+
+    if (!view.cullBackfaces) return 1;
+
+    glm::vec3 toCenter = center - view.cameraPosition;
+    glm::vec3 axis(data.axisX[i], data.axisY[i], data.axisZ[i]);
+    if (glm::dot(toCenter, axis) >= data.cutoff[i] * glm::length(toCenter) + data.radius[i]) return 0;
+
+    return 1;
+}
+
+#ifdef COMMON_CPU_X86
+
+// SSE2 is baseline on x64, no dispatch needed
+// Whole groups of 4 only, returns where it stopped
+static size_t cullMeshletsSSE2(const MeshletCullData &data, size_t begin, size_t end, const CullView &view, uint8_t *visible)
+{
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++)
+    {
+        planeX[p] = _mm_set1_ps(view.planes[p].x);
+        planeY[p] = _mm_set1_ps(view.planes[p].y);
+        planeZ[p] = _mm_set1_ps(view.planes[p].z);
+        planeW[p] = _mm_set1_ps(view.planes[p].w);
+    }
+
+    __m128 cameraX = _mm_set1_ps(view.cameraPosition.x);
+    __m128 cameraY = _mm_set1_ps(view.cameraPosition.y);
+    __m128 cameraZ = _mm_set1_ps(view.cameraPosition.z);
+    __m128 zero = _mm_setzero_ps();
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&data.centerX[i]);
+        __m128 y = _mm_loadu_ps(&data.centerY[i]);
+        __m128 z = _mm_loadu_ps(&data.centerZ[i]);
+        __m128 r = _mm_loadu_ps(&data.radius[i]);
+        __m128 negativeRadius = _mm_sub_ps(zero, r);
+
+        // Lanes set where the sphere is completely behind any plane
+        __m128 culled = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+            culled = _mm_or_ps(culled, _mm_cmplt_ps(distance, negativeRadius));
+        }
+
+        // Normal cone
+        if (view.cullBackfaces)
+        {
+            __m128 dx = _mm_sub_ps(x, cameraX);
+            __m128 dy = _mm_sub_ps(y, cameraY);
+            __m128 dz = _mm_sub_ps(z, cameraZ);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+            __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&data.axisX[i])), _mm_mul_ps(dy, _mm_loadu_ps(&data.axisY[i]))),
+                _mm_mul_ps(dz, _mm_loadu_ps(&data.axisZ[i])));
+            __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&data.cutoff[i]), length), r);
+            culled = _mm_or_ps(culled, _mm_cmpge_ps(along, limit));
+        }
+
+        int mask = _mm_movemask_ps(culled);
+        for (size_t lane = 0; lane < 4; lane++)
+        {
+            visible[i + lane - begin] = (mask >> lane) & 1 ? 0 : 1;
+        }
+    }
+
+    return i;
+}
+
+#endif
+
+void uam::cullMeshlets(const MeshletCullData &data, size_t first, size_t count, const CullView &view, uint8_t *visible)
+{
+    size_t end = first + count;
+    size_t i = first;
+
+#ifdef COMMON_CPU_X86
+    i = cullMeshletsSSE2(data, first, end, view, visible);
+#endif
+
+    for (; i < end; i++)
+    {
+        visible[i - first] = cullOne(data, i, view);
+    }
+}
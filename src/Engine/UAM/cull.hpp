@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <glm.hpp>
+
+#include "types.hpp"
+
+namespace uam
+{
+    // Camera in a mesh's own space, rebuilt per draw
+    struct CullView
+    {
+        glm::vec4 planes[6]; // normalized, inside is dot(plane, p) >= 0
+        glm::vec3 cameraPosition;
+
+        // Also test normal cones. Only right when the draw culls back faces
+        // too, otherwise two sided geometry (hair cards, cloth) goes missing.
+        bool cullBackfaces;
+    };
+
+    CullView makeCullView(const glm::mat4 &modelViewMatrix, const glm::mat4 &projectionMatrix, bool cullBackfaces);
+
+    // Meshlet bounds split into one array per field
+    // so they can be tested four at a time
+    struct MeshletCullData
+    {
+        std::vector<float> centerX, centerY, centerZ, radius;
+        std::vector<float> axisX, axisY, axisZ, cutoff;
+        size_t count = 0;
+
+        void build(const std::vector<Meshlet> &meshlets);
+    };
+
+    // Sets visible[i] to 1 for every meshlet in [first, first + count) that might
+    // be seen, 0 for those fully outside the frustum or, with cullBackfaces, facing away.
+    void cullMeshlets(const MeshletCullData &data, size_t first, size_t count, const CullView &view, uint8_t *visible);
+}
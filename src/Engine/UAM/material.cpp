@@ -1,65 +1,162 @@
 #include <GL/glew.h>
 
 #include <string>
+#include <string.h>
 #include <map>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <atomic>
 
 #include "../../Common/util.hpp"
+#include "../../Common/settings.hpp"
+#include "../../Common/mappedfile.hpp"
+#include "../../Common/tga.hpp"
+#include "../jobs.hpp"
 #include "material.hpp"
+#include "texstream.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_ONLY_TGA
 #include "../../Common/stb_image.h"
 
+// Uncompressed TGAs are split into bands of about this many output bytes
+#define TGA_BAND_BYTES (256 * 1024)
+
 // Texture Registry
 struct _texReg
 {
-    GLuint textureId;
+    uam::TextureHandle texture;
     uint64_t regCount;
 };
 
 std::map<std::string, _texReg*> _texRegistry;
 
-GLuint registerTexture(const std::string texPath);
+static const char *MAIN_TEXTURE_ROLES[] = { "Diffuse", "Normal", "SpecPower" };
+
+uam::TextureHandle registerTexture(const std::string texPath, uam::TextureImage &image);
 void unregisterTexture(const std::string texPath);
-GLuint createTextureArray(std::vector<std::string> &texPaths);
 
-uam::Material::Material(std::map<std::string, std::string> &materialData, std::map<std::string, std::string> &keyMap)
+static bool isMainTextureRole(const std::string &role)
 {
-    // materialData is a map of the [NAME] = [TEXTUREIDENTIFIER] stored in .mat files
-    // keyMap is the [IDENTIFIER]=[PATH] stored in .skmap files
+    for (const char *mainRole : MAIN_TEXTURE_ROLES)
+    {
+        if (role == mainRole) return true;
+    }
+    return false;
+}
 
-    // Here we egister all dependent texture paths
-    // and store them for unregistering
+// Uncompressed fallback for the main roles, same channels the cooked formats keep:
+// color drops alpha if it's all opaque (BC1 vs BC3), normals keep RG (BC5), masks keep R (BC4).
+// Packs in place, the pixels or the staging slice just end up shorter.
+static void packForUsage(uam::TextureImage &image, uam::TextureUsage usage)
+{
+    uint8_t *pixels = image.staging.IsValid() ? image.staging.data : image.pixels;
+    if (!pixels || image.channelCount != 4) return;
+
+    size_t pixelCount = (size_t) image.width * image.height;
 
-    // Diffuse/Normal/SpecPower will be stored in a texture array
-    if (materialData.count("Diffuse") != 0)
+    int channels;
+    switch (usage)
     {
-        texPaths.push_back( keyMap[materialData["Diffuse"]] );
+        case uam::TextureUsage::Normal:
+            channels = 2;
+            break;
+        case uam::TextureUsage::Mask:
+            channels = 1;
+            break;
+        default:
+            channels = 3;
+            for (size_t i = 0; i < pixelCount; i++)
+            {
+                if (pixels[i * 4 + 3] != 255)
+                {
+                    channels = 4;
+                    break;
+                }
+            }
+            break;
     }
+    if (channels == 4) return;
 
-    if (materialData.count("Normal") != 0)
+    // Front to back is safe, every write lands at or before its read
+    for (size_t i = 0; i < pixelCount; i++)
     {
-        texPaths.push_back( keyMap[materialData["Normal"]] );
+        for (int c = 0; c < channels; c++) pixels[i * channels + c] = pixels[i * 4 + c];
     }
 
-    if (materialData.count("SpecPower") != 0)
+    image.channelCount = channels;
+    if (image.staging.IsValid()) image.staging.size = pixelCount * channels;
+}
+
+// Main roles are decoded to RGBA and packed, others keep the file's channels
+static void decodeTextureImage(uam::TextureImage &image, const std::string &texPath, const std::string &role,
+    bool useCooked, bool stage)
+{
+    uam::TextureUsage usage = uam::textureUsageForRole(role);
+    bool mainRole = isMainTextureRole(role);
+
+    // Falls back to the source if cooking failed
+    if (useCooked && image.LoadCooked(texPath, usage, stage)) return;
+
+    if (image.Load(texPath, mainRole ? 4 : 0, stage) && mainRole) packForUsage(image, usage);
+}
+
+// A shared image's texture was registered when its images were decoded, if the
+// Material holding it went away since then it has to be decoded here after all
+static uam::TextureHandle registerSharedTexture(const std::string &texPath, const std::string &role,
+    uam::MaterialImages &images, uam::TextureImage &image)
+{
+    bool registered = _texRegistry.count(texPath) > 0 && _texRegistry[texPath] != nullptr;
+    if (images.shared.count(texPath) != 0 && !registered && !image.IsLoaded())
     {
-        texPaths.push_back( keyMap[materialData["SpecPower"]] );
+        std::cout << "Shared texture was released before use, decoding: " << texPath << std::endl;
+        decodeTextureImage(image, texPath, role, common::settings::COOKED_TEXTURES,
+            common::settings::TEXTURE_STAGING_RING_MB > 0);
     }
+    return registerTexture(texPath, image);
+}
 
-    mainTexArray = createTextureArray(texPaths);
+uam::Material::Material(const std::map<std::string, std::string> &textures)
+    : Material(decodeMaterialImages(textures))
+{
+}
+
+uam::Material::Material(MaterialImages &&images)
+{
+    // Here we egister all dependent texture paths
+    // and store them for unregistering.
+    // Pixels go up a few per frame through the TextureStreamer.
+    auto start = std::chrono::steady_clock::now();
 
-    for (std::pair<std::string, std::string> dataPair : materialData)
+    // Diffuse/Normal/SpecPower, layers are packed so a missing role shifts the ones after it
+    size_t layer = 0;
+    for (const char *role : MAIN_TEXTURE_ROLES)
     {
-        if (dataPair.first == "Diffuse") continue;
-        if (dataPair.first == "Normal") continue;
-        if (dataPair.first == "SpecPower") continue;
+        if (images.textures.count(role) == 0) continue;
+
+        const std::string &texPath = images.textures.at(role);
+        texPaths.push_back( texPath );
 
-        texPaths.push_back( keyMap[dataPair.second] );
-        otherTextures.push_back( registerTexture(keyMap[dataPair.second]) );
+        TextureHandle texture = registerSharedTexture(texPath, role, images, images.layers[layer++]);
+        if (strcmp(role, "Diffuse") == 0) diffuseTexture = texture;
+        if (strcmp(role, "Normal") == 0) normalTexture = texture;
+        if (strcmp(role, "SpecPower") == 0) specPowerTexture = texture;
     }
+
+    size_t otherIndex = 0;
+    for (const std::pair<const std::string, std::string> &texture : images.textures)
+    {
+        if (isMainTextureRole(texture.first)) continue;
+
+        texPaths.push_back( texture.second );
+        otherTextures.push_back( registerSharedTexture(texture.second, texture.first, images, images.others[otherIndex++]) );
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Queued " << texPaths.size() << " material textures in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
 }
 
 uam::Material::~Material()
@@ -68,143 +165,380 @@ uam::Material::~Material()
     {
         unregisterTexture(texPath);
     }
-
-    glDeleteTextures(1, &mainTexArray);
 }
 
 
 /*************** UTIL FUNCTIONS ***************/
 
-GLuint registerTexture(const std::string texPath)
+std::map<std::string, std::string> uam::resolveMaterialTextures(std::map<std::string, std::string> &materialData, std::map<std::string, std::string> &keyMap)
 {
-    if (_texRegistry.count(texPath) > 0 && _texRegistry[texPath] != nullptr && _texRegistry[texPath]->regCount > 0)
+    std::map<std::string, std::string> textures;
+    for (const std::pair<const std::string, std::string> &dataPair : materialData)
     {
-        _texRegistry[texPath]->regCount += 1;
-        return _texRegistry[texPath]->textureId;
+        textures[dataPair.first] = keyMap[dataPair.second];
     }
+    return textures;
+}
 
-    // If the texture isn't currently registered then do so and return the id
-    std::cout << "Registering new texture: " << texPath << std::endl;
-
-    _texReg *newTex = new _texReg;
-    _texRegistry[texPath] = newTex;
+uam::MaterialImages uam::decodeMaterialImages(const std::map<std::string, std::string> &textures)
+{
+    std::vector<MaterialImages> images = decodeMaterialImages(std::vector<std::map<std::string, std::string>>{ textures });
+    return std::move(images[0]);
+}
 
-    newTex->regCount = 1;
+std::set<std::string> uam::registeredTexturePaths()
+{
+    std::set<std::string> paths;
+    for (const std::pair<const std::string, _texReg*> &entry : _texRegistry)
+    {
+        if (entry.second != nullptr && entry.second->regCount > 0) paths.insert(entry.first);
+    }
+    return paths;
+}
 
-    int width, height, channelCount;
-    std::cout << "STBI Loading texture.\n";
-    unsigned char *data = stbi_load(texPath.c_str(), &width, &height, &channelCount, 0);
+std::vector<uam::MaterialImages> uam::decodeMaterialImages(const std::vector<std::map<std::string, std::string>> &materials,
+    const std::set<std::string> *registered)
+{
+    struct DecodeTask
+    {
+        TextureImage *image;
+        const std::string *path;
+        const std::string *role;
+    };
+
+    // Size every vector first, the jobs hold pointers into them
+    std::vector<MaterialImages> images(materials.size());
+    std::vector<DecodeTask> tasks;
+
+    // Materials register in order, so a path's first image is registered before
+    // any later one needs it and the rest stay empty
+    std::set<std::string> queued;
+    size_t sharedCount = 0;
+    auto addTask = [&](MaterialImages &material, TextureImage *image, const std::string *path, const std::string *role)
+    {
+        if ((registered && registered->count(*path) != 0) || !queued.insert(*path).second)
+        {
+            material.shared.insert(*path);
+            sharedCount++;
+            return;
+        }
+        tasks.push_back({ image, path, role });
+    };
 
-    if (!data)
+    for (size_t i = 0; i < materials.size(); i++)
     {
-        std::cout << "Failed to load texture: " << texPath << std::endl;
-        return 0;
+        const std::map<std::string, std::string> &textures = materials[i];
+        images[i].textures = textures;
+
+        size_t layerCount = 0;
+        for (const char *role : MAIN_TEXTURE_ROLES)
+        {
+            if (textures.count(role) != 0) layerCount++;
+        }
+        images[i].layers.resize(layerCount);
+        images[i].others.resize(textures.size() - layerCount);
+
+        size_t layer = 0;
+        for (const char *role : MAIN_TEXTURE_ROLES)
+        {
+            auto texture = textures.find(role);
+            if (texture == textures.end()) continue;
+            addTask(images[i], &images[i].layers[layer++], &texture->second, &texture->first);
+        }
+
+        size_t other = 0;
+        for (const std::pair<const std::string, std::string> &texture : textures)
+        {
+            if (isMainTextureRole(texture.first)) continue;
+            addTask(images[i], &images[i].others[other++], &texture.second, &texture.first);
+        }
     }
 
-    GLenum format;
-    switch (channelCount)
+    auto start = std::chrono::steady_clock::now();
+
+    JobSystem &jobs = JobSystem::Get();
+    bool useCooked = common::settings::COOKED_TEXTURES;
+
+    // Decode into the staging ring, whatever doesn't fit uploads from client memory
+    bool stage = common::settings::TEXTURE_STAGING_RING_MB > 0;
+
+    if (useCooked)
     {
-        case 3:
-            format = GL_RGB;
-            break;
-        case 4:
-            format = GL_RGBA;
-            break;
-        default:
-            std::cout << "Unsupported number of channels(" << channelCount << ")" <<  "in texture file " << texPath;
-            stbi_image_free(data);
-            unregisterTexture(texPath);
-            return 0;
+        // Cook anything missing or stale first, once per path.
+        // Each cook spreads its mips and blocks over the pool too.
+        std::map<std::string, TextureUsage> stale;
+        for (const DecodeTask &task : tasks)
+        {
+            TextureUsage usage = textureUsageForRole(*task.role);
+            if (stale.count(*task.path) == 0 && !isCookedImageFresh(*task.path, usage)) stale[*task.path] = usage;
+        }
+
+        JobCounter cookCounter;
+        for (const std::pair<const std::string, TextureUsage> &texture : stale)
+        {
+            const std::pair<const std::string, TextureUsage> *entry = &texture;
+            jobs.Run([entry]() { cookImage(entry->first, entry->second); }, &cookCounter);
+        }
+        jobs.Wait(cookCounter);
     }
 
-    glGenTextures(1, &newTex->textureId);
-    glBindTexture(GL_TEXTURE_2D, newTex->textureId);
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    JobCounter counter;
+    for (const DecodeTask &task : tasks)
+    {
+        jobs.Run([task, useCooked, stage]()
+        {
+            decodeTextureImage(*task.image, *task.path, *task.role, useCooked, stage);
+        }, &counter);
+    }
+    jobs.Wait(counter);
 
-    stbi_image_free(data);
+    auto end = std::chrono::steady_clock::now();
 
+    double decodeTotal = 0.0;
+    for (const DecodeTask &task : tasks)
+    {
+        const TextureImage &image = *task.image;
+        decodeTotal += image.decodeMilliseconds;
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (!image.IsLoaded())
+        {
+            std::cout << "Failed to load texture: " << *task.path << std::endl;
+            continue;
+        }
 
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return newTex->textureId;
-};
+        std::cout << (image.cooked.isOpen() ? "Mapped cooked texture: " : "Decoded texture: ") << *task.path
+            << " (" << image.width << "x" << image.height << ")" << (image.staging.IsValid() ? " staged" : "")
+            << " in " << image.decodeMilliseconds << " ms\n";
+    }
 
-void unregisterTexture(const std::string texPath)
-{
-    if (_texRegistry.count(texPath) == 0 || _texRegistry[texPath] == nullptr || _texRegistry[texPath]->regCount == 0)
+    if (!tasks.empty() || sharedCount != 0)
     {
-        std::cout << "Warning! Attempt to unregister texture that already should not exist: " << texPath << std::endl;
-        return;
+        std::cout << "Decoded " << tasks.size() << " textures in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms ("
+            << decodeTotal << " ms of decoding, " << sharedCount << " shared)\n";
     }
 
-    _texRegistry[texPath]->regCount -= 1;
+    return images;
+}
+
+uam::TextureImage::~TextureImage()
+{
+    Free();
+}
+
+uam::TextureImage::TextureImage(TextureImage &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+uam::TextureImage &uam::TextureImage::operator=(TextureImage &&other) noexcept
+{
+    if (this == &other) return *this;
+
+    Free();
+    path = std::move(other.path);
+    width = other.width;
+    height = other.height;
+    channelCount = other.channelCount;
+    pixels = other.pixels;
+    cooked = std::move(other.cooked);
+    staging = other.staging;
+    decodeMilliseconds = other.decodeMilliseconds;
+
+    other.pixels = nullptr;
+    other.staging = uam::StagingSlice();
+    return *this;
+}
+
+// Decodes straight from the mapped file into the final buffer, a staging slice if stage and the ring has room.
+// Returns false for anything common::decodeTga doesn't handle.
+static bool loadTga(const std::string &texPath, int desiredChannels, bool stage, uam::TextureImage &image)
+{
+    common::MappedFile file;
+    if (!file.open(texPath)) return false;
+
+    const uint8_t *data = (const uint8_t *) file.data();
+    common::TgaInfo info;
+    if (!common::readTgaInfo(data, file.size(), info)) return false;
+
+    int channels = desiredChannels ? desiredChannels : info.channels;
+    if (channels != 1 && channels != 3 && channels != 4) return false;
+
+    // stbi_image_free is plain free(), so Free() handles either decoder's pixels
+    size_t rowBytes = (size_t) info.width * channels;
+    uam::StagingSlice slice;
+    if (stage) slice = uam::TextureStreamer::Get().Allocate(rowBytes * info.height);
+
+    unsigned char *pixels = slice.IsValid() ? slice.data : (unsigned char *) malloc(rowBytes * info.height);
+    if (!pixels) return false;
 
-    if (_texRegistry[texPath] == 0)
+    bool decoded;
+    if (info.rle)
     {
-        // If the last mesh using this texture wants to unregister
-        // delete it from memory
+        decoded = common::decodeTga(data, file.size(), info, pixels, channels, 0, info.height);
+    }
+    else
+    {
+        std::atomic<bool> allDecoded{true};
+        size_t bandRows = std::max((size_t) 1, TGA_BAND_BYTES / rowBytes);
+        JobSystem::Get().ParallelFor(0, info.height, bandRows, [&](size_t begin, size_t end)
+        {
+            if (!common::decodeTga(data, file.size(), info, pixels, channels, (int) begin, (int) (end - begin)))
+            {
+                allDecoded = false;
+            }
+        });
+        decoded = allDecoded;
+    }
 
-        glDeleteTextures(1, &_texRegistry[texPath]->textureId);
-        delete _texRegistry[texPath];
-        _texRegistry[texPath] = nullptr;
+    if (!decoded)
+    {
+        if (slice.IsValid()) uam::TextureStreamer::Get().Release(slice);
+        else free(pixels);
+        return false;
     }
-}
 
+    if (slice.IsValid()) image.staging = slice;
+    else image.pixels = pixels;
+    image.width = info.width;
+    image.height = info.height;
+    image.channelCount = channels;
+    return true;
+}
 
-GLuint createTextureArray(std::vector<std::string> &texPaths)
+bool uam::TextureImage::Load(const std::string &texPath, int desiredChannels, bool stage)
 {
-    if (!texPaths.size()) return 0;
+    Free();
+    path = texPath;
 
-    int width, height, channelCount;
-    std::cout << "STBI Loading initial texture " << texPaths[0] << std::endl;
-    unsigned char *data = stbi_load(texPaths[0].c_str(), &width, &height, &channelCount, 4);
+    auto start = std::chrono::steady_clock::now();
 
-    if (!data)
+    // stb_image covers whatever the fast path turns down, and reports the errors
+    if (!loadTga(texPath, desiredChannels, stage, *this))
     {
-        std::cout << "Failed to load texture: " << texPaths[0] << std::endl;
-        return 0;
+        int fileChannels = 0;
+        pixels = stbi_load(texPath.c_str(), &width, &height, &fileChannels, desiredChannels);
+        channelCount = desiredChannels ? desiredChannels : fileChannels;
+
+        // stb_image only decodes into its own buffer
+        if (pixels && stage)
+        {
+            size_t size = (size_t) width * height * channelCount;
+            staging = TextureStreamer::Get().Allocate(size);
+            if (staging.IsValid())
+            {
+                memcpy(staging.data, pixels, size);
+                stbi_image_free(pixels);
+                pixels = nullptr;
+            }
+        }
     }
 
-    std::cout << "Initial texture loaded.\n";
+    auto end = std::chrono::steady_clock::now();
+    decodeMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
 
-    GLuint arrayID;
-    glGenTextures(1, &arrayID);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, arrayID);
+    return IsLoaded();
+}
 
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, texPaths.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    stbi_image_free(data);
+bool uam::TextureImage::LoadCooked(const std::string &texPath, TextureUsage usage, bool stage)
+{
+    Free();
+    path = texPath;
 
+    auto start = std::chrono::steady_clock::now();
 
-    for (int i = 1; i < texPaths.size(); i++)
+    if (cooked.open(cookedImagePath(texPath), usage))
     {
-        data = stbi_load(texPaths[i].c_str(), &width, &height, &channelCount, 4);
+        width = (int) cooked.width();
+        height = (int) cooked.height();
+        channelCount = 0;
 
-        if (!data)
+        // Mips are laid out back to back, so the chain copies as one block
+        // and the mapping is only read for the mip table afterwards
+        if (stage)
         {
-            std::cout << "Failed to load texture: " << texPaths[i] << std::endl;
-            continue;
+            const CookedImageMip &last = cooked.mip(cooked.mipCount() - 1);
+            size_t size = (size_t) (last.offset + last.size - cooked.mip(0).offset);
+            staging = TextureStreamer::Get().Allocate(size);
+            if (staging.IsValid()) memcpy(staging.data, cooked.mipData(0), size);
         }
+    }
 
-        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        stbi_image_free(data);
+    auto end = std::chrono::steady_clock::now();
+    decodeMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
 
+    return cooked.isOpen();
+}
+
+uam::StagingSlice uam::TextureImage::TakeStaging()
+{
+    StagingSlice slice = staging;
+    staging = StagingSlice();
+    return slice;
+}
+
+void uam::TextureImage::Free()
+{
+    if (pixels) stbi_image_free(pixels);
+    pixels = nullptr;
+    cooked.close();
+    TextureStreamer::Get().Release(TakeStaging());
+}
+
+uam::TextureHandle registerTexture(const std::string texPath, uam::TextureImage &image)
+{
+    if (_texRegistry.count(texPath) > 0 && _texRegistry[texPath] != nullptr && _texRegistry[texPath]->regCount > 0)
+    {
+        _texRegistry[texPath]->regCount += 1;
+        image.Free();
+        return _texRegistry[texPath]->texture;
     }
 
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    // If the texture isn't currently registered then do so and return the id
+    std::cout << "Registering new texture: " << texPath << std::endl;
 
+    _texReg *newTex = new _texReg;
+    _texRegistry[texPath] = newTex;
 
-    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    newTex->regCount = 1;
+    newTex->texture = uam::TextureHandle();
+
+    if (!image.IsLoaded())
+    {
+        std::cout << "Failed to load texture: " << texPath << std::endl;
+        return uam::TextureHandle();
+    }
 
+    // Storage now, pixels over the next few frames
+    newTex->texture = uam::TextureStreamer::Get().CreateTexture(texPath, std::move(image));
+    if (!newTex->texture.IsValid())
+    {
+        unregisterTexture(texPath);
+        return uam::TextureHandle();
+    }
 
+    return newTex->texture;
+};
+
+void unregisterTexture(const std::string texPath)
+{
+    if (_texRegistry.count(texPath) == 0 || _texRegistry[texPath] == nullptr || _texRegistry[texPath]->regCount == 0)
+    {
+        std::cout << "Warning! Attempt to unregister texture that already should not exist: " << texPath << std::endl;
+        return;
+    }
+
+    _texRegistry[texPath]->regCount -= 1;
+
+    if (_texRegistry[texPath]->regCount == 0)
+    {
+        // If the last mesh using this texture wants to unregister
+        // delete it from memory
+
+        uam::TextureStreamer::Get().Cancel(_texRegistry[texPath]->texture);
+        uam::TexturePool::Get().Free(_texRegistry[texPath]->texture);
+        delete _texRegistry[texPath];
+        _texRegistry[texPath] = nullptr;
+    }
+}
 
-    return arrayID;
-}
\ No newline at end of file
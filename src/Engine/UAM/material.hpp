@@ -1,23 +1,131 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
 #include <string>
 #include <map>
+#include <set>
 #include <GL/glew.h>
 #include <vector>
 
+#include "texcache.hpp"
+#include "texpool.hpp"
+
 namespace uam
 {
+    // Part of the texture staging ring (see TextureStreamer), mapped so any thread can write it
+    struct StagingSlice
+    {
+        uint8_t *data = nullptr;
+        size_t offset = 0; // Into the unpack buffer, what glTexSubImage takes as its source
+        size_t size = 0;
+
+        bool IsValid() const { return data != nullptr; }
+    };
+
+    // Decoded pixels of a single texture file, or its cooked mip chain,
+    // owned until uploaded
+    struct TextureImage
+    {
+        std::string path;
+        int width = 0;
+        int height = 0;
+        int channelCount = 0;
+        unsigned char *pixels = nullptr;
+
+        // Open instead of pixels when loaded through LoadCooked
+        CookedImage cooked;
+
+        // When staged, pixels or the cooked mips are in here instead,
+        // pixels stays null but cooked stays open for its mip table
+        StagingSlice staging;
+
+        // Wall clock time Load or LoadCooked took
+        double decodeMilliseconds = 0.0;
+
+        TextureImage() = default;
+        ~TextureImage();
+
+        TextureImage(const TextureImage &) = delete;
+        TextureImage &operator=(const TextureImage &) = delete;
+        TextureImage(TextureImage &&other) noexcept;
+        TextureImage &operator=(TextureImage &&other) noexcept;
+
+        // Decodes the file, forcing desiredChannels if it isn't 0.
+        // With stage, decodes into a staging slice if the ring has room.
+        // Safe to call from any thread.
+        bool Load(const std::string &texPath, int desiredChannels, bool stage = false);
+
+        // Maps the cooked file of texPath, fails if it's missing or was cooked for another usage.
+        // With stage, copies the mips into a staging slice if the ring has room.
+        bool LoadCooked(const std::string &texPath, TextureUsage usage, bool stage = false);
+
+        bool IsLoaded() const { return pixels != nullptr || cooked.isOpen() || staging.IsValid(); }
+
+        // Gives up the slice without handing it back to the ring
+        StagingSlice TakeStaging();
+
+        // Hands the slice back to the ring too, only safe if the GPU never read it
+        void Free();
+    };
+
+    // Everything a Material needs decoded up front so the
+    // GL thread only has to upload
+    struct MaterialImages
+    {
+        // [ROLE] = [TEXTURE PATH]
+        std::map<std::string, std::string> textures;
+
+        // Diffuse/Normal/SpecPower in that order, skipping missing ones
+        std::vector<TextureImage> layers;
+
+        // Everything else, in textures order
+        std::vector<TextureImage> others;
+
+        // Paths whose images were left empty, they were registered already or
+        // an earlier image of the same decode holds them
+        std::set<std::string> shared;
+    };
+
+    // Decodes every texture of a material, each as its own job on the
+    // job system, and waits for them. Never touches GL.
+    // With COOKED_TEXTURES stale cooked files are cooked first
+    // and the images are just their mappings.
+    MaterialImages decodeMaterialImages(const std::map<std::string, std::string> &textures);
+
+    // Same for several materials at once, every texture is in flight together.
+    // Each path is decoded once, into its first image. Paths in registered
+    // (see registeredTexturePaths) aren't decoded at all.
+    std::vector<MaterialImages> decodeMaterialImages(const std::vector<std::map<std::string, std::string>> &materials,
+        const std::set<std::string> *registered = nullptr);
+
+    // GL thread. Paths of every texture currently registered by a Material,
+    // a snapshot for decodeMaterialImages on another thread
+    std::set<std::string> registeredTexturePaths();
+
     class Material
     {
     public:
-        GLuint mainTexArray;
-        std::vector<GLuint> otherTextures;
+        // Layers of the TexturePool's shared arrays, each role can land in a
+        // different array since cooked ones differ in format. Invalid if missing.
+        TextureHandle diffuseTexture;
+        TextureHandle normalTexture;
+        TextureHandle specPowerTexture;
+        std::vector<TextureHandle> otherTextures;
 
         std::vector<std::string> texPaths;
 
+        // textures maps a role (Diffuse, Normal, ...) to a texture path
+        Material(const std::map<std::string, std::string> &textures);
 
-        Material(std::map<std::string, std::string> &materialData, std::map<std::string, std::string> &keyMap);
+        // Uploads already decoded images, consuming them
+        Material(MaterialImages &&images);
         ~Material();
     };
 
-}
\ No newline at end of file
+    // materialData is a map of the [NAME] = [TEXTUREIDENTIFIER] stored in .mat files
+    // keyMap is the [IDENTIFIER]=[PATH] stored in .skmap files
+    // Returns [NAME] = [PATH]
+    std::map<std::string, std::string> resolveMaterialTextures(std::map<std::string, std::string> &materialData, std::map<std::string, std::string> &keyMap);
+
+}
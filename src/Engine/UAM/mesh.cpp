@@ -1,48 +1,61 @@
-#include <cstring> // for memcpy
-
 #include <map>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
+#include <functional>
+#include <cmath>
 
 
 #include "../../Common/util.hpp"
 #include "mesh.hpp"
+#include "psk.hpp"
+#include "cooked.hpp"
+#include "meshopt.hpp"
+#include "texstream.hpp"
+#include "../jobs.hpp"
 
-using namespace uam;
+// Material indices are int8 in the file
+#define FACE_SORT_BUCKETS 256
+#define FACE_SORT_PARALLEL_THRESHOLD 65536
+#define FACE_SORT_CHUNK_SIZE 32768
 
-struct CompleteVertex
-{
-    float x;
-    float y;
-    float z;
+// otherTextures[] in mesh.frag, units 3-15
+#define MAX_OTHER_TEXTURES 13
 
-    float u;
-    float v;
-    int32_t materialIndex;
-};
+using namespace uam;
 
-PSK_MeshData* loadPSK(const std::string &pskPath);
-CompleteVertex *getVertexArray(std::vector<PSK_Point> &points, std::vector<PSK_Wedge> &wedges);
+static void prepareMeshData(const std::string &pskPath, PreparedMesh &prepared, const std::set<std::string> *registeredTextures);
+static MeshBounds computeBounds(const CompleteVertex *vertices, size_t vertexCount);
+static void splitVertexStreams(const CompleteVertex *vertices, size_t vertexCount, PreparedMesh &prepared);
+static void splitVertexStreams(const CompactVertex *vertices, size_t vertexCount, PreparedMesh &prepared);
+void getVertexArray(std::vector<PSK_Point> &points, std::vector<PSK_Wedge> &wedges, std::vector<CompleteVertex> &vertices);
+void buildIndicesArray(std::vector<PSK_Face> &faces, size_t materialCount, std::vector<GLuint> &indices,
+    std::vector<uint32_t> &materialBatchSizes, std::vector<int32_t> &smoothingGroups);
 std::map<std::string, std::string> readKeyValueFile(const std::string &filePath);
 
-PSK_ChunkHeader readChunkHeader(std::ifstream &file);
-std::vector<PSK_Point> readPointsChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount);
-std::vector<PSK_Wedge> readWedgesChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount);
-std::vector<PSK_Face> readFacesChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount);
-std::vector<PSK_Material> readMaterialsChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount);
-
 /***************** MESH ASSET IMPLEMENTATION ******************/
 MeshAsset::MeshAsset(std::string &pskPath)
+    : MeshAsset(pskPath,
+        common::settings::COMPACT_VERTICES ? VertexFormat::Compact : VertexFormat::Full,
+        common::settings::SPLIT_VERTEX_STREAMS ? VertexLayout::Split : VertexLayout::Interleaved)
+{
+}
+
+MeshAsset::MeshAsset(std::string &pskPath, VertexFormat vertexFormat, VertexLayout vertexLayout)
 {
     this->pskPath = pskPath;
+    this->vertexFormat = vertexFormat;
+    this->vertexLayout = vertexLayout;
 }
 
 MeshAsset::~MeshAsset()
 {
     glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &attributeVBO);
     glDeleteBuffers(1, &EBO);
     glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &positionVAO);
 
     for (Material* material : materials)
     {
@@ -52,445 +65,736 @@ MeshAsset::~MeshAsset()
 
 void MeshAsset::LoadData()
 {
-    PSK_MeshData *data = loadPSK(pskPath);
+    PreparedMesh prepared;
+    std::set<std::string> registeredTextures = registeredTexturePaths();
+    prepareMesh(pskPath, prepared, vertexFormat, vertexLayout, &registeredTextures);
+    Upload(prepared);
+}
 
-    // Generate buffers
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+void MeshAsset::Upload(PreparedMesh &prepared)
+{
+    const void *vertexData;
+    size_t vertexBytes;
+    const void *attributeData = nullptr;
+    size_t attributeBytes = 0;
+    const void *indexData;
+    size_t indexBytes;
+
+    vertexFormat = prepared.vertexFormat;
+    vertexLayout = prepared.vertexLayout;
+    if (vertexFormat == VertexFormat::Compact) dequantization = prepared.dequantization;
+
+    if (vertexLayout == VertexLayout::Split)
+    {
+        vertexData = prepared.positionStream.data();
+        vertexBytes = prepared.positionStream.size();
+        attributeData = prepared.attributeStream.data();
+        attributeBytes = prepared.attributeStream.size();
+    }
+    else if (vertexFormat == VertexFormat::Compact)
+    {
+        vertexData = prepared.compactVertices.data();
+        vertexBytes = prepared.compactVertices.size() * sizeof(CompactVertex);
+    }
+    else
+    {
+        ChunkSpan<CompleteVertex> vertices = prepared.vertices();
+        vertexData = vertices.data;
+        vertexBytes = vertices.size() * sizeof(CompleteVertex);
+    }
 
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (!prepared.shortIndices.empty())
+    {
+        indexType = GL_UNSIGNED_SHORT;
+        indexData = prepared.shortIndices.data();
+        indexBytes = prepared.shortIndices.size() * sizeof(uint16_t);
+    }
+    else
+    {
+        ChunkSpan<GLuint> indices = prepared.indices();
+        indexType = GL_UNSIGNED_INT;
+        indexData = indices.data;
+        indexBytes = indices.size() * sizeof(GLuint);
+    }
 
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    upload(vertexData, vertexBytes, attributeData, attributeBytes, indexData, indexBytes);
 
-    // Load vertex and face data
-    CompleteVertex *vertices = getVertexArray(data->points, data->wedges);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(CompleteVertex) * data->wedges.size(), vertices, GL_STATIC_DRAW);
-    
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, x));
-    glEnableVertexAttribArray(0);
-    
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, u));
-    glEnableVertexAttribArray(1);
-    
-    glVertexAttribPointer(2, 1, GL_INT, GL_FALSE, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, materialIndex));
-    glEnableVertexAttribArray(2);
-    
-    delete[] vertices;
+    sections = std::move(prepared.sections);
+    bounds = prepared.bounds;
 
-    GLuint *indices = buildIndicesArray(data->faces);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * data->faces.size() * 3, indices, GL_STATIC_DRAW);
-    delete[] indices;
+    meshlets = std::move(prepared.meshlets);
+    cullData.build(meshlets);
 
-    std::filesystem::path directory = std::filesystem::path(pskPath).remove_filename().generic_string();
-    std::string stem = std::filesystem::path(pskPath).stem().generic_string();
+    sectionMeshletStart.assign(sections.size() + 1, meshlets.size());
+    for (size_t i = meshlets.size(); i-- > 0;)
+    {
+        sectionMeshletStart[meshlets[i].section] = i;
+    }
+    for (size_t s = sections.size(); s-- > 0;)
+    {
+        // Sections without meshlets start where the next one does
+        sectionMeshletStart[s] = std::min(sectionMeshletStart[s], sectionMeshletStart[s + 1]);
+    }
 
-    // Load map file
-    std::map<std::string, std::string> keyMap = readKeyValueFile( std::filesystem::path(pskPath).replace_extension(".skmap").generic_string() );
+    // Sections come in batch order, so each LOD's are contiguous
+    ChunkSpan<float> errors = prepared.lodErrors();
+    lodErrors.assign(errors.begin(), errors.end());
+    batchesPerLod = prepared.materialBatchSizes().size() / lodErrors.size();
 
-    // Load materials
-    for (const auto &materialData : data->materials)
+    lodSectionStart.assign(lodErrors.size() + 1, sections.size());
+    for (size_t lod = lodErrors.size(); lod-- > 0;)
     {
-        std::filesystem::path materialPath = keyMap[materialData.name];
-        std::map<std::string, std::string> materialKeyMap = readKeyValueFile(materialPath.generic_string());
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            if (sections[i].batchIndex >= lod * batchesPerLod)
+            {
+                lodSectionStart[lod] = i;
+                break;
+            }
+        }
+    }
+    prepared.compactVertices = std::vector<CompactVertex>();
+    prepared.positionStream = std::vector<uint8_t>();
+    prepared.attributeStream = std::vector<uint8_t>();
+    prepared.shortIndices = std::vector<uint16_t>();
 
-        Material *material = new Material(materialKeyMap, keyMap);
-        materials.push_back(material);
+    for (MaterialImages &images : prepared.materialImages)
+    {
+        materials.push_back(new Material(std::move(images)));
     }
+    prepared.materialImages.clear();
 
-    // Just to prevent any mistaken additional writes to this VAO
-    glBindVertexArray(0);
+    loaded = true;
 }
 
-void MeshAsset::Draw(ShaderProgram &shader)
+void MeshAsset::upload(const void *vertices, size_t vertexBytes, const void *attributes, size_t attributeBytes,
+    const void *indices, size_t indexBytes)
 {
+    // Generate buffers
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+
+    if (vertexLayout == VertexLayout::Split)
+    {
+        glGenBuffers(1, &attributeVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
+        glBufferData(GL_ARRAY_BUFFER, attributeBytes, attributes, GL_STATIC_DRAW);
+    }
+
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+
+    // Everything
+    glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    setPositionAttribute();
+    setOtherAttributes();
 
-    // For each material batch
-    // bind the appropriate material
-    // and render
+    // Positions only
+    glGenVertexArrays(1, &positionVAO);
+    glBindVertexArray(positionVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    setPositionAttribute();
 
-    uint64_t countOffset = 0;
-    for (size_t i = 0; i < materialBatchSizes.size(); i++)
-    {
-        // Bind the main texture array (diffuse, normal, spec)
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, materials[i]->mainTexArray);
+    // Just to prevent any mistaken additional writes to this VAO
+    glBindVertexArray(0);
+}
 
-        // And any extras
-        for (size_t k = 0; k < materials[i]->otherTextures.size(); k++)
-        {
-            glActiveTexture(GL_TEXTURE1 + k);
-            glBindTexture(GL_TEXTURE_2D, materials[i]->otherTextures[k]);
-        }
+void MeshAsset::setPositionAttribute()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-        shader.setInt("otherTexturesSize", materials[i]->otherTextures.size());
-        glDrawElements(GL_TRIANGLES, materialBatchSizes[i], GL_UNSIGNED_INT, (void*)(countOffset * sizeof(GLuint)));
-        countOffset += materialBatchSizes[i];
+    // Compact positions are normalized, the shader scales them back out to the mesh bounds
+    if (vertexLayout == VertexLayout::Split && vertexFormat == VertexFormat::Compact)
+    {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactSplitPosition), (void*)offsetof(CompactSplitPosition, x));
     }
+    else if (vertexLayout == VertexLayout::Split)
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SplitPosition), (void*)offsetof(SplitPosition, x));
+    }
+    else if (vertexFormat == VertexFormat::Compact)
+    {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, x));
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, x));
+    }
+
+    glEnableVertexAttribArray(0);
 }
 
-GLuint* MeshAsset::buildIndicesArray(std::vector<PSK_Face> &faces)
+void MeshAsset::setOtherAttributes()
 {
+    if (vertexLayout == VertexLayout::Split && vertexFormat == VertexFormat::Compact)
+    {
+        // Material index rides along in the position stream
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, sizeof(CompactSplitPosition), (void*)offsetof(CompactSplitPosition, materialIndex));
 
-    GLuint *array = new GLuint[3 * faces.size()];
-
-    // For batch rendering
-    // assuming all faces are sorted by material indices
-    materialBatchSizes.push_back(0);
-    
-    int8_t currMatIndex = faces[0].materialIndex;
-    for (size_t i = 0; i < faces.size(); i++)
+        glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactSplitAttributes), (void*)offsetof(CompactSplitAttributes, u));
+        glVertexAttribPointer(5, 4, GL_SHORT, GL_TRUE, sizeof(CompactSplitAttributes), (void*)offsetof(CompactSplitAttributes, qtangent));
+    }
+    else if (vertexLayout == VertexLayout::Split)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SplitAttributes), (void*)offsetof(SplitAttributes, u));
+        glVertexAttribIPointer(2, 1, GL_INT, sizeof(SplitAttributes), (void*)offsetof(SplitAttributes, materialIndex));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(SplitAttributes), (void*)offsetof(SplitAttributes, nx));
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(SplitAttributes), (void*)offsetof(SplitAttributes, tx));
+    }
+    else if (vertexFormat == VertexFormat::Compact)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, u));
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, sizeof(CompactVertex), (void*)offsetof(CompactVertex, materialIndex));
+        glVertexAttribPointer(5, 4, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, qtangent));
+    }
+    else
     {
-        array[i * 3] = faces[i].wedge0;
-        array[i * 3 + 1] = faces[i].wedge1;
-        array[i * 3 + 2] = faces[i].wedge2;
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, u));
+        glVertexAttribIPointer(2, 1, GL_INT, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, materialIndex));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, nx));
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(CompleteVertex), (void*)offsetof(CompleteVertex, tx));
+    }
 
-        // Increment count of materal batch
-        // or move to the next one
-        if (currMatIndex == faces[i].materialIndex)
-        {
-            materialBatchSizes[faces[i].materialIndex] += 3;
-            continue;
-        }
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
 
-        currMatIndex = faces[i].materialIndex;
-        materialBatchSizes.push_back(3);
+    // Compact vertices carry a packed QTangent instead of a normal and tangent
+    if (vertexFormat == VertexFormat::Compact)
+    {
+        glEnableVertexAttribArray(5);
+    }
+    else
+    {
+        glEnableVertexAttribArray(3);
+        glEnableVertexAttribArray(4);
     }
-    return array;
 }
 
-/*************************** UTIL FUNCTIONS ***************************/
+void MeshAsset::Draw(ShaderProgram &shader, uint32_t lod)
+{
+    if (!loaded) return;
 
-CompleteVertex *getVertexArray(std::vector<PSK_Point> &points, std::vector<PSK_Wedge> &wedges)
+    glBindVertexArray(VAO);
+    drawSections(shader, true, lod, nullptr);
+}
+
+void MeshAsset::Draw(ShaderProgram &shader, uint32_t lod, const CullView &view)
 {
-    CompleteVertex *array = new CompleteVertex[wedges.size()];
+    if (!loaded) return;
 
-    // Should be 0 as we expect
-    // the array to be sorted by materialIndex
-    int32_t currMatIndex = wedges[0].materialIndex;
-    for (size_t i = 0; i < wedges.size(); i++)
-    {
-        array[i].x = points[wedges[i].pointIndex].x;
-        array[i].y = points[wedges[i].pointIndex].y;
-        array[i].z = points[wedges[i].pointIndex].z;
+    glBindVertexArray(VAO);
+    drawSections(shader, true, lod, &view);
+}
 
-        array[i].u = wedges[i].u;
-        array[i].v = wedges[i].v;
-        array[i].materialIndex = wedges[i].materialIndex;
-    }
-    return array;
+void MeshAsset::DrawPositions(ShaderProgram &shader, uint32_t lod)
+{
+    if (!loaded) return;
+
+    glBindVertexArray(positionVAO);
+    drawSections(shader, false, lod, nullptr);
 }
 
+uint32_t MeshAsset::SelectLod(const glm::mat4 &modelViewMatrix, float pixelsPerUnit) const
+{
+    if (lodErrors.size() <= 1) return 0;
 
-std::map<std::string, std::string> readKeyValueFile(const std::string &filePath)
+    // Errors are in mesh units, the model matrix may scale them
+    float scale = glm::length(glm::vec3(modelViewMatrix[0]));
+    glm::vec4 center = modelViewMatrix * glm::vec4(bounds.center[0], bounds.center[1], bounds.center[2], 1.0f);
+
+    // Camera inside the bounds, nothing to save
+    float distance = -center.z - bounds.radius * scale;
+    if (distance <= 0.0f) return 0;
+
+    float pixelsPerMeshUnit = pixelsPerUnit * scale / distance;
+    for (uint32_t lod = (uint32_t) lodErrors.size() - 1; lod > 0; lod--)
+    {
+        if (lodErrors[lod] * pixelsPerMeshUnit <= common::settings::LOD_PIXEL_ERROR) return lod;
+    }
+
+    return 0;
+}
+
+void MeshAsset::drawSections(ShaderProgram &shader, bool bindMaterials, uint32_t lod, const CullView *view)
 {
-    // KeyValue as in key=value\n files
-    // This will be used for .mat and .skmap files
-    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    lod = std::min(lod, (uint32_t) lodErrors.size() - 1);
 
-    size_t filesize = (size_t) file.tellg();
-    file.seekg(0);
-     
-    if (!file.is_open())
+    size_t firstMeshlet = sectionMeshletStart[lodSectionStart[lod]];
+    size_t meshletCount = sectionMeshletStart[lodSectionStart[lod + 1]] - firstMeshlet;
+    if (view)
     {
-        std::cout << "Failed to open file: " << filePath << "\n";
-        throw std::runtime_error("failed to open key value file");
+        meshletVisible.resize(meshletCount);
+        cullMeshlets(cullData, firstMeshlet, meshletCount, *view, meshletVisible.data());
     }
 
-    std::map<std::string, std::string> kvMap;
+    shader.setVec3("positionScale", glm::vec3(dequantization.scale[0], dequantization.scale[1], dequantization.scale[2]));
+    shader.setVec3("positionOffset", glm::vec3(dequantization.offset[0], dequantization.offset[1], dequantization.offset[2]));
+    shader.setInt("packedTangentFrame", vertexFormat == VertexFormat::Compact);
 
-    char buffer;
-    while (file.tellg() < filesize)
+    // For each section
+    // bind the appropriate material
+    // and render
+
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+    uint32_t boundBatch = UINT32_MAX;
+    for (size_t i = lodSectionStart[lod]; i < lodSectionStart[lod + 1]; i++)
     {
-        std::string key, value;
+        const IndexSection &section = sections[i];
 
-        // Read key
-        while (file.tellg() < filesize)
+        // Surviving meshlets, runs of neighbours merged into one range
+        drawCounts.clear();
+        drawOffsets.clear();
+        if (view)
         {
-            file.read(&buffer, 1);
-            if (buffer == '=') break;
-
-            key += buffer;
+            uint32_t rangeEnd = UINT32_MAX;
+            for (size_t m = sectionMeshletStart[i]; m < sectionMeshletStart[i + 1]; m++)
+            {
+                if (!meshletVisible[m - firstMeshlet]) continue;
+
+                const Meshlet &meshlet = meshlets[m];
+                if (meshlet.firstIndex == rangeEnd)
+                {
+                    drawCounts.back() += meshlet.indexCount;
+                }
+                else
+                {
+                    drawCounts.push_back(meshlet.indexCount);
+                    drawOffsets.push_back((void*)(meshlet.firstIndex * indexSize));
+                }
+                rangeEnd = meshlet.firstIndex + meshlet.indexCount;
+            }
+
+            if (drawCounts.empty()) continue;
         }
 
-        while (file.tellg() < filesize)
+        // Big meshes have several sections per batch, no need to rebind
+        if (bindMaterials && section.batchIndex != boundBatch)
         {
-            file.read(&buffer, 1);
-            if (buffer == '\n') break;
-
-            value += buffer;
+            bindMaterial(shader, section.batchIndex % batchesPerLod);
+            boundBatch = section.batchIndex;
         }
 
-        // fucking windows line enders
-        rtrim(value);
+        if (!view)
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, section.indexCount, indexType,
+                (void*)(section.firstIndex * indexSize), section.baseVertex);
+            continue;
+        }
 
-        kvMap[key] = value;
+        drawBaseVertices.assign(drawCounts.size(), section.baseVertex);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), indexType,
+            drawOffsets.data(), (GLsizei) drawCounts.size(), drawBaseVertices.data());
     }
-
-    file.close();
-
-    return kvMap;
 }
 
-
-PSK_ChunkHeader readChunkHeader(std::ifstream &file)
+// Textures still streaming in have undefined contents, draw as if they were missing
+static TextureHandle streamedTexture(TextureHandle texture)
 {
-    PSK_ChunkHeader header;
-
-    // First 20 bytes header
-    header.chunkId.resize(20);
-    file.read(header.chunkId.data(), 20);
-    
-    // 4 bytes type flag
-    // 4 bytes data size
-    // 4 bytes data count
-    // memcpy to avoid undefined behavior
+    return TextureStreamer::Get().IsPending(texture) ? TextureHandle() : texture;
+}
 
-    char intBuffer[4];
+void MeshAsset::bindMaterial(ShaderProgram &shader, size_t i)
+{
+    // Faces pointing past the material list still get their own batch
+    if (i >= materials.size()) return;
+
+    TexturePool &pool = TexturePool::Get();
+    TextureHandle diffuseTexture = streamedTexture(materials[i]->diffuseTexture);
+    TextureHandle normalTexture = streamedTexture(materials[i]->normalTexture);
+    TextureHandle specPowerTexture = streamedTexture(materials[i]->specPowerTexture);
+
+    // Bind the main textures' arrays (diffuse, normal, spec) to units 0-2,
+    // materials sharing arrays only change the layers
+    pool.Bind(0, diffuseTexture.array);
+    pool.Bind(1, normalTexture.array);
+    pool.Bind(2, specPowerTexture.array);
+
+    shader.setInt("diffuseLayer", diffuseTexture.layer);
+    shader.setInt("normalLayer", normalTexture.layer);
+    shader.setInt("specPowerLayer", specPowerTexture.layer);
+    shader.setInt("hasNormalTexture", normalTexture.IsValid());
+    shader.setInt("hasSpecPowerTexture", specPowerTexture.IsValid());
+
+    // And any extras, as many as fit in the remaining units
+    size_t otherCount = std::min(materials[i]->otherTextures.size(), (size_t) MAX_OTHER_TEXTURES);
+    for (size_t k = 0; k < otherCount; k++)
+    {
+        TextureHandle texture = streamedTexture(materials[i]->otherTextures[k]);
+        pool.Bind(3 + k, texture.array);
+        shader.setInt("otherLayers[" + std::to_string(k) + "]", texture.layer);
+    }
 
-    file.read(intBuffer, 4);
-    std::memcpy(&header.typeFlag, intBuffer, 4);
+    shader.setInt("otherTexturesSize", otherCount);
+}
 
+/*************************** PREPARED MESH ***************************/
 
-    file.read(intBuffer, 4);
-    std::memcpy(&header.dataSize, intBuffer, 4);
+template <typename T>
+static ChunkSpan<T> vectorSpan(const std::vector<T> &vector)
+{
+    ChunkSpan<T> span;
+    span.data = vector.data();
+    span.count = vector.size();
+    return span;
+}
 
-    file.read(intBuffer, 4);
-    std::memcpy(&header.dataCount, intBuffer, 4);
+ChunkSpan<CompleteVertex> PreparedMesh::vertices() const
+{
+    return fromCooked ? cooked.vertices() : vectorSpan(data.vertices);
+}
 
-    std::cout << "Header: " << header.chunkId << " | Type Flag: " << header.typeFlag << " | Data Size: "
-        << header.dataSize << " | Data Count: " << header.dataCount << std::endl;
+ChunkSpan<GLuint> PreparedMesh::indices() const
+{
+    return fromCooked ? cooked.indices() : vectorSpan(data.indices);
+}
 
-    return header;
+ChunkSpan<uint32_t> PreparedMesh::materialBatchSizes() const
+{
+    return fromCooked ? cooked.materialBatchSizes() : vectorSpan(data.materialBatchSizes);
+}
 
+ChunkSpan<float> PreparedMesh::lodErrors() const
+{
+    return fromCooked ? cooked.lodErrors() : vectorSpan(data.lodErrors);
 }
 
-std::vector<PSK_Point> readPointsChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount)
+void uam::prepareMesh(const std::string &pskPath, PreparedMesh &prepared, VertexFormat vertexFormat, VertexLayout vertexLayout,
+    const std::set<std::string> *registeredTextures)
 {
-    std::vector<PSK_Point> points(dataCount);
+    prepareMeshData(pskPath, prepared, registeredTextures);
+    prepareVertexStreams(prepared, vertexFormat, vertexLayout);
+}
 
-    char buffer[4];
+void uam::prepareVertexStreams(PreparedMesh &prepared, VertexFormat vertexFormat, VertexLayout vertexLayout)
+{
+    ChunkSpan<CompleteVertex> vertices = prepared.vertices();
+    prepared.bounds = computeBounds(vertices.data, vertices.size());
 
-    int64_t bytesRead = 0;
-    for (PSK_Point &point : points)
+    prepared.vertexFormat = vertexFormat;
+    if (vertexFormat == VertexFormat::Compact)
     {
-        pskFile.read(buffer, 4);
-        std::memcpy(&point.x, buffer, 4);
-        
-
-        pskFile.read(buffer, 4);
-        std::memcpy(&point.z, buffer, 4);
-        
-        pskFile.read(buffer, 4);
-        std::memcpy(&point.y, buffer, 4);
-        
-        bytesRead += 12;
+        prepared.dequantization = quantizeVertices(vertices.data, vertices.size(), prepared.compactVertices);
     }
 
-    if (bytesRead != (dataSize * dataCount))
+    prepared.vertexLayout = vertexLayout;
+    if (vertexLayout == VertexLayout::Split && vertexFormat == VertexFormat::Compact)
     {
-        std::cout << "Warning: incorrect number of bytes read from points chunk" << std::endl;
+        splitVertexStreams(prepared.compactVertices.data(), prepared.compactVertices.size(), prepared);
+        prepared.compactVertices = std::vector<CompactVertex>();
+    }
+    else if (vertexLayout == VertexLayout::Split)
+    {
+        splitVertexStreams(vertices.data, vertices.size(), prepared);
     }
 
-    return points;
+    ChunkSpan<GLuint> indices = prepared.indices();
+    ChunkSpan<uint32_t> batchSizes = prepared.materialBatchSizes();
+    buildIndexSections(indices.data, batchSizes.data, batchSizes.size(), prepared.shortIndices, prepared.sections);
+    buildMeshlets(vertices.data, vertices.size(), indices.data, prepared.sections, prepared.meshlets);
 }
 
-std::vector<PSK_Wedge> readWedgesChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount)
+static MeshBounds computeBounds(const CompleteVertex *vertices, size_t vertexCount)
 {
+    MeshBounds bounds = { { 0.0f, 0.0f, 0.0f }, 0.0f };
+    if (vertexCount == 0) return bounds;
 
-    std::vector<PSK_Wedge> wedges(dataCount);
-
-    char buffer[4];
-    int64_t bytesRead = 0;
-    for (PSK_Wedge &wedge : wedges)
+    // Box center, close enough for picking LODs
+    glm::vec3 minimum(vertices[0].x, vertices[0].y, vertices[0].z);
+    glm::vec3 maximum = minimum;
+    for (size_t i = 1; i < vertexCount; i++)
     {
-        pskFile.read(buffer, 4);
-        std::memcpy(&wedge.pointIndex, buffer, 4);
-
-        pskFile.read(buffer, 4);
-        std::memcpy(&wedge.u, buffer, 4);
-
-        pskFile.read(buffer, 4);
-        std::memcpy(&wedge.v, buffer, 4);
-
-        pskFile.read(buffer, 4);
-        std::memcpy(&wedge.materialIndex, buffer, 4);
-
-        bytesRead += 16;
+        glm::vec3 position(vertices[i].x, vertices[i].y, vertices[i].z);
+        minimum = glm::min(minimum, position);
+        maximum = glm::max(maximum, position);
     }
 
-    if (bytesRead != (dataSize * dataCount))
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < vertexCount; i++)
     {
-        std::cout << "Warning: incorrect number of bytes read from wedges chunk(Expected: " << dataSize * dataCount << " | Read: "<< bytesRead << ")" << std::endl;
+        glm::vec3 offset = glm::vec3(vertices[i].x, vertices[i].y, vertices[i].z) - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
     }
 
-    return wedges;
+    bounds.center[0] = center.x;
+    bounds.center[1] = center.y;
+    bounds.center[2] = center.z;
+    bounds.radius = std::sqrt(radiusSquared);
+    return bounds;
+}
+
+static void splitVertexStreams(const CompleteVertex *vertices, size_t vertexCount, PreparedMesh &prepared)
+{
+    prepared.positionStream.resize(vertexCount * sizeof(SplitPosition));
+    prepared.attributeStream.resize(vertexCount * sizeof(SplitAttributes));
 
+    SplitPosition *positions = (SplitPosition *) prepared.positionStream.data();
+    SplitAttributes *attributes = (SplitAttributes *) prepared.attributeStream.data();
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        positions[i] = { vertices[i].x, vertices[i].y, vertices[i].z };
+        attributes[i] = { vertices[i].u, vertices[i].v, vertices[i].materialIndex,
+            vertices[i].nx, vertices[i].ny, vertices[i].nz,
+            vertices[i].tx, vertices[i].ty, vertices[i].tz, vertices[i].tw };
+    }
 }
 
-std::vector<PSK_Face> readFacesChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount)
+static void splitVertexStreams(const CompactVertex *vertices, size_t vertexCount, PreparedMesh &prepared)
 {
+    prepared.positionStream.resize(vertexCount * sizeof(CompactSplitPosition));
+    prepared.attributeStream.resize(vertexCount * sizeof(CompactSplitAttributes));
 
-    std::vector<PSK_Face> faces(dataCount);
+    CompactSplitPosition *positions = (CompactSplitPosition *) prepared.positionStream.data();
+    CompactSplitAttributes *attributes = (CompactSplitAttributes *) prepared.attributeStream.data();
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        positions[i] = { vertices[i].x, vertices[i].y, vertices[i].z, vertices[i].materialIndex };
+        attributes[i].u = vertices[i].u;
+        attributes[i].v = vertices[i].v;
+        std::copy(vertices[i].qtangent, vertices[i].qtangent + 4, attributes[i].qtangent);
+    }
+}
 
-    char buffer[4] = {0, 0, 0, 0};
-    int64_t bytesRead = 0;
+static void prepareMeshData(const std::string &pskPath, PreparedMesh &prepared, const std::set<std::string> *registeredTextures)
+{
+    std::string cookedPath = cookedMeshPath(pskPath);
 
-    if (headerId == "FACE0000")
+    // Fast path, everything is already GPU ready on disk
+    if (prepared.cooked.open(cookedPath, pskPath))
     {
-        for (PSK_Face &face : faces)
+        std::cout << "Loading cooked mesh: " << cookedPath << "\n";
+        prepared.fromCooked = true;
+
+        std::vector<std::map<std::string, std::string>> materials;
+        for (size_t i = 0; i < prepared.cooked.materialCount(); i++)
         {
-            pskFile.read(buffer, 2); 
-            std::memcpy(&face.wedge0, buffer, 4);            
+            materials.push_back(prepared.cooked.materialTextures(i));
+        }
 
-            pskFile.read(buffer, 2); 
-            std::memcpy(&face.wedge1, buffer, 4);            
+        prepared.materialImages = decodeMaterialImages(materials, registeredTextures);
+        return;
+    }
 
-            pskFile.read(buffer, 2); 
-            std::memcpy(&face.wedge2, buffer, 4);
+    buildMeshData(pskPath, prepared.data);
 
-            buffer[1] = 0;
-            pskFile.read(buffer, 1);
-            std::memcpy(&face.materialIndex, buffer, 1);
+    if (writeCookedMesh(cookedPath, prepared.data))
+    {
+        std::cout << "Cooked mesh written: " << cookedPath << "\n";
+    }
 
-            pskFile.read(buffer, 1);
-            std::memcpy(&face.auxMaterialIndex, buffer, 1);
+    prepared.materialImages = decodeMaterialImages(prepared.data.materials, registeredTextures);
+}
 
-            pskFile.read(buffer, 4);
-            std::memcpy(&face.smoothingGroups, buffer, 4);
+/*************************** UTIL FUNCTIONS ***************************/
 
+void uam::buildMeshData(const std::string &pskPath, MeshBuildData &data)
+{
+    PSK_MeshData *pskData = loadPSKMapped(pskPath);
 
-            bytesRead += 12;
-        }
-    }
-    else if (headerId == "FACE0032")
-    {
-        std::cout << "Umodel face chunk detected" << std::endl;
-        for (PSK_Face &face : faces)
-        {
-            pskFile.read(buffer, 4); 
-            std::memcpy(&face.wedge0, buffer, 4);            
+    getVertexArray(pskData->points, pskData->wedges, data.vertices);
 
-            pskFile.read(buffer, 4); 
-            std::memcpy(&face.wedge1, buffer, 4);            
+    std::vector<int32_t> smoothingGroups;
+    buildIndicesArray(pskData->faces, pskData->materials.size(), data.indices, data.materialBatchSizes, smoothingGroups);
+    generateTangentFrames(pskData->wedges, data.vertices, data.indices, smoothingGroups);
 
-            pskFile.read(buffer, 4); 
-            std::memcpy(&face.wedge2, buffer, 4);
+    WeldResult weld = weldVertices(data.vertices, data.indices);
+    std::cout << "Welded \"" << pskPath << "\": " << weld.vertexCountBefore << " -> "
+        << weld.vertexCountAfter << " vertices\n";
 
-            buffer[1] = 0;
-            buffer[2] = 0;
-            buffer[3] = 0;
+    VertexCacheStats cacheBefore = analyzeVertexCache(data.indices.data(), data.indices.size(), data.vertices.size());
+    optimizeVertexCacheBatches(data.indices, data.materialBatchSizes, data.vertices.size());
+    VertexCacheStats cacheAfter = analyzeVertexCache(data.indices.data(), data.indices.size(), data.vertices.size());
+    std::cout << "Vertex cache \"" << pskPath << "\": ACMR " << cacheBefore.acmr << " -> " << cacheAfter.acmr
+        << ", ATVR " << cacheBefore.atvr << " -> " << cacheAfter.atvr << "\n";
 
-            pskFile.read(buffer, 1);
-            std::memcpy(&face.materialIndex, buffer, 1);
+    OverdrawStats overdrawBefore = analyzeOverdraw(data.vertices, data.indices);
+    optimizeOverdrawBatches(data.vertices, data.indices, data.materialBatchSizes);
+    OverdrawStats overdrawAfter = analyzeOverdraw(data.vertices, data.indices);
+    std::cout << "Overdraw \"" << pskPath << "\": " << overdrawBefore.overdraw << " -> " << overdrawAfter.overdraw << "\n";
 
-            pskFile.read(buffer, 1);
-            std::memcpy(&face.auxMaterialIndex, buffer, 1);
+    buildLodChain(data, common::settings::MESH_LOD_COUNT);
+    std::cout << "LODs \"" << pskPath << "\": " << data.lodCount << ", errors";
+    for (float error : data.lodErrors) std::cout << " " << error;
+    std::cout << "\n";
 
-            pskFile.read(buffer, 4);
-            std::memcpy(&face.smoothingGroups, buffer, 4);
-            bytesRead += 18;
-        }
-    }
+    optimizeVertexFetch(data.vertices, data.indices);
 
-    if (bytesRead != (dataSize * dataCount))
+    std::vector<std::string> materialNames;
+    for (const auto &materialData : pskData->materials)
     {
-        std::cout << "Warning: incorrect number of bytes read from faces chunk(Expected: " << dataSize * dataCount << " | Read: "<< bytesRead << ")" << std::endl;
+        materialNames.push_back(materialData.name);
     }
+    data.materials = resolveMeshMaterials(pskPath, materialNames, &data.materialFiles);
 
-    return faces;
-
+    delete pskData;
 }
 
-std::vector<PSK_Material> readMaterialsChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount)
+std::vector<std::map<std::string, std::string>> uam::resolveMeshMaterials(const std::string &pskPath,
+    const std::vector<std::string> &materialNames, std::vector<std::string> *materialFiles)
 {
-    std::vector<PSK_Material> materials(dataCount);
+    // Load map file
+    std::map<std::string, std::string> keyMap = readKeyValueFile( std::filesystem::path(pskPath).replace_extension(".skmap").generic_string() );
 
-    char buffer[4];
-    for (PSK_Material &material : materials)
+    // Resolve material textures
+    std::vector<std::map<std::string, std::string>> materials;
+    for (const std::string &materialName : materialNames)
     {
-        material.name.resize(64);
-        pskFile.read(material.name.data(), 64);
-        rtrim(material.name);
+        std::filesystem::path materialPath = keyMap[materialName];
+        std::map<std::string, std::string> materialKeyMap = readKeyValueFile(materialPath.generic_string());
+        if (materialFiles) materialFiles->push_back(materialPath.generic_string());
+
+        materials.push_back(resolveMaterialTextures(materialKeyMap, keyMap));
+    }
+    return materials;
+}
+
+void getVertexArray(std::vector<PSK_Point> &points, std::vector<PSK_Wedge> &wedges, std::vector<CompleteVertex> &vertices)
+{
+    // Normals and tangents are filled in by generateTangentFrames
+    vertices.assign(wedges.size(), CompleteVertex());
+    CompleteVertex *array = vertices.data();
 
-        pskFile.read(buffer, 4);
-        std::memcpy(&material.textureIndex, buffer, 4);
+    for (size_t i = 0; i < wedges.size(); i++)
+    {
+        array[i].x = points[wedges[i].pointIndex].x;
+        array[i].y = points[wedges[i].pointIndex].y;
+        array[i].z = points[wedges[i].pointIndex].z;
 
-        pskFile.read(buffer, 4);
-        std::memcpy(&material.polyFlags, buffer, 4);
+        array[i].u = wedges[i].u;
+        array[i].v = wedges[i].v;
+        array[i].materialIndex = wedges[i].materialIndex;
+    }
+}
 
-        pskFile.read(buffer, 4);
-        std::memcpy(&material.auxMaterial, buffer, 4);
+void buildIndicesArray(std::vector<PSK_Face> &faces, size_t materialCount, std::vector<GLuint> &indices,
+    std::vector<uint32_t> &materialBatchSizes, std::vector<int32_t> &smoothingGroups)
+{
+    indices.resize(3 * faces.size());
+    smoothingGroups.resize(faces.size());
+    GLuint *array = indices.data();
+
+    // Exporters don't promise faces come sorted by material,
+    // so counting sort them into exactly one batch per material.
+    // Stable, so the exporter's order survives within a batch.
+    for (const PSK_Face &face : faces)
+    {
+        materialCount = std::max(materialCount, (size_t) (uint8_t) face.materialIndex + 1);
+    }
 
-        pskFile.read(buffer, 4);
-        std::memcpy(&material.auxFlags, buffer, 4);
+    // Each chunk of faces gets its own histogram,
+    // big meshes count and scatter their chunks as separate jobs
+    size_t chunkSize = faces.size() > FACE_SORT_PARALLEL_THRESHOLD ? FACE_SORT_CHUNK_SIZE : std::max<size_t>(faces.size(), 1);
+    size_t chunkCount = (faces.size() + chunkSize - 1) / chunkSize;
+    std::vector<uint32_t> chunkOffsets(chunkCount * FACE_SORT_BUCKETS, 0);
 
-        pskFile.read(buffer, 4);
-        std::memcpy(&material.lodBias, buffer, 4);
+    auto forEachChunk = [&](const std::function<void(size_t, size_t, uint32_t *)> &function)
+    {
+        JobSystem::Get().ParallelFor(0, chunkCount, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t chunk = begin; chunk < end; chunk++)
+            {
+                size_t first = chunk * chunkSize;
+                size_t last = std::min(first + chunkSize, faces.size());
+                function(first, last, chunkOffsets.data() + chunk * FACE_SORT_BUCKETS);
+            }
+        });
+    };
+
+    forEachChunk([&](size_t first, size_t last, uint32_t *histogram)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            histogram[(uint8_t) faces[i].materialIndex]++;
+        }
+    });
 
-        pskFile.read(buffer, 4);
-        std::memcpy(&material.lodStyle, buffer, 4);
+    // Turn the histograms into each chunk's write position per material
+    materialBatchSizes.assign(materialCount, 0);
 
-        std::cout << "Name: " << material.name << " | Texture Index: " << material.textureIndex
-            << " | Poly Flags: " << material.polyFlags << " | Aux Material: " << material.auxMaterial
-            << " | Aux Flags: " << material.auxFlags << " | " << material.lodBias << " | " << material.lodStyle << "\n\n";
+    uint32_t offset = 0;
+    for (size_t material = 0; material < materialCount; material++)
+    {
+        uint32_t batchStart = offset;
+        for (size_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            uint32_t count = chunkOffsets[chunk * FACE_SORT_BUCKETS + material];
+            chunkOffsets[chunk * FACE_SORT_BUCKETS + material] = offset;
+            offset += count;
+        }
+        materialBatchSizes[material] = 3 * (offset - batchStart);
     }
 
-    return materials;
+    forEachChunk([&](size_t first, size_t last, uint32_t *writePosition)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            uint32_t triangleIndex = writePosition[(uint8_t) faces[i].materialIndex]++;
+            smoothingGroups[triangleIndex] = faces[i].smoothingGroups;
+
+            GLuint *triangle = array + 3 * triangleIndex;
+            triangle[0] = faces[i].wedge0;
+            triangle[1] = faces[i].wedge1;
+            triangle[2] = faces[i].wedge2;
+        }
+    });
 }
 
-PSK_MeshData* loadPSK(const std::string &pskPath)
+
+std::map<std::string, std::string> readKeyValueFile(const std::string &filePath)
 {
-    std::ifstream pskFile(pskPath, std::ios::ate | std::ios::binary);
-    
-    if (!pskFile.is_open())
-    {
-        std::cout << "Failed to open file: " << pskPath << "\n";
-        throw std::runtime_error("failed to open psk file");
-    }
-    
-    size_t filesize = (size_t) pskFile.tellg();
-    pskFile.seekg(0);
-    std::cout << "File \"" << pskPath << "\" loaded (" << filesize / 1000 << " KB)\n";
-    
-    
-    PSK_MeshData *data = new PSK_MeshData;
-    
-    // Load data
-    while (pskFile.tellg() != filesize)
-    {
-        PSK_ChunkHeader header = readChunkHeader(pskFile);
-        std::string id = header.chunkId.substr(0, 8);
-        if (id == "PNTS0000")
-        {
-            data->points = readPointsChunk(pskFile, header.dataSize, header.dataCount);
-            continue;
-        };
+    // KeyValue as in key=value\n files
+    // This will be used for .mat and .skmap files
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
 
-        if (id == "VTXW0000")
-        {
-            data->wedges = readWedgesChunk(pskFile, header.dataSize, header.dataCount);
-            continue;
-        }
+    size_t filesize = (size_t) file.tellg();
+    file.seekg(0);
+     
+    if (!file.is_open())
+    {
+        std::cout << "Failed to open file: " << filePath << "\n";
+        throw std::runtime_error("failed to open key value file");
+    }
+
+    std::map<std::string, std::string> kvMap;
 
-        if (id == "FACE0000" || id == "FACE3200")
+    char buffer;
+    while (file.tellg() < filesize)
+    {
+        std::string key, value;
+
+        // Read key
+        while (file.tellg() < filesize)
         {
-            data->faces = readFacesChunk(pskFile, id, header.dataSize, header.dataCount);
-            continue;
+            file.read(&buffer, 1);
+            if (buffer == '=') break;
+
+            key += buffer;
         }
 
-        if (id == "MATT0000")
+        while (file.tellg() < filesize)
         {
-            data->materials = readMaterialsChunk(pskFile, id, header.dataSize, header.dataCount);
-            continue;
+            file.read(&buffer, 1);
+            if (buffer == '\n') break;
+
+            value += buffer;
         }
 
-        pskFile.seekg( (size_t) pskFile.tellg() + (header.dataCount * header.dataSize) );
+        // fucking windows line enders
+        rtrim(value);
+
+        kvMap[key] = value;
     }
 
-    pskFile.close();
+    file.close();
 
-    return data;
-}
+    return kvMap;
+}
\ No newline at end of file
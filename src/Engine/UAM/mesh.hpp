@@ -4,30 +4,147 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include <glm.hpp>
 
 #include "types.hpp"
 #include "material.hpp"
+#include "cooked.hpp"
+#include "cull.hpp"
+#include "../../Common/settings.hpp"
 #include "../shader.hpp"
 
 namespace uam
 {
+    // CPU side result of loading a mesh, everything but the GL calls.
+    // Comes either straight from the cooked file mapping or from a fresh build.
+    struct PreparedMesh
+    {
+        bool fromCooked = false;
+        CookedMesh cooked;
+        MeshBuildData data;
+
+        std::vector<MaterialImages> materialImages;
+
+        // Filled instead of uploading vertices() when the format is Compact
+        VertexFormat vertexFormat = VertexFormat::Full;
+        std::vector<CompactVertex> compactVertices;
+        VertexDequantization dequantization;
+
+        // Split layout only, Split*/CompactSplit* structs depending on the format
+        VertexLayout vertexLayout = VertexLayout::Interleaved;
+        std::vector<uint8_t> positionStream;
+        std::vector<uint8_t> attributeStream;
+
+        // Built by prepareMesh, shortIndices is empty if the mesh has to stay 32 bit
+        std::vector<uint16_t> shortIndices;
+        std::vector<IndexSection> sections;
+
+        MeshBounds bounds = { { 0.0f, 0.0f, 0.0f }, 0.0f };
+        std::vector<Meshlet> meshlets;
+
+        ChunkSpan<CompleteVertex> vertices() const;
+        ChunkSpan<GLuint> indices() const;
+        ChunkSpan<uint32_t> materialBatchSizes() const;
+        ChunkSpan<float> lodErrors() const;
+    };
+
     class MeshAsset
     {
         std::string pskPath;
         std::vector<Material *> materials;
-        std::vector<uint32_t> materialBatchSizes;
+        std::vector<IndexSection> sections;
+        GLenum indexType = GL_UNSIGNED_INT;
+
+        // sections[lodSectionStart[lod], lodSectionStart[lod + 1]) draw that LOD
+        std::vector<float> lodErrors;
+        std::vector<size_t> lodSectionStart;
+        size_t batchesPerLod = 0;
+        MeshBounds bounds = { { 0.0f, 0.0f, 0.0f }, 0.0f };
+
+        // meshlets[sectionMeshletStart[s], sectionMeshletStart[s + 1]) cover section s
+        std::vector<Meshlet> meshlets;
+        std::vector<size_t> sectionMeshletStart;
+        MeshletCullData cullData;
+
+        // Per draw scratch, kept to avoid reallocating every frame
+        std::vector<uint8_t> meshletVisible;
+        std::vector<GLsizei> drawCounts;
+        std::vector<void *> drawOffsets;
+        std::vector<GLint> drawBaseVertices;
+
+        GLuint VAO = 0;
+        GLuint VBO = 0;
+        GLuint EBO = 0;
 
-        GLuint VAO;
-        GLuint VBO;
-        GLuint EBO;
+        // Position only variant for depth, shadow and picking passes.
+        // attributeVBO is the second stream of the split layout.
+        GLuint positionVAO = 0;
+        GLuint attributeVBO = 0;
 
-        GLuint *buildIndicesArray(std::vector<PSK_Face> &faces);
+        bool loaded = false;
+
+        VertexFormat vertexFormat = VertexFormat::Full;
+        VertexDequantization dequantization = { { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+        VertexLayout vertexLayout = VertexLayout::Interleaved;
+
+        void bindMaterial(ShaderProgram &shader, size_t batchIndex);
+        void drawSections(ShaderProgram &shader, bool bindMaterials, uint32_t lod, const CullView *view);
+        void setPositionAttribute();
+        void setOtherAttributes();
+
+        // attributes is nullptr for the interleaved layout
+        void upload(const void *vertices, size_t vertexBytes, const void *attributes, size_t attributeBytes,
+            const void *indices, size_t indexBytes);
 
     public:
+        // Format and layout default to the COMPACT_VERTICES
+        // and SPLIT_VERTEX_STREAMS settings
         MeshAsset(std::string &pskPath);
+        MeshAsset(std::string &pskPath, VertexFormat vertexFormat, VertexLayout vertexLayout);
         ~MeshAsset();
 
+        // Loads from the cooked mesh when it's up to date,
+        // otherwise builds from the .psk and cooks it
         void LoadData();
-        void Draw(ShaderProgram &shader);
+
+        // GL half of LoadData, consumes the prepared data
+        void Upload(PreparedMesh &prepared);
+
+        bool IsLoaded() const { return loaded; }
+        VertexFormat Format() const { return vertexFormat; }
+        VertexLayout Layout() const { return vertexLayout; }
+        const std::string &Path() const { return pskPath; }
+        void Draw(ShaderProgram &shader, uint32_t lod = 0);
+
+        // Only submits meshlets that survive culling against view
+        void Draw(ShaderProgram &shader, uint32_t lod, const CullView &view);
+
+        // Positions only, no materials bound. Cheapest with the split layout.
+        void DrawPositions(ShaderProgram &shader, uint32_t lod = 0);
+
+        uint32_t LodCount() const { return (uint32_t) lodErrors.size(); }
+
+        // Coarsest LOD whose error stays under LOD_PIXEL_ERROR on screen.
+        // pixelsPerUnit is projection[1][1] * viewport height / 2,
+        // the size in pixels of one unit at distance 1.
+        uint32_t SelectLod(const glm::mat4 &modelViewMatrix, float pixelsPerUnit) const;
     };
+
+    // Parses the .psk, its .skmap and .mat files into GPU ready buffers
+    void buildMeshData(const std::string &pskPath, MeshBuildData &data);
+
+    // Role -> texture path of each named material, through the .psk's .skmap and the .mat files.
+    // The .mat files read go to materialFiles if it isn't null.
+    std::vector<std::map<std::string, std::string>> resolveMeshMaterials(const std::string &pskPath,
+        const std::vector<std::string> &materialNames, std::vector<std::string> *materialFiles = nullptr);
+
+    // CPU half of LoadData, safe to run on a worker thread.
+    // Uses and refreshes the cooked cache, decodes all textures but the
+    // registeredTextures ones then runs prepareVertexStreams.
+    void prepareMesh(const std::string &pskPath, PreparedMesh &prepared, VertexFormat vertexFormat, VertexLayout vertexLayout,
+        const std::set<std::string> *registeredTextures = nullptr);
+
+    // Builds 16 bit index sections, meshlets and bounds, quantizes vertices if vertexFormat
+    // is Compact and splits them into streams if vertexLayout is Split
+    void prepareVertexStreams(PreparedMesh &prepared, VertexFormat vertexFormat, VertexLayout vertexLayout);
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <cmath>
+#include <algorithm>
+
+#include <glm.hpp>
+
+#include "meshopt.hpp"
+
+using namespace uam;
+
+// Cones narrower than this (cos of the widest normal to the axis)
+// can't cull anything worth the test
+#define MESHLET_MIN_CONE_DOT 0.1f
+
+static glm::vec3 position(const CompleteVertex &vertex) { return glm::vec3(vertex.x, vertex.y, vertex.z); }
+
+static void computeMeshletBounds(const CompleteVertex *vertices, const GLuint *indices, Meshlet &meshlet)
+{
+    const GLuint *first = indices + meshlet.firstIndex;
+    const GLuint *last = first + meshlet.indexCount;
+
+    // Box center sphere
+    glm::vec3 minimum = position(vertices[*first]);
+    glm::vec3 maximum = minimum;
+    for (const GLuint *index = first; index < last; index++)
+    {
+        minimum = glm::min(minimum, position(vertices[*index]));
+        maximum = glm::max(maximum, position(vertices[*index]));
+    }
+
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    float radius = 0.0f;
+    for (const GLuint *index = first; index < last; index++)
+    {
+        radius = std::max(radius, glm::length(position(vertices[*index]) - center));
+    }
+
+    // Area weighted average normal, then the widest angle away from it
+    glm::vec3 axis(0.0f);
+    for (const GLuint *triangle = first; triangle + 2 < last; triangle += 3)
+    {
+        glm::vec3 a = position(vertices[triangle[0]]);
+        axis += glm::cross(position(vertices[triangle[1]]) - a, position(vertices[triangle[2]]) - a);
+    }
+
+    float axisLength = glm::length(axis);
+    float minimumDot = -1.0f;
+    if (axisLength > 0.0f)
+    {
+        axis /= axisLength;
+        minimumDot = 1.0f;
+
+        for (const GLuint *triangle = first; triangle + 2 < last; triangle += 3)
+        {
+            glm::vec3 a = position(vertices[triangle[0]]);
+            glm::vec3 normal = glm::cross(position(vertices[triangle[1]]) - a, position(vertices[triangle[2]]) - a);
+            float normalLength = glm::length(normal);
+            if (normalLength <= 0.0f) continue;
+
+            minimumDot = std::min(minimumDot, glm::dot(axis, normal) / normalLength);
+        }
+    }
+
+    meshlet.center[0] = center.x;
+    meshlet.center[1] = center.y;
+    meshlet.center[2] = center.z;
+    meshlet.radius = radius;
+
+    meshlet.coneAxis[0] = axis.x;
+    meshlet.coneAxis[1] = axis.y;
+    meshlet.coneAxis[2] = axis.z;
+
+    // Every normal is within acos(minimumDot) of the axis, so the cluster faces
+    // away once the view direction is more than 90 degrees past that
+    meshlet.coneCutoff = minimumDot >= MESHLET_MIN_CONE_DOT ? std::sqrt(1.0f - minimumDot * minimumDot) : 2.0f;
+}
+
+void uam::buildMeshlets(const CompleteVertex *vertices, size_t vertexCount, const GLuint *indices,
+    const std::vector<IndexSection> &sections, std::vector<Meshlet> &meshlets,
+    uint32_t maxVertices, uint32_t maxTriangles)
+{
+    meshlets.clear();
+
+    // Marks which vertices the open meshlet already has
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    uint32_t currentStamp = 0;
+
+    for (uint32_t section = 0; section < (uint32_t) sections.size(); section++)
+    {
+        uint32_t begin = sections[section].firstIndex;
+        uint32_t end = begin + sections[section].indexCount;
+
+        Meshlet meshlet = {};
+        meshlet.firstIndex = begin;
+        meshlet.section = section;
+        uint32_t meshletVertices = 0;
+        currentStamp++;
+
+        for (uint32_t i = begin; i + 2 < end; i += 3)
+        {
+            uint32_t newVertices = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                if (stamp[indices[i + k]] != currentStamp) newVertices++;
+            }
+
+            // Repeated vertices within the triangle count twice here, harmless
+            if (meshletVertices + newVertices > maxVertices || meshlet.indexCount / 3 >= maxTriangles)
+            {
+                computeMeshletBounds(vertices, indices, meshlet);
+                meshlets.push_back(meshlet);
+
+                meshlet = {};
+                meshlet.firstIndex = i;
+                meshlet.section = section;
+                meshletVertices = 0;
+                currentStamp++;
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                if (stamp[indices[i + k]] == currentStamp) continue;
+
+                stamp[indices[i + k]] = currentStamp;
+                meshletVertices++;
+            }
+            meshlet.indexCount += 3;
+        }
+
+        if (meshlet.indexCount > 0)
+        {
+            computeMeshletBounds(vertices, indices, meshlet);
+            meshlets.push_back(meshlet);
+        }
+    }
+}
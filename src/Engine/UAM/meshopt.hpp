@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "types.hpp"
+
+namespace uam
+{
+    // Mesh processing stages run at build (cook) time,
+    // after getVertexArray/buildIndicesArray
+
+    // Expands to one vertex per corner with a normal and tangent (w is the
+    // bitangent sign). Normals average over corners sharing a point whose faces
+    // share a smoothing group, tangents also need the same wedge and UV winding.
+    // smoothingGroups is per triangle. Indices come back as 0..n-1, weld after.
+    void generateTangentFrames(const std::vector<PSK_Wedge> &wedges, std::vector<CompleteVertex> &vertices,
+        std::vector<GLuint> &indices, const std::vector<int32_t> &smoothingGroups);
+
+    struct WeldResult
+    {
+        size_t vertexCountBefore;
+        size_t vertexCountAfter;
+    };
+
+    // Merges bit identical vertices and remaps indices to match.
+    // Surviving vertices keep their relative order.
+    WeldResult weldVertices(std::vector<CompleteVertex> &vertices, std::vector<GLuint> &indices);
+
+    struct VertexCacheStats
+    {
+        float acmr; // average cache miss ratio, misses per triangle
+        float atvr; // average transformed vertex ratio, misses per unique vertex
+    };
+
+    // Simulates a FIFO post transform cache over the index buffer
+    VertexCacheStats analyzeVertexCache(const GLuint *indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
+
+    // Reorders triangles for the post transform cache (Forsyth)
+    void optimizeVertexCache(GLuint *indices, size_t indexCount, size_t vertexCount);
+
+    // Same, but each material batch is reordered separately
+    // so materialBatchSizes stays valid
+    void optimizeVertexCacheBatches(std::vector<GLuint> &indices, const std::vector<uint32_t> &materialBatchSizes, size_t vertexCount);
+
+    struct OverdrawStats
+    {
+        float overdraw; // shaded / covered, 1.0 is perfect
+        size_t pixelsCovered;
+        size_t pixelsShaded;
+    };
+
+    // Offline metric, rasterizes the mesh on the CPU from 14 fixed views
+    OverdrawStats analyzeOverdraw(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &indices);
+
+    // Reorders clusters of triangles within each material batch so outward
+    // facing ones draw first. Run after optimizeVertexCacheBatches, threshold
+    // bounds how much worse a cluster's cache efficiency may be than its batch's.
+    void optimizeOverdrawBatches(const std::vector<CompleteVertex> &vertices, std::vector<GLuint> &indices,
+        const std::vector<uint32_t> &materialBatchSizes, float threshold = 1.05f);
+
+    // Reorders vertices into first use order and remaps indices.
+    // Run last, once the index order is final.
+    void optimizeVertexFetch(std::vector<CompleteVertex> &vertices, std::vector<GLuint> &indices);
+
+    // Quadric edge collapse (Garland and Heckbert) on the index buffer only.
+    // Vertices never move, so every LOD can share one vertex buffer.
+    // Positions shared by several vertices (UV seams, material boundaries)
+    // are locked and open borders only collapse along themselves.
+    // Each material batch keeps its own range. Returns the largest
+    // collapse error, as a distance in mesh units.
+    float simplifyBatches(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &indices,
+        const std::vector<uint32_t> &materialBatchSizes, size_t targetIndexCount, float maxError,
+        std::vector<GLuint> &destination, std::vector<uint32_t> &destinationBatchSizes);
+
+    // Appends up to maxLods - 1 LODs after LOD0, each with about half the
+    // triangles of the last and cache optimized. Run before optimizeVertexFetch.
+    void buildLodChain(MeshBuildData &data, uint32_t maxLods);
+
+    // Splits each material batch into sections spanning at most 65536
+    // vertices and rebases their indices into shortIndices. Returns false
+    // if a single triangle spans more than that, in which case sections
+    // are one per batch with a zero base and the mesh stays 32 bit.
+    bool buildIndexSections(const GLuint *indices, const uint32_t *materialBatchSizes, size_t batchCount,
+        std::vector<uint16_t> &shortIndices, std::vector<IndexSection> &sections);
+
+    // Greedily splits every section into meshlets of at most maxVertices
+    // unique vertices and maxTriangles triangles, in index order, with
+    // bounds and normal cones. Run after buildIndexSections.
+    void buildMeshlets(const CompleteVertex *vertices, size_t vertexCount, const GLuint *indices,
+        const std::vector<IndexSection> &sections, std::vector<Meshlet> &meshlets,
+        uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+    // IEEE half float, round to nearest even
+    uint16_t floatToHalf(float value);
+
+    // Packs vertices as CompactVertex against their bounding box,
+    // the tangent frame as a snorm16 QTangent.
+    // Returns what the vertex shader needs to undo it.
+    VertexDequantization quantizeVertices(const CompleteVertex *vertices, size_t vertexCount, std::vector<CompactVertex> &compact);
+
+    // Lossless codecs for the cooked mesh streams
+
+    // Edge prediction over recent triangles, about a byte per triangle on
+    // cache optimized meshes. Triangles keep their order and winding but
+    // may come back rotated. indexCount must be a multiple of 3.
+    void encodeIndexBuffer(const GLuint *indices, size_t indexCount, std::vector<uint8_t> &encoded);
+
+    // Returns false on a corrupt stream or an index past vertexCount
+    bool decodeIndexBuffer(const uint8_t *encoded, size_t encodedSize, GLuint *indices, size_t indexCount, size_t vertexCount);
+
+    // Byte transposed deltas between consecutive vertices, bit packed in
+    // groups of 16. vertexSize must be a multiple of 4, at most 256 bytes.
+    void encodeVertexBuffer(const void *vertices, size_t vertexCount, size_t vertexSize, std::vector<uint8_t> &encoded);
+
+    // Fewest bytes encodeVertexBuffer can produce for vertexCount vertices (the
+    // group headers), so a corrupt count is caught before sizing the output
+    size_t minimumEncodedVertexBufferSize(size_t vertexCount, size_t vertexSize);
+
+    // Returns false on a corrupt stream
+    bool decodeVertexBuffer(const uint8_t *encoded, size_t encodedSize, void *vertices, size_t vertexCount, size_t vertexSize);
+}
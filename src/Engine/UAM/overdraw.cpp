@@ -0,0 +1,340 @@
+#include <cmath>
+#include <algorithm>
+
+#include "../jobs.hpp"
+#include "meshopt.hpp"
+
+using namespace uam;
+
+// Cluster splitting, see Sander et al. "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw" (the same paper Tipsify comes from)
+#define OVERDRAW_CACHE_SIZE 16
+#define OVERDRAW_MIN_CLUSTER_TRIANGLES 16
+
+// Offline metric resolution and views
+#define OVERDRAW_GRID_SIZE 256
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+static Vec3 sub(const Vec3 &a, const Vec3 &b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static float dot(const Vec3 &a, const Vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static Vec3 cross(const Vec3 &a, const Vec3 &b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static Vec3 position(const CompleteVertex &vertex) { return { vertex.x, vertex.y, vertex.z }; }
+
+/*************************** CLUSTER SORTING ***************************/
+
+// Splits a cache optimized batch into clusters. A new cluster starts where the
+// cache had to start over (all three vertices missed), as long as the cluster
+// so far is at least as cache friendly as threshold allows.
+static void splitClusters(const GLuint *indices, size_t triangleCount, size_t vertexCount,
+    float threshold, std::vector<size_t> &clusterStarts)
+{
+    std::vector<uint32_t> cacheTimestamp(vertexCount, 0);
+    uint32_t time = OVERDRAW_CACHE_SIZE + 1;
+
+    std::vector<uint32_t> misses(triangleCount);
+    size_t totalMisses = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        misses[t] = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            GLuint vertex = indices[t * 3 + k];
+            if (time - cacheTimestamp[vertex] > OVERDRAW_CACHE_SIZE)
+            {
+                cacheTimestamp[vertex] = time++;
+                misses[t]++;
+            }
+        }
+        totalMisses += misses[t];
+    }
+
+    const float batchAcmr = (float) totalMisses / (float) triangleCount;
+
+    clusterStarts.push_back(0);
+    size_t clusterMisses = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        size_t clusterTriangles = t - clusterStarts.back();
+        if (misses[t] == 3 && clusterTriangles >= OVERDRAW_MIN_CLUSTER_TRIANGLES
+            && (float) clusterMisses / (float) clusterTriangles <= batchAcmr * threshold)
+        {
+            clusterStarts.push_back(t);
+            clusterMisses = 0;
+        }
+        clusterMisses += misses[t];
+    }
+}
+
+static void optimizeOverdrawBatch(const std::vector<CompleteVertex> &vertices, GLuint *indices, size_t indexCount,
+    const Vec3 &meshCenter, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < OVERDRAW_MIN_CLUSTER_TRIANGLES * 2) return;
+
+    std::vector<size_t> clusterStarts;
+    splitClusters(indices, triangleCount, vertices.size(), threshold, clusterStarts);
+    if (clusterStarts.size() < 2) return;
+
+    // Clusters on the outside facing away from the center go first, they're
+    // the most likely to occlude the rest
+    struct Cluster
+    {
+        size_t start;
+        size_t end;
+        float sortKey;
+    };
+
+    std::vector<Cluster> clusters(clusterStarts.size());
+    for (size_t c = 0; c < clusterStarts.size(); c++)
+    {
+        Cluster &cluster = clusters[c];
+        cluster.start = clusterStarts[c];
+        cluster.end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+
+        // Area weighted centroid and normal
+        Vec3 centroid = { 0, 0, 0 };
+        Vec3 normal = { 0, 0, 0 };
+        float totalArea = 0;
+        for (size_t t = cluster.start; t < cluster.end; t++)
+        {
+            Vec3 p0 = position(vertices[indices[t * 3]]);
+            Vec3 p1 = position(vertices[indices[t * 3 + 1]]);
+            Vec3 p2 = position(vertices[indices[t * 3 + 2]]);
+
+            Vec3 faceNormal = cross(sub(p1, p0), sub(p2, p0));
+            float area = std::sqrt(dot(faceNormal, faceNormal));
+
+            centroid.x += (p0.x + p1.x + p2.x) * area / 3.0f;
+            centroid.y += (p0.y + p1.y + p2.y) * area / 3.0f;
+            centroid.z += (p0.z + p1.z + p2.z) * area / 3.0f;
+
+            normal.x += faceNormal.x;
+            normal.y += faceNormal.y;
+            normal.z += faceNormal.z;
+            totalArea += area;
+        }
+
+        if (totalArea > 0)
+        {
+            centroid.x /= totalArea;
+            centroid.y /= totalArea;
+            centroid.z /= totalArea;
+        }
+
+        float normalLength = std::sqrt(dot(normal, normal));
+        cluster.sortKey = normalLength > 0 ? dot(sub(centroid, meshCenter), normal) / normalLength : 0.0f;
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b)
+    {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<GLuint> sorted;
+    sorted.reserve(triangleCount * 3);
+    for (const Cluster &cluster : clusters)
+    {
+        sorted.insert(sorted.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+    }
+
+    std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void uam::optimizeOverdrawBatches(const std::vector<CompleteVertex> &vertices, std::vector<GLuint> &indices,
+    const std::vector<uint32_t> &materialBatchSizes, float threshold)
+{
+    if (vertices.empty()) return;
+
+    Vec3 meshCenter = { 0, 0, 0 };
+    for (const CompleteVertex &vertex : vertices)
+    {
+        meshCenter.x += vertex.x;
+        meshCenter.y += vertex.y;
+        meshCenter.z += vertex.z;
+    }
+    meshCenter.x /= (float) vertices.size();
+    meshCenter.y /= (float) vertices.size();
+    meshCenter.z /= (float) vertices.size();
+
+    std::vector<size_t> batchStart;
+    size_t offset = 0;
+    for (uint32_t batchSize : materialBatchSizes)
+    {
+        batchStart.push_back(std::min(offset, indices.size()));
+        offset += batchSize;
+    }
+    batchStart.push_back(std::min(offset, indices.size()));
+
+    JobSystem::Get().ParallelFor(0, materialBatchSizes.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t batch = begin; batch < end; batch++)
+        {
+            optimizeOverdrawBatch(vertices, indices.data() + batchStart[batch],
+                batchStart[batch + 1] - batchStart[batch], meshCenter, threshold);
+        }
+    });
+}
+
+/*************************** VERTEX FETCH ***************************/
+
+void uam::optimizeVertexFetch(std::vector<CompleteVertex> &vertices, std::vector<GLuint> &indices)
+{
+    const GLuint UNUSED = 0xFFFFFFFFu;
+    std::vector<GLuint> remap(vertices.size(), UNUSED);
+
+    // First use order
+    GLuint nextVertex = 0;
+    for (GLuint &index : indices)
+    {
+        if (remap[index] == UNUSED) remap[index] = nextVertex++;
+        index = remap[index];
+    }
+
+    // Anything never referenced goes to the back
+    for (GLuint &target : remap)
+    {
+        if (target == UNUSED) target = nextVertex++;
+    }
+
+    std::vector<CompleteVertex> reordered(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        reordered[remap[i]] = vertices[i];
+    }
+    vertices.swap(reordered);
+}
+
+/*************************** OVERDRAW METRIC ***************************/
+
+// Rasterizes the whole index buffer in draw order from one orthographic view.
+// No culling, same as the viewer.
+static void rasterizeView(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &indices,
+    const Vec3 &direction, size_t &pixelsCovered, size_t &pixelsShaded)
+{
+    // Basis looking down direction
+    Vec3 up = std::fabs(direction.y) < 0.9f ? Vec3{ 0, 1, 0 } : Vec3{ 1, 0, 0 };
+    Vec3 right = cross(up, direction);
+    float rightLength = std::sqrt(dot(right, right));
+    right = { right.x / rightLength, right.y / rightLength, right.z / rightLength };
+    up = cross(direction, right);
+
+    std::vector<Vec3> projected(vertices.size());
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        Vec3 p = position(vertices[i]);
+        projected[i] = { dot(p, right), dot(p, up), dot(p, direction) };
+
+        minX = std::min(minX, projected[i].x);
+        minY = std::min(minY, projected[i].y);
+        maxX = std::max(maxX, projected[i].x);
+        maxY = std::max(maxY, projected[i].y);
+    }
+
+    // Keep the aspect ratio so triangles aren't stretched
+    float extent = std::max(maxX - minX, maxY - minY);
+    if (extent <= 0) return;
+    float scale = (OVERDRAW_GRID_SIZE - 1) / extent;
+
+    for (Vec3 &p : projected)
+    {
+        p.x = (p.x - minX) * scale;
+        p.y = (p.y - minY) * scale;
+    }
+
+    std::vector<float> depth(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE, 1e30f);
+    std::vector<bool> covered(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE, false);
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        Vec3 a = projected[indices[i]];
+        Vec3 b = projected[indices[i + 1]];
+        Vec3 c = projected[indices[i + 2]];
+
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (area == 0) continue;
+
+        // Either winding
+        if (area < 0)
+        {
+            std::swap(b, c);
+            area = -area;
+        }
+
+        int x0 = std::max(0, (int) std::floor(std::min({ a.x, b.x, c.x })));
+        int y0 = std::max(0, (int) std::floor(std::min({ a.y, b.y, c.y })));
+        int x1 = std::min(OVERDRAW_GRID_SIZE - 1, (int) std::ceil(std::max({ a.x, b.x, c.x })));
+        int y1 = std::min(OVERDRAW_GRID_SIZE - 1, (int) std::ceil(std::max({ a.y, b.y, c.y })));
+
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                // Sample at pixel centers
+                float px = x + 0.5f;
+                float py = y + 0.5f;
+
+                float w0 = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+                float w1 = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+                float w2 = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+                if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+
+                float z = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+
+                size_t pixel = (size_t) y * OVERDRAW_GRID_SIZE + x;
+                covered[pixel] = true;
+                if (z < depth[pixel])
+                {
+                    depth[pixel] = z;
+                    pixelsShaded++;
+                }
+            }
+        }
+    }
+
+    for (bool pixel : covered)
+    {
+        if (pixel) pixelsCovered++;
+    }
+}
+
+OverdrawStats uam::analyzeOverdraw(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &indices)
+{
+    // The six axes and the eight corners of a cube
+    const float d = 0.57735027f;
+    const Vec3 views[] =
+    {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+        { d, d, d }, { d, d, -d }, { d, -d, d }, { d, -d, -d },
+        { -d, d, d }, { -d, d, -d }, { -d, -d, d }, { -d, -d, -d },
+    };
+    const size_t viewCount = sizeof(views) / sizeof(views[0]);
+
+    std::vector<size_t> covered(viewCount, 0);
+    std::vector<size_t> shaded(viewCount, 0);
+    JobSystem::Get().ParallelFor(0, viewCount, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t view = begin; view < end; view++)
+        {
+            rasterizeView(vertices, indices, views[view], covered[view], shaded[view]);
+        }
+    });
+
+    OverdrawStats stats = { 0.0f, 0, 0 };
+    for (size_t view = 0; view < viewCount; view++)
+    {
+        stats.pixelsCovered += covered[view];
+        stats.pixelsShaded += shaded[view];
+    }
+
+    stats.overdraw = stats.pixelsCovered ? (float) stats.pixelsShaded / (float) stats.pixelsCovered : 0.0f;
+    return stats;
+}
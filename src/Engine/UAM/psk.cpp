@@ -0,0 +1,486 @@
+#include <cstring> // for memcpy
+#include <cstddef>
+#include <stdexcept>
+
+#include <fstream>
+#include <iostream>
+
+#include "../../Common/util.hpp"
+#include "psk.hpp"
+#include "pskdecode.hpp"
+#include "../jobs.hpp"
+
+using namespace uam;
+
+PSK_ChunkHeader readChunkHeader(std::ifstream &file);
+std::vector<PSK_Point> readPointsChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount);
+std::vector<PSK_Wedge> readWedgesChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount);
+std::vector<PSK_Face> readFacesChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount);
+std::vector<PSK_Material> readMaterialsChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount);
+
+/*************************** IFSTREAM LOADER ***************************/
+
+PSK_ChunkHeader readChunkHeader(std::ifstream &file)
+{
+    PSK_ChunkHeader header;
+
+    // First 20 bytes header
+    header.chunkId.resize(20);
+    file.read(header.chunkId.data(), 20);
+    
+    // 4 bytes type flag
+    // 4 bytes data size
+    // 4 bytes data count
+    // memcpy to avoid undefined behavior
+
+    char intBuffer[4];
+
+    file.read(intBuffer, 4);
+    std::memcpy(&header.typeFlag, intBuffer, 4);
+
+
+    file.read(intBuffer, 4);
+    std::memcpy(&header.dataSize, intBuffer, 4);
+
+    file.read(intBuffer, 4);
+    std::memcpy(&header.dataCount, intBuffer, 4);
+
+    std::cout << "Header: " << header.chunkId << " | Type Flag: " << header.typeFlag << " | Data Size: "
+        << header.dataSize << " | Data Count: " << header.dataCount << std::endl;
+
+    return header;
+
+}
+
+std::vector<PSK_Point> readPointsChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount)
+{
+    std::vector<PSK_Point> points(dataCount);
+
+    char buffer[4];
+
+    int64_t bytesRead = 0;
+    for (PSK_Point &point : points)
+    {
+        pskFile.read(buffer, 4);
+        std::memcpy(&point.x, buffer, 4);
+        
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&point.z, buffer, 4);
+        
+        pskFile.read(buffer, 4);
+        std::memcpy(&point.y, buffer, 4);
+        
+        bytesRead += 12;
+    }
+
+    if (bytesRead != (dataSize * dataCount))
+    {
+        std::cout << "Warning: incorrect number of bytes read from points chunk" << std::endl;
+    }
+
+    return points;
+}
+
+std::vector<PSK_Wedge> readWedgesChunk(std::ifstream &pskFile, int32_t dataSize, int32_t dataCount)
+{
+
+    std::vector<PSK_Wedge> wedges(dataCount);
+
+    char buffer[4];
+    int64_t bytesRead = 0;
+    for (PSK_Wedge &wedge : wedges)
+    {
+        pskFile.read(buffer, 4);
+        std::memcpy(&wedge.pointIndex, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&wedge.u, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&wedge.v, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&wedge.materialIndex, buffer, 4);
+
+        bytesRead += 16;
+    }
+
+    if (bytesRead != (dataSize * dataCount))
+    {
+        std::cout << "Warning: incorrect number of bytes read from wedges chunk(Expected: " << dataSize * dataCount << " | Read: "<< bytesRead << ")" << std::endl;
+    }
+
+    return wedges;
+
+}
+
+std::vector<PSK_Face> readFacesChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount)
+{
+
+    std::vector<PSK_Face> faces(dataCount);
+
+    char buffer[4] = {0, 0, 0, 0};
+    int64_t bytesRead = 0;
+
+    if (headerId == "FACE0000")
+    {
+        for (PSK_Face &face : faces)
+        {
+            pskFile.read(buffer, 2); 
+            std::memcpy(&face.wedge0, buffer, 4);            
+
+            pskFile.read(buffer, 2); 
+            std::memcpy(&face.wedge1, buffer, 4);            
+
+            pskFile.read(buffer, 2); 
+            std::memcpy(&face.wedge2, buffer, 4);
+
+            buffer[1] = 0;
+            pskFile.read(buffer, 1);
+            std::memcpy(&face.materialIndex, buffer, 1);
+
+            pskFile.read(buffer, 1);
+            std::memcpy(&face.auxMaterialIndex, buffer, 1);
+
+            pskFile.read(buffer, 4);
+            std::memcpy(&face.smoothingGroups, buffer, 4);
+
+
+            bytesRead += 12;
+        }
+    }
+    else if (headerId == "FACE3200")
+    {
+        std::cout << "Umodel face chunk detected" << std::endl;
+        for (PSK_Face &face : faces)
+        {
+            pskFile.read(buffer, 4); 
+            std::memcpy(&face.wedge0, buffer, 4);            
+
+            pskFile.read(buffer, 4); 
+            std::memcpy(&face.wedge1, buffer, 4);            
+
+            pskFile.read(buffer, 4); 
+            std::memcpy(&face.wedge2, buffer, 4);
+
+            buffer[1] = 0;
+            buffer[2] = 0;
+            buffer[3] = 0;
+
+            pskFile.read(buffer, 1);
+            std::memcpy(&face.materialIndex, buffer, 1);
+
+            pskFile.read(buffer, 1);
+            std::memcpy(&face.auxMaterialIndex, buffer, 1);
+
+            pskFile.read(buffer, 4);
+            std::memcpy(&face.smoothingGroups, buffer, 4);
+            bytesRead += 18;
+        }
+    }
+
+    if (bytesRead != (dataSize * dataCount))
+    {
+        std::cout << "Warning: incorrect number of bytes read from faces chunk(Expected: " << dataSize * dataCount << " | Read: "<< bytesRead << ")" << std::endl;
+    }
+
+    return faces;
+
+}
+
+std::vector<PSK_Material> readMaterialsChunk(std::ifstream &pskFile, std::string headerId, int32_t dataSize, int32_t dataCount)
+{
+    std::vector<PSK_Material> materials(dataCount);
+
+    char buffer[4];
+    for (PSK_Material &material : materials)
+    {
+        material.name.resize(64);
+        pskFile.read(material.name.data(), 64);
+        rtrim(material.name);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&material.textureIndex, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&material.polyFlags, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&material.auxMaterial, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&material.auxFlags, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&material.lodBias, buffer, 4);
+
+        pskFile.read(buffer, 4);
+        std::memcpy(&material.lodStyle, buffer, 4);
+
+        std::cout << "Name: " << material.name << " | Texture Index: " << material.textureIndex
+            << " | Poly Flags: " << material.polyFlags << " | Aux Material: " << material.auxMaterial
+            << " | Aux Flags: " << material.auxFlags << " | " << material.lodBias << " | " << material.lodStyle << "\n\n";
+    }
+
+    return materials;
+}
+
+PSK_MeshData *uam::loadPSK(const std::string &pskPath)
+{
+    std::ifstream pskFile(pskPath, std::ios::ate | std::ios::binary);
+    
+    if (!pskFile.is_open())
+    {
+        std::cout << "Failed to open file: " << pskPath << "\n";
+        throw std::runtime_error("failed to open psk file");
+    }
+    
+    size_t filesize = (size_t) pskFile.tellg();
+    pskFile.seekg(0);
+    std::cout << "File \"" << pskPath << "\" loaded (" << filesize / 1000 << " KB)\n";
+    
+    
+    PSK_MeshData *data = new PSK_MeshData;
+    
+    // Load data
+    while (pskFile.tellg() != filesize)
+    {
+        PSK_ChunkHeader header = readChunkHeader(pskFile);
+        std::string id = header.chunkId.substr(0, 8);
+        if (id == "PNTS0000")
+        {
+            data->points = readPointsChunk(pskFile, header.dataSize, header.dataCount);
+            continue;
+        };
+
+        if (id == "VTXW0000")
+        {
+            data->wedges = readWedgesChunk(pskFile, header.dataSize, header.dataCount);
+            continue;
+        }
+
+        if (id == "FACE0000" || id == "FACE3200")
+        {
+            data->faces = readFacesChunk(pskFile, id, header.dataSize, header.dataCount);
+            continue;
+        }
+
+        if (id == "MATT0000")
+        {
+            data->materials = readMaterialsChunk(pskFile, id, header.dataSize, header.dataCount);
+            continue;
+        }
+
+        pskFile.seekg( (size_t) pskFile.tellg() + (header.dataCount * header.dataSize) );
+    }
+
+    pskFile.close();
+
+    return data;
+}
+
+
+/*************************** MAPPED LOADER ***************************/
+
+// Field order and sizes have to line up with the file for the wedge memcpy
+static_assert(sizeof(PSK_RawChunkHeader) == 32, "PSK chunk header must be 32 bytes");
+static_assert(sizeof(PSK_RawPoint) == 12, "PSK point must be 12 bytes");
+static_assert(sizeof(PSK_RawWedge) == 16 && sizeof(PSK_Wedge) == 16, "PSK wedge must be 16 bytes");
+static_assert(offsetof(PSK_Wedge, u) == offsetof(PSK_RawWedge, u), "PSK_Wedge layout mismatch");
+static_assert(offsetof(PSK_Wedge, materialIndex) == offsetof(PSK_RawWedge, materialIndex), "PSK_Wedge layout mismatch");
+static_assert(sizeof(PSK_RawFace16) == 12, "FACE0000 record must be 12 bytes");
+static_assert(sizeof(PSK_RawFace32) == 18, "FACE3200 record must be 18 bytes");
+static_assert(sizeof(PSK_RawMaterial) == 88, "PSK material must be 88 bytes");
+
+// Below this many records in total scheduling costs more than it saves
+#define PSK_PARALLEL_DECODE_THRESHOLD 32768
+
+const PSK_ChunkEntry *PSK_ChunkDirectory::find(const char *chunkId) const
+{
+    for (const PSK_ChunkEntry &entry : entries)
+    {
+        // Ids are padded out to 20 bytes, only the prefix matters
+        if (std::strncmp(entry.chunkId, chunkId, std::strlen(chunkId)) == 0) return &entry;
+    }
+    return nullptr;
+}
+
+bool uam::scanChunks(const char *base, size_t size, PSK_ChunkDirectory &directory)
+{
+    directory.entries.clear();
+
+    size_t offset = 0;
+    while (offset + sizeof(PSK_RawChunkHeader) <= size)
+    {
+        PSK_RawChunkHeader header;
+        std::memcpy(&header, base + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if (header.dataSize < 0 || header.dataCount < 0)
+        {
+            std::cout << "Invalid chunk header at offset " << offset - sizeof(header) << "\n";
+            return false;
+        }
+
+        size_t payloadSize = (size_t) header.dataSize * (size_t) header.dataCount;
+        if (payloadSize > size - offset)
+        {
+            std::cout << "Truncated chunk at offset " << offset - sizeof(header) << "\n";
+            return false;
+        }
+
+        PSK_ChunkEntry entry;
+        std::memcpy(entry.chunkId, header.chunkId, 20);
+        entry.chunkId[20] = 0;
+        entry.offset = offset;
+        entry.dataSize = header.dataSize;
+        entry.dataCount = header.dataCount;
+        directory.entries.push_back(entry);
+
+        offset += payloadSize;
+    }
+
+    return true;
+}
+
+template <typename T>
+static void mapChunk(ChunkSpan<T> &span, const char *base, const PSK_ChunkDirectory &directory, const char *chunkId)
+{
+    const PSK_ChunkEntry *entry = directory.find(chunkId);
+    if (!entry) return;
+
+    if (entry->dataSize != (int32_t) sizeof(T))
+    {
+        std::cout << "Warning: unexpected record size in " << chunkId << " chunk (Expected: " << sizeof(T)
+            << " | Found: " << entry->dataSize << ")" << std::endl;
+        return;
+    }
+
+    span.data = (const T *) (base + entry->offset);
+    span.count = (size_t) entry->dataCount;
+}
+
+bool PSK_MappedMesh::open(const std::string &pskPath)
+{
+    if (!file.open(pskPath))
+    {
+        std::cout << "Failed to open file: " << pskPath << "\n";
+        return false;
+    }
+
+    if (!scanChunks(file.data(), file.size(), directory))
+    {
+        std::cout << "Failed to read chunks of file: " << pskPath << "\n";
+        return false;
+    }
+
+    mapChunk(points, file.data(), directory, "PNTS0000");
+    mapChunk(wedges, file.data(), directory, "VTXW0000");
+    mapChunk(faces16, file.data(), directory, "FACE0000");
+    mapChunk(faces32, file.data(), directory, "FACE3200");
+    mapChunk(materials, file.data(), directory, "MATT0000");
+
+    return true;
+}
+
+// The decoders write into vectors that are already sized
+
+static void decodePoints(PSK_Point *out, const ChunkSpan<PSK_RawPoint> &raw)
+{
+    decodePointsBulk(out, raw.data, raw.size());
+}
+
+static void decodeWedges(PSK_Wedge *out, const ChunkSpan<PSK_RawWedge> &raw)
+{
+    decodeWedgesBulk(out, raw.data, raw.size());
+}
+
+template <typename RawFace>
+static void decodeFaces(PSK_Face *out, const ChunkSpan<RawFace> &raw)
+{
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        const RawFace &face = raw[i];
+        out[i].wedge0 = face.wedge0;
+        out[i].wedge1 = face.wedge1;
+        out[i].wedge2 = face.wedge2;
+        out[i].materialIndex = face.materialIndex;
+        out[i].auxMaterialIndex = face.auxMaterialIndex;
+        out[i].smoothingGroups = face.smoothingGroups;
+    }
+}
+
+static void decodeMaterials(PSK_Material *out, const ChunkSpan<PSK_RawMaterial> &raw)
+{
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        out[i].name.assign(raw[i].name, sizeof(raw[i].name));
+        rtrim(out[i].name);
+
+        out[i].textureIndex = raw[i].textureIndex;
+        out[i].polyFlags = raw[i].polyFlags;
+        out[i].auxMaterial = raw[i].auxMaterial;
+        out[i].auxFlags = raw[i].auxFlags;
+        out[i].lodBias = raw[i].lodBias;
+        out[i].lodStyle = raw[i].lodStyle;
+    }
+}
+
+PSK_MeshData *PSK_MappedMesh::decode() const
+{
+    PSK_MeshData *data = new PSK_MeshData;
+
+    const bool wideFaces = !faces32.empty();
+    const size_t faceCount = wideFaces ? faces32.size() : faces16.size();
+
+    // Size everything up front so workers never reallocate
+    data->points.resize(points.size());
+    data->wedges.resize(wedges.size());
+    data->faces.resize(faceCount);
+    data->materials.resize(materials.size());
+
+    auto decodeAllFaces = [&]()
+    {
+        if (wideFaces) decodeFaces(data->faces.data(), faces32);
+        else decodeFaces(data->faces.data(), faces16);
+    };
+
+    if (points.size() + wedges.size() + faceCount < PSK_PARALLEL_DECODE_THRESHOLD)
+    {
+        decodePoints(data->points.data(), points);
+        decodeWedges(data->wedges.data(), wedges);
+        decodeAllFaces();
+        decodeMaterials(data->materials.data(), materials);
+        return data;
+    }
+
+    // Each chunk is its own job, the calling thread takes the faces
+    JobSystem &jobs = JobSystem::Get();
+    JobCounter counter;
+
+    jobs.Run([&]() { decodePoints(data->points.data(), points); }, &counter);
+    jobs.Run([&]() { decodeWedges(data->wedges.data(), wedges); }, &counter);
+    jobs.Run([&]() { decodeMaterials(data->materials.data(), materials); }, &counter);
+
+    decodeAllFaces();
+    jobs.Wait(counter);
+
+    return data;
+}
+
+PSK_MeshData *uam::loadPSKMapped(const std::string &pskPath)
+{
+    PSK_MappedMesh mapped;
+    if (!mapped.open(pskPath))
+    {
+        throw std::runtime_error("failed to open psk file");
+    }
+
+    std::cout << "File \"" << pskPath << "\" mapped (" << mapped.file.size() / 1000 << " KB, "
+        << mapped.points.size() << " points, " << mapped.wedges.size() << " wedges, "
+        << mapped.faces16.size() + mapped.faces32.size() << " faces, "
+        << mapped.materials.size() << " materials)\n";
+
+    return mapped.decode();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "../../Common/mappedfile.hpp"
+
+namespace uam
+{
+    // On-disk record layouts, exactly as they appear in the file.
+    // Packed so a pointer into the mapping can be used directly
+    // no matter how the chunk happens to be aligned.
+#pragma pack(push, 1)
+    struct PSK_RawChunkHeader
+    {
+        char chunkId[20];
+        int32_t typeFlag;
+        int32_t dataSize;
+        int32_t dataCount;
+    };
+
+    // Unreal is Z up, so y and z are swapped on decode
+    struct PSK_RawPoint
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    struct PSK_RawWedge
+    {
+        uint32_t pointIndex;
+        float u;
+        float v;
+        int32_t materialIndex;
+    };
+
+    // FACE0000
+    struct PSK_RawFace16
+    {
+        uint16_t wedge0;
+        uint16_t wedge1;
+        uint16_t wedge2;
+
+        int8_t materialIndex;
+        int8_t auxMaterialIndex;
+        int32_t smoothingGroups;
+    };
+
+    // FACE3200, written by umodel for meshes with more than 65535 wedges
+    struct PSK_RawFace32
+    {
+        int32_t wedge0;
+        int32_t wedge1;
+        int32_t wedge2;
+
+        int8_t materialIndex;
+        int8_t auxMaterialIndex;
+        int32_t smoothingGroups;
+    };
+
+    struct PSK_RawMaterial
+    {
+        char name[64];
+
+        int32_t textureIndex;
+        int32_t polyFlags;
+        int32_t auxMaterial;
+        int32_t auxFlags;
+        int32_t lodBias;
+        int32_t lodStyle;
+    };
+#pragma pack(pop)
+
+    // Typed window into a chunk payload
+    template <typename T>
+    struct ChunkSpan
+    {
+        const T *data = nullptr;
+        size_t count = 0;
+
+        const T &operator[](size_t i) const { return data[i]; }
+        const T *begin() const { return data; }
+        const T *end() const { return data + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+    };
+
+    // One entry per chunk in the file, in file order
+    struct PSK_ChunkEntry
+    {
+        char chunkId[21];
+        size_t offset; // of the payload, relative to the start of the file
+        int32_t dataSize;
+        int32_t dataCount;
+    };
+
+    struct PSK_ChunkDirectory
+    {
+        std::vector<PSK_ChunkEntry> entries;
+
+        // Returns nullptr if the chunk isn't present
+        const PSK_ChunkEntry *find(const char *chunkId) const;
+    };
+
+    // Walks the chunk headers only, never touching payloads.
+    // Returns false on a malformed or truncated file.
+    bool scanChunks(const char *base, size_t size, PSK_ChunkDirectory &directory);
+
+    // A .psk file mapped into memory with every chunk we care about
+    // exposed in place. Nothing is copied until decode() is called.
+    struct PSK_MappedMesh
+    {
+        common::MappedFile file;
+        PSK_ChunkDirectory directory;
+
+        ChunkSpan<PSK_RawPoint> points;
+        ChunkSpan<PSK_RawWedge> wedges;
+        ChunkSpan<PSK_RawFace16> faces16;
+        ChunkSpan<PSK_RawFace32> faces32;
+        ChunkSpan<PSK_RawMaterial> materials;
+
+        bool open(const std::string &pskPath);
+
+        // Bulk converts the mapped chunks into engine types.
+        // Large meshes decode each chunk as its own job.
+        PSK_MeshData *decode() const;
+    };
+
+    // Reads the file field by field through an ifstream
+    PSK_MeshData *loadPSK(const std::string &pskPath);
+
+    // Maps the file, builds the chunk directory and decodes
+    // each chunk in bulk
+    PSK_MeshData *loadPSKMapped(const std::string &pskPath);
+}
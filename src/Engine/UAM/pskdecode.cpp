@@ -0,0 +1,201 @@
+#include <cstring>
+
+#include "../../Common/cpu.hpp"
+#include "pskdecode.hpp"
+
+using namespace uam;
+
+typedef void (*PointsKernel)(PSK_Point *, const PSK_RawPoint *, size_t);
+typedef void (*WedgesKernel)(PSK_Wedge *, const PSK_RawWedge *, size_t);
+
+/*************************** SCALAR ***************************/
+
+static void decodePointsScalar(PSK_Point *out, const PSK_RawPoint *in, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i].x = in[i].x;
+        out[i].y = in[i].z;
+        out[i].z = in[i].y;
+    }
+}
+
+static void decodeWedgesScalar(PSK_Wedge *out, const PSK_RawWedge *in, size_t count)
+{
+    std::memcpy(out, in, count * sizeof(PSK_RawWedge));
+}
+
+#ifdef COMMON_CPU_X86
+
+/*************************** SSE2 ***************************/
+
+// 4 points are 12 floats, three registers:
+//   x0 z0 y0 x1 | z1 y1 x2 z2 | y2 x3 z3 y3   (y/z as named in the file)
+// and come out as
+//   x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+static void decodePointsSSE2(PSK_Point *out, const PSK_RawPoint *in, size_t count)
+{
+    const float *src = (const float *) in;
+    float *dst = (float *) out;
+
+    size_t blocks = count / 4;
+    for (size_t i = 0; i < blocks; i++)
+    {
+        __m128 v0 = _mm_loadu_ps(src);
+        __m128 v1 = _mm_loadu_ps(src + 4);
+        __m128 v2 = _mm_loadu_ps(src + 8);
+
+        __m128 out0 = _mm_shuffle_ps(v0, v0, _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m128 t1 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(0, 0, 2, 2));
+        __m128 out1 = _mm_shuffle_ps(v1, t1, _MM_SHUFFLE(2, 0, 0, 1));
+
+        __m128 t2 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 1, 3, 3));
+        __m128 out2 = _mm_shuffle_ps(t2, v2, _MM_SHUFFLE(2, 3, 2, 0));
+
+        _mm_storeu_ps(dst, out0);
+        _mm_storeu_ps(dst + 4, out1);
+        _mm_storeu_ps(dst + 8, out2);
+
+        src += 12;
+        dst += 12;
+    }
+
+    decodePointsScalar(out + blocks * 4, in + blocks * 4, count - blocks * 4);
+}
+
+static void decodeWedgesSSE2(PSK_Wedge *out, const PSK_RawWedge *in, size_t count)
+{
+    // One wedge per register
+    const __m128i *src = (const __m128i *) in;
+    __m128i *dst = (__m128i *) out;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i w0 = _mm_loadu_si128(src + i);
+        __m128i w1 = _mm_loadu_si128(src + i + 1);
+        __m128i w2 = _mm_loadu_si128(src + i + 2);
+        __m128i w3 = _mm_loadu_si128(src + i + 3);
+
+        _mm_storeu_si128(dst + i, w0);
+        _mm_storeu_si128(dst + i + 1, w1);
+        _mm_storeu_si128(dst + i + 2, w2);
+        _mm_storeu_si128(dst + i + 3, w3);
+    }
+
+    for (; i < count; i++)
+    {
+        _mm_storeu_si128(dst + i, _mm_loadu_si128(src + i));
+    }
+}
+
+/*************************** AVX2 ***************************/
+
+// Same idea over 8 points (24 floats). The middle register needs one
+// float from the first, the first needs one from the middle.
+COMMON_TARGET_AVX2
+static void decodePointsAVX2(PSK_Point *out, const PSK_RawPoint *in, size_t count)
+{
+    const float *src = (const float *) in;
+    float *dst = (float *) out;
+
+    const __m256i permA = _mm256_setr_epi32(0, 2, 1, 3, 5, 4, 6, 0);
+    const __m256i permB = _mm256_setr_epi32(0, 1, 3, 2, 4, 6, 5, 7);
+    const __m256i permC = _mm256_setr_epi32(1, 0, 2, 4, 3, 5, 7, 6);
+    const __m256i broadcast0 = _mm256_set1_epi32(0);
+    const __m256i broadcast7 = _mm256_set1_epi32(7);
+
+    size_t blocks = count / 8;
+    for (size_t i = 0; i < blocks; i++)
+    {
+        __m256 a = _mm256_loadu_ps(src);
+        __m256 b = _mm256_loadu_ps(src + 8);
+        __m256 c = _mm256_loadu_ps(src + 16);
+
+        __m256 outA = _mm256_blend_ps(
+            _mm256_permutevar8x32_ps(a, permA),
+            _mm256_permutevar8x32_ps(b, broadcast0), 0x80);
+
+        __m256 outB = _mm256_blend_ps(
+            _mm256_permutevar8x32_ps(b, permB),
+            _mm256_permutevar8x32_ps(a, broadcast7), 0x01);
+
+        __m256 outC = _mm256_permutevar8x32_ps(c, permC);
+
+        _mm256_storeu_ps(dst, outA);
+        _mm256_storeu_ps(dst + 8, outB);
+        _mm256_storeu_ps(dst + 16, outC);
+
+        src += 24;
+        dst += 24;
+    }
+
+    decodePointsSSE2(out + blocks * 8, in + blocks * 8, count - blocks * 8);
+}
+
+COMMON_TARGET_AVX2
+static void decodeWedgesAVX2(PSK_Wedge *out, const PSK_RawWedge *in, size_t count)
+{
+    // Two wedges per register
+    const __m256i *src = (const __m256i *) in;
+    __m256i *dst = (__m256i *) out;
+
+    size_t pairs = count / 2;
+    size_t i = 0;
+    for (; i + 4 <= pairs; i += 4)
+    {
+        __m256i w0 = _mm256_loadu_si256(src + i);
+        __m256i w1 = _mm256_loadu_si256(src + i + 1);
+        __m256i w2 = _mm256_loadu_si256(src + i + 2);
+        __m256i w3 = _mm256_loadu_si256(src + i + 3);
+
+        _mm256_storeu_si256(dst + i, w0);
+        _mm256_storeu_si256(dst + i + 1, w1);
+        _mm256_storeu_si256(dst + i + 2, w2);
+        _mm256_storeu_si256(dst + i + 3, w3);
+    }
+
+    for (; i < pairs; i++)
+    {
+        _mm256_storeu_si256(dst + i, _mm256_loadu_si256(src + i));
+    }
+
+    decodeWedgesScalar(out + pairs * 2, in + pairs * 2, count - pairs * 2);
+}
+
+#endif
+
+/*************************** DISPATCH ***************************/
+
+static PointsKernel selectPointsKernel()
+{
+#ifdef COMMON_CPU_X86
+    if (common::cpu::hasAVX2()) return decodePointsAVX2;
+    return decodePointsSSE2;
+#else
+    return decodePointsScalar;
+#endif
+}
+
+static WedgesKernel selectWedgesKernel()
+{
+#ifdef COMMON_CPU_X86
+    if (common::cpu::hasAVX2()) return decodeWedgesAVX2;
+    return decodeWedgesSSE2;
+#else
+    return decodeWedgesScalar;
+#endif
+}
+
+void uam::decodePointsBulk(PSK_Point *out, const PSK_RawPoint *in, size_t count)
+{
+    static const PointsKernel kernel = selectPointsKernel();
+    kernel(out, in, count);
+}
+
+void uam::decodeWedgesBulk(PSK_Wedge *out, const PSK_RawWedge *in, size_t count)
+{
+    static const WedgesKernel kernel = selectWedgesKernel();
+    kernel(out, in, count);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "types.hpp"
+#include "psk.hpp"
+
+namespace uam
+{
+    // Bulk chunk kernels. Each picks the widest instruction set
+    // the CPU supports the first time it's called.
+
+    // PNTS0000 stores XZY, we want XYZ
+    void decodePointsBulk(PSK_Point *out, const PSK_RawPoint *in, size_t count);
+
+    // VTXW0000 matches PSK_Wedge field for field
+    void decodeWedgesBulk(PSK_Wedge *out, const PSK_RawWedge *in, size_t count);
+}
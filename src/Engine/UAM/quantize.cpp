@@ -0,0 +1,314 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "../../Common/cpu.hpp"
+#include "../jobs.hpp"
+#include "meshopt.hpp"
+
+using namespace uam;
+
+#define QUANTIZE_GRAIN_SIZE 16384
+
+uint16_t uam::floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t) ((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // NaN and infinity
+    if (((bits >> 23) & 0xFF) == 0xFF)
+    {
+        return (uint16_t) (sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+
+    // Too big, clamp to infinity
+    if (exponent >= 31) return (uint16_t) (sign | 0x7C00);
+
+    // Subnormal or zero
+    if (exponent <= 0)
+    {
+        if (exponent < -10) return (uint16_t) sign;
+
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t) (14 - exponent);
+        uint32_t half = mantissa >> shift;
+
+        // Round to nearest even
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) half++;
+
+        return (uint16_t) (sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+
+    // Round to nearest even, a carry into the exponent is still correct
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;
+
+    return (uint16_t) half;
+}
+
+static int16_t floatToSnorm16(float value)
+{
+    float scaled = std::min(1.0f, std::max(-1.0f, value)) * 32767.0f;
+    return (int16_t) (scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+/*************************** QTANGENTS ***************************/
+
+// The tangent frame goes in as the rotation whose columns are
+// tangent, cross(normal, tangent) and normal. q and -q are the same
+// rotation, so w is kept positive and its sign carries the handedness.
+// w can't be allowed to reach 0 though, snorm16 has no -0.
+#define QTANGENT_BIAS (1.0f / 32767.0f)
+
+static void encodeQTangent(const CompleteVertex &vertex, int16_t qtangent[4])
+{
+    const float n[3] = { vertex.nx, vertex.ny, vertex.nz };
+
+    // Re-orthogonalize, the frame has to be a proper rotation
+    float d = n[0] * vertex.tx + n[1] * vertex.ty + n[2] * vertex.tz;
+    float t[3] = { vertex.tx - n[0] * d, vertex.ty - n[1] * d, vertex.tz - n[2] * d };
+    float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+    float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+    t[0] *= inverse; t[1] *= inverse; t[2] *= inverse;
+
+    const float b[3] = { n[1] * t[2] - n[2] * t[1], n[2] * t[0] - n[0] * t[2], n[0] * t[1] - n[1] * t[0] };
+
+    // m[row][column]
+    const float m00 = t[0], m01 = b[0], m02 = n[0];
+    const float m10 = t[1], m11 = b[1], m12 = n[1];
+    const float m20 = t[2], m21 = b[2], m22 = n[2];
+
+    float q[4]; // x y z w
+    float trace = m00 + m11 + m22;
+    if (trace > 0.0f)
+    {
+        float s = 0.5f / std::sqrt(trace + 1.0f);
+        q[3] = 0.25f / s;
+        q[0] = (m21 - m12) * s;
+        q[1] = (m02 - m20) * s;
+        q[2] = (m10 - m01) * s;
+    }
+    else if (m00 > m11 && m00 > m22)
+    {
+        float s = 0.5f / std::sqrt(1.0f + m00 - m11 - m22);
+        q[3] = (m21 - m12) * s;
+        q[0] = 0.25f / s;
+        q[1] = (m01 + m10) * s;
+        q[2] = (m02 + m20) * s;
+    }
+    else if (m11 > m22)
+    {
+        float s = 0.5f / std::sqrt(1.0f - m00 + m11 - m22);
+        q[3] = (m02 - m20) * s;
+        q[0] = (m01 + m10) * s;
+        q[1] = 0.25f / s;
+        q[2] = (m12 + m21) * s;
+    }
+    else
+    {
+        float s = 0.5f / std::sqrt(1.0f - m00 - m11 + m22);
+        q[3] = (m10 - m01) * s;
+        q[0] = (m02 + m20) * s;
+        q[1] = (m12 + m21) * s;
+        q[2] = 0.25f / s;
+    }
+
+    float qLength = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    float sign = q[3] < 0.0f ? -1.0f : 1.0f;
+    for (int i = 0; i < 4; i++) q[i] *= sign / qLength;
+
+    if (q[3] < QTANGENT_BIAS)
+    {
+        float rescale = std::sqrt(1.0f - QTANGENT_BIAS * QTANGENT_BIAS);
+        q[0] *= rescale; q[1] *= rescale; q[2] *= rescale;
+        q[3] = QTANGENT_BIAS;
+    }
+
+    float handedness = vertex.tw < 0.0f ? -1.0f : 1.0f;
+    for (int i = 0; i < 4; i++) qtangent[i] = floatToSnorm16(q[i] * handedness);
+}
+
+#ifdef COMMON_CPU_X86
+
+// Same as encodeQTangent, four vertices at a time with one vertex per lane.
+// All four quaternion candidates are computed and the right one is picked per lane.
+static void encodeQTangents4(const CompleteVertex *vertices, CompactVertex *compact)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    // Transpose into SoA
+    __m128 nx = _mm_setr_ps(vertices[0].nx, vertices[1].nx, vertices[2].nx, vertices[3].nx);
+    __m128 ny = _mm_setr_ps(vertices[0].ny, vertices[1].ny, vertices[2].ny, vertices[3].ny);
+    __m128 nz = _mm_setr_ps(vertices[0].nz, vertices[1].nz, vertices[2].nz, vertices[3].nz);
+    __m128 tx = _mm_setr_ps(vertices[0].tx, vertices[1].tx, vertices[2].tx, vertices[3].tx);
+    __m128 ty = _mm_setr_ps(vertices[0].ty, vertices[1].ty, vertices[2].ty, vertices[3].ty);
+    __m128 tz = _mm_setr_ps(vertices[0].tz, vertices[1].tz, vertices[2].tz, vertices[3].tz);
+    __m128 tw = _mm_setr_ps(vertices[0].tw, vertices[1].tw, vertices[2].tw, vertices[3].tw);
+
+    __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, tx), _mm_mul_ps(ny, ty)), _mm_mul_ps(nz, tz));
+    tx = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+    ty = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+    tz = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+
+    __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+    __m128 inverse = _mm_and_ps(_mm_cmpgt_ps(lengthSquared, zero), _mm_div_ps(one, _mm_sqrt_ps(lengthSquared)));
+    tx = _mm_mul_ps(tx, inverse);
+    ty = _mm_mul_ps(ty, inverse);
+    tz = _mm_mul_ps(tz, inverse);
+
+    __m128 bx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+    __m128 by = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+    __m128 bz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+
+    __m128 m00 = tx, m01 = bx, m02 = nx;
+    __m128 m10 = ty, m11 = by, m12 = ny;
+    __m128 m20 = tz, m21 = bz, m22 = nz;
+
+    // 4 * component^2 for each candidate, the largest one is the stable pick
+    __m128 bigW = _mm_add_ps(one, _mm_add_ps(m00, _mm_add_ps(m11, m22)));
+    __m128 bigX = _mm_add_ps(one, _mm_sub_ps(m00, _mm_add_ps(m11, m22)));
+    __m128 bigY = _mm_add_ps(one, _mm_sub_ps(m11, _mm_add_ps(m00, m22)));
+    __m128 bigZ = _mm_add_ps(one, _mm_sub_ps(m22, _mm_add_ps(m00, m11)));
+
+    __m128 pickW = _mm_cmpgt_ps(bigW, one);
+    __m128 pickX = _mm_andnot_ps(pickW, _mm_and_ps(_mm_cmpgt_ps(m00, m11), _mm_cmpgt_ps(m00, m22)));
+    __m128 pickY = _mm_andnot_ps(_mm_or_ps(pickW, pickX), _mm_cmpgt_ps(m11, m22));
+    __m128 pickZ = _mm_andnot_ps(_mm_or_ps(pickW, _mm_or_ps(pickX, pickY)), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+    __m128 big = _mm_or_ps(_mm_or_ps(_mm_and_ps(pickW, bigW), _mm_and_ps(pickX, bigX)),
+        _mm_or_ps(_mm_and_ps(pickY, bigY), _mm_and_ps(pickZ, bigZ)));
+    __m128 root = _mm_sqrt_ps(_mm_max_ps(big, _mm_set1_ps(1e-12f)));
+    __m128 s = _mm_div_ps(_mm_set1_ps(0.5f), root);
+    __m128 largest = _mm_mul_ps(_mm_set1_ps(0.5f), root);
+
+    __m128 diffX = _mm_mul_ps(_mm_sub_ps(m21, m12), s);
+    __m128 diffY = _mm_mul_ps(_mm_sub_ps(m02, m20), s);
+    __m128 diffZ = _mm_mul_ps(_mm_sub_ps(m10, m01), s);
+    __m128 sumXY = _mm_mul_ps(_mm_add_ps(m01, m10), s);
+    __m128 sumXZ = _mm_mul_ps(_mm_add_ps(m02, m20), s);
+    __m128 sumYZ = _mm_mul_ps(_mm_add_ps(m12, m21), s);
+
+    auto select = [](__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); };
+
+    __m128 qw = select(pickW, largest, select(pickX, diffX, select(pickY, diffY, diffZ)));
+    __m128 qx = select(pickW, diffX, select(pickX, largest, select(pickY, sumXY, sumXZ)));
+    __m128 qy = select(pickW, diffY, select(pickX, sumXY, select(pickY, largest, sumYZ)));
+    __m128 qz = select(pickW, diffZ, select(pickX, sumXZ, select(pickY, sumYZ, largest)));
+
+    // Normalize and flip so w >= 0
+    __m128 qLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+        _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw))));
+    __m128 signBit = _mm_and_ps(qw, _mm_set1_ps(-0.0f));
+    __m128 scale = _mm_xor_ps(_mm_div_ps(one, qLength), signBit);
+    qx = _mm_mul_ps(qx, scale);
+    qy = _mm_mul_ps(qy, scale);
+    qz = _mm_mul_ps(qz, scale);
+    qw = _mm_mul_ps(qw, scale);
+
+    __m128 bias = _mm_set1_ps(QTANGENT_BIAS);
+    __m128 biased = _mm_cmplt_ps(qw, bias);
+    __m128 rescale = select(biased, _mm_set1_ps(std::sqrt(1.0f - QTANGENT_BIAS * QTANGENT_BIAS)), one);
+    qx = _mm_mul_ps(qx, rescale);
+    qy = _mm_mul_ps(qy, rescale);
+    qz = _mm_mul_ps(qz, rescale);
+    qw = _mm_max_ps(qw, bias);
+
+    // Negative handedness negates the whole quaternion, then snorm16 with rounding
+    __m128 handedness = _mm_and_ps(_mm_cmplt_ps(tw, zero), _mm_set1_ps(-0.0f));
+    __m128 snormScale = _mm_xor_ps(_mm_set1_ps(32767.0f), handedness);
+    __m128i ix = _mm_cvtps_epi32(_mm_mul_ps(qx, snormScale));
+    __m128i iy = _mm_cvtps_epi32(_mm_mul_ps(qy, snormScale));
+    __m128i iz = _mm_cvtps_epi32(_mm_mul_ps(qz, snormScale));
+    __m128i iw = _mm_cvtps_epi32(_mm_mul_ps(qw, snormScale));
+
+    // Saturating packs give xy and zw interleaved per lane after the unpacks
+    __m128i xy = _mm_unpacklo_epi16(_mm_packs_epi32(ix, ix), _mm_packs_epi32(iy, iy));
+    __m128i zw = _mm_unpacklo_epi16(_mm_packs_epi32(iz, iz), _mm_packs_epi32(iw, iw));
+    __m128i lanes01 = _mm_unpacklo_epi32(xy, zw);
+    __m128i lanes23 = _mm_unpackhi_epi32(xy, zw);
+
+    _mm_storel_epi64((__m128i *) compact[0].qtangent, lanes01);
+    _mm_storel_epi64((__m128i *) compact[1].qtangent, _mm_srli_si128(lanes01, 8));
+    _mm_storel_epi64((__m128i *) compact[2].qtangent, lanes23);
+    _mm_storel_epi64((__m128i *) compact[3].qtangent, _mm_srli_si128(lanes23, 8));
+}
+
+#endif
+
+static void encodeQTangents(const CompleteVertex *vertices, CompactVertex *compact, size_t begin, size_t end)
+{
+    size_t i = begin;
+#ifdef COMMON_CPU_X86
+    for (; i + 4 <= end; i += 4)
+    {
+        encodeQTangents4(vertices + i, compact + i);
+    }
+#endif
+    for (; i < end; i++)
+    {
+        encodeQTangent(vertices[i], compact[i].qtangent);
+    }
+}
+
+VertexDequantization uam::quantizeVertices(const CompleteVertex *vertices, size_t vertexCount, std::vector<CompactVertex> &compact)
+{
+    VertexDequantization dequantization = { { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+    compact.resize(vertexCount);
+    if (vertexCount == 0) return dequantization;
+
+    float minimum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+    float maximum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+        const float position[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+        for (int axis = 0; axis < 3; axis++)
+        {
+            minimum[axis] = std::min(minimum[axis], position[axis]);
+            maximum[axis] = std::max(maximum[axis], position[axis]);
+        }
+    }
+
+    // The shader gets a normalized [0, 1] value back
+    float quantizeScale[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = maximum[axis] - minimum[axis];
+        dequantization.offset[axis] = minimum[axis];
+        dequantization.scale[axis] = extent;
+        quantizeScale[axis] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+    }
+
+    JobSystem::Get().ParallelFor(0, vertexCount, QUANTIZE_GRAIN_SIZE, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const float position[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+            uint16_t quantized[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float value = (position[axis] - minimum[axis]) * quantizeScale[axis];
+                quantized[axis] = (uint16_t) std::min(65535.0f, std::max(0.0f, value + 0.5f));
+            }
+
+            compact[i].x = quantized[0];
+            compact[i].y = quantized[1];
+            compact[i].z = quantized[2];
+            compact[i].materialIndex = (uint16_t) std::min(65535, std::max(0, (int) vertices[i].materialIndex));
+            compact[i].u = floatToHalf(vertices[i].u);
+            compact[i].v = floatToHalf(vertices[i].v);
+        }
+
+        encodeQTangents(vertices, compact.data(), begin, end);
+    });
+
+    return dequantization;
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+
+#include "meshopt.hpp"
+
+using namespace uam;
+
+#define SHORT_INDEX_RANGE 65535u
+
+static void buildBatchSections(const uint32_t *materialBatchSizes, size_t batchCount, std::vector<IndexSection> &sections)
+{
+    uint32_t firstIndex = 0;
+    for (size_t batch = 0; batch < batchCount; batch++)
+    {
+        sections.push_back({ firstIndex, materialBatchSizes[batch], 0, (uint32_t) batch });
+        firstIndex += materialBatchSizes[batch];
+    }
+}
+
+bool uam::buildIndexSections(const GLuint *indices, const uint32_t *materialBatchSizes, size_t batchCount,
+    std::vector<uint16_t> &shortIndices, std::vector<IndexSection> &sections)
+{
+    shortIndices.clear();
+    sections.clear();
+
+    // Vertices are in first use order by now, so triangles in a batch
+    // touch a fairly narrow window and sections rarely need to split
+    uint32_t batchStart = 0;
+    for (size_t batch = 0; batch < batchCount; batch++)
+    {
+        uint32_t batchEnd = batchStart + materialBatchSizes[batch];
+
+        IndexSection section = { batchStart, 0, 0, (uint32_t) batch };
+        uint32_t minimum = UINT32_MAX;
+        uint32_t maximum = 0;
+
+        for (uint32_t i = batchStart; i + 2 < batchEnd; i += 3)
+        {
+            uint32_t triangleMin = std::min(indices[i], std::min(indices[i + 1], indices[i + 2]));
+            uint32_t triangleMax = std::max(indices[i], std::max(indices[i + 1], indices[i + 2]));
+
+            if (triangleMax - triangleMin > SHORT_INDEX_RANGE)
+            {
+                shortIndices.clear();
+                sections.clear();
+                buildBatchSections(materialBatchSizes, batchCount, sections);
+                return false;
+            }
+
+            uint32_t newMin = std::min(minimum, triangleMin);
+            uint32_t newMax = std::max(maximum, triangleMax);
+
+            if (newMax - newMin > SHORT_INDEX_RANGE)
+            {
+                section.baseVertex = (int32_t) minimum;
+                sections.push_back(section);
+
+                section = { i, 0, 0, (uint32_t) batch };
+                newMin = triangleMin;
+                newMax = triangleMax;
+            }
+
+            minimum = newMin;
+            maximum = newMax;
+            section.indexCount += 3;
+        }
+
+        if (section.indexCount > 0)
+        {
+            section.baseVertex = (int32_t) minimum;
+            sections.push_back(section);
+        }
+
+        batchStart = batchEnd;
+    }
+
+    shortIndices.resize(batchStart);
+    for (const IndexSection &section : sections)
+    {
+        for (uint32_t i = section.firstIndex; i < section.firstIndex + section.indexCount; i++)
+        {
+            shortIndices[i] = (uint16_t) (indices[i] - (uint32_t) section.baseVertex);
+        }
+    }
+
+    return true;
+}
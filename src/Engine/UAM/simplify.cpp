@@ -0,0 +1,471 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "meshopt.hpp"
+
+using namespace uam;
+
+// Open border edges get a plane through them perpendicular to
+// the surface, weighted up so borders hold their shape
+#define SIMPLIFY_BORDER_WEIGHT 10.0
+
+// Each LOD aims for this fraction of the previous one's triangles,
+// the chain stops once a step keeps more than LOD_MIN_REDUCTION of them
+#define LOD_TRIANGLE_RATIO 0.5f
+#define LOD_MIN_REDUCTION 0.9f
+
+// Collapses are capped at this fraction of the mesh extent
+#define LOD_MAX_RELATIVE_ERROR 0.05f
+
+enum VertexKind : uint8_t
+{
+    VERTEX_MANIFOLD, // interior, collapses anywhere
+    VERTEX_BORDER,   // on one open border, collapses along it
+    VERTEX_LOCKED    // seam, material boundary or non manifold, never moves
+};
+
+struct Quadric
+{
+    // Symmetric 4x4, plus the total weight so the
+    // error comes out as a mean squared distance
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+    double weight;
+};
+
+static void addPlane(Quadric &q, double a, double b, double c, double d, double weight)
+{
+    q.a00 += weight * a * a; q.a01 += weight * a * b; q.a02 += weight * a * c; q.a03 += weight * a * d;
+    q.a11 += weight * b * b; q.a12 += weight * b * c; q.a13 += weight * b * d;
+    q.a22 += weight * c * c; q.a23 += weight * c * d;
+    q.a33 += weight * d * d;
+    q.weight += weight;
+}
+
+static void addQuadric(Quadric &q, const Quadric &other)
+{
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+    q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+    q.a22 += other.a22; q.a23 += other.a23;
+    q.a33 += other.a33;
+    q.weight += other.weight;
+}
+
+static double quadricError(const Quadric &q, const CompleteVertex &v)
+{
+    double x = v.x, y = v.y, z = v.z;
+    double error = q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x
+        + q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y
+        + q.a22 * z * z + 2 * q.a23 * z
+        + q.a33;
+
+    return q.weight > 0.0 ? std::fabs(error) / q.weight : 0.0;
+}
+
+struct Vec3d
+{
+    double x, y, z;
+};
+
+static Vec3d sub(const CompleteVertex &a, const CompleteVertex &b) { return { (double) a.x - b.x, (double) a.y - b.y, (double) a.z - b.z }; }
+static double dot(const Vec3d &a, const Vec3d &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static Vec3d cross(const Vec3d &a, const Vec3d &b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static uint64_t edgeKey(GLuint a, GLuint b)
+{
+    return ((uint64_t) a << 32) | b;
+}
+
+/*************************** CLASSIFICATION ***************************/
+
+struct PositionHash
+{
+    size_t operator()(const CompleteVertex *vertex) const
+    {
+        // Bit patterns, same rule as welding
+        uint32_t words[3];
+        std::memcpy(words, &vertex->x, sizeof(words));
+        return (size_t) words[0] * 73856093u ^ (size_t) words[1] * 19349663u ^ (size_t) words[2] * 83492791u;
+    }
+};
+
+struct PositionEqual
+{
+    bool operator()(const CompleteVertex *a, const CompleteVertex *b) const
+    {
+        return std::memcmp(&a->x, &b->x, 3 * sizeof(float)) == 0;
+    }
+};
+
+// After welding a position with more than one vertex on it is
+// a UV seam or a material boundary, either way it has to stay put
+static std::vector<bool> findSharedPositions(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &indices)
+{
+    std::vector<bool> used(vertices.size(), false);
+    for (GLuint index : indices) used[index] = true;
+
+    std::unordered_map<const CompleteVertex *, GLuint, PositionHash, PositionEqual> firstAtPosition;
+    firstAtPosition.reserve(vertices.size());
+
+    std::vector<bool> shared(vertices.size(), false);
+    for (GLuint i = 0; i < (GLuint) vertices.size(); i++)
+    {
+        if (!used[i]) continue;
+
+        auto inserted = firstAtPosition.emplace(&vertices[i], i);
+        if (!inserted.second)
+        {
+            shared[i] = true;
+            shared[inserted.first->second] = true;
+        }
+    }
+
+    return shared;
+}
+
+static void classifyVertices(const std::vector<GLuint> &triangles, const std::vector<bool> &sharedPosition,
+    std::unordered_set<uint64_t> &openEdges, std::vector<uint8_t> &kind)
+{
+    std::unordered_set<uint64_t> edges;
+    edges.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            edges.insert(edgeKey(triangles[i + e], triangles[i + (e + 1) % 3]));
+        }
+    }
+
+    // Directed edges without a twin
+    std::vector<uint8_t> openCount(kind.size(), 0);
+    openEdges.clear();
+    for (uint64_t edge : edges)
+    {
+        GLuint a = (GLuint) (edge >> 32);
+        GLuint b = (GLuint) edge;
+        if (edges.count(edgeKey(b, a))) continue;
+
+        openEdges.insert(edge);
+        openCount[a] = (uint8_t) std::min(255, openCount[a] + 1);
+        openCount[b] = (uint8_t) std::min(255, openCount[b] + 1);
+    }
+
+    for (size_t v = 0; v < kind.size(); v++)
+    {
+        if (sharedPosition[v]) kind[v] = VERTEX_LOCKED;
+        else if (openCount[v] == 0) kind[v] = VERTEX_MANIFOLD;
+        else if (openCount[v] == 2) kind[v] = VERTEX_BORDER;
+        else kind[v] = VERTEX_LOCKED;
+    }
+}
+
+/*************************** COLLAPSING ***************************/
+
+static void buildQuadrics(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &triangles,
+    const std::unordered_set<uint64_t> &openEdges, std::vector<Quadric> &quadrics)
+{
+    quadrics.assign(vertices.size(), Quadric());
+
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        const CompleteVertex &v0 = vertices[triangles[i]];
+        const CompleteVertex &v1 = vertices[triangles[i + 1]];
+        const CompleteVertex &v2 = vertices[triangles[i + 2]];
+
+        Vec3d normal = cross(sub(v1, v0), sub(v2, v0));
+        double length = std::sqrt(dot(normal, normal));
+        if (length <= 0.0) continue;
+
+        double a = normal.x / length, b = normal.y / length, c = normal.z / length;
+        double d = -(a * v0.x + b * v0.y + c * v0.z);
+        double area = 0.5 * length;
+
+        for (int k = 0; k < 3; k++)
+        {
+            addPlane(quadrics[triangles[i + k]], a, b, c, d, area);
+        }
+
+        for (int e = 0; e < 3; e++)
+        {
+            GLuint from = triangles[i + e];
+            GLuint to = triangles[i + (e + 1) % 3];
+            if (!openEdges.count(edgeKey(from, to))) continue;
+
+            Vec3d edge = sub(vertices[to], vertices[from]);
+            Vec3d perpendicular = cross(edge, { a, b, c });
+            double perpendicularLength = std::sqrt(dot(perpendicular, perpendicular));
+            if (perpendicularLength <= 0.0) continue;
+
+            double pa = perpendicular.x / perpendicularLength;
+            double pb = perpendicular.y / perpendicularLength;
+            double pc = perpendicular.z / perpendicularLength;
+            double pd = -(pa * vertices[from].x + pb * vertices[from].y + pc * vertices[from].z);
+            double weight = dot(edge, edge) * SIMPLIFY_BORDER_WEIGHT;
+
+            addPlane(quadrics[from], pa, pb, pc, pd, weight);
+            addPlane(quadrics[to], pa, pb, pc, pd, weight);
+        }
+    }
+}
+
+struct Collapse
+{
+    GLuint from;
+    GLuint to;
+    double error;
+};
+
+static bool canCollapse(GLuint from, GLuint to, const std::vector<uint8_t> &kind, const std::unordered_set<uint64_t> &openEdges)
+{
+    if (kind[from] == VERTEX_MANIFOLD) return true;
+
+    // Border vertices only slide along their border
+    if (kind[from] == VERTEX_BORDER)
+    {
+        return openEdges.count(edgeKey(from, to)) || openEdges.count(edgeKey(to, from));
+    }
+
+    return false;
+}
+
+// Rejects collapses that would turn a surrounding triangle over
+static bool flipsTriangle(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &triangles,
+    const uint32_t *adjacent, size_t adjacentCount, GLuint from, GLuint to)
+{
+    for (size_t k = 0; k < adjacentCount; k++)
+    {
+        const GLuint *triangle = &triangles[adjacent[k] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+
+        int corner = triangle[0] == from ? 0 : triangle[1] == from ? 1 : 2;
+        const CompleteVertex &b = vertices[triangle[(corner + 1) % 3]];
+        const CompleteVertex &c = vertices[triangle[(corner + 2) % 3]];
+
+        Vec3d before = cross(sub(b, vertices[from]), sub(c, vertices[from]));
+        Vec3d after = cross(sub(b, vertices[to]), sub(c, vertices[to]));
+        if (dot(before, after) <= 0.0) return true;
+    }
+
+    return false;
+}
+
+// One round of collapses, each vertex moves at most once and nothing next to
+// a collapse moves in the same round. Returns the number of collapses made.
+static size_t collapsePass(const std::vector<CompleteVertex> &vertices, std::vector<GLuint> &triangles,
+    std::vector<uint32_t> &triangleBatch, const std::vector<bool> &sharedPosition, std::vector<Quadric> &quadrics,
+    size_t targetTriangleCount, double maxError, double &resultError)
+{
+    size_t vertexCount = vertices.size();
+    size_t triangleCount = triangles.size() / 3;
+
+    std::unordered_set<uint64_t> openEdges;
+    std::vector<uint8_t> kind(vertexCount);
+    classifyVertices(triangles, sharedPosition, openEdges, kind);
+
+    // Vertex to triangle adjacency
+    std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+    for (GLuint index : triangles) adjacencyOffset[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+
+    std::vector<uint32_t> adjacency(triangles.size());
+    std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < triangles.size(); i++)
+    {
+        adjacency[fill[triangles[i]]++] = (uint32_t) (i / 3);
+    }
+
+    std::vector<Collapse> collapses;
+    collapses.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            GLuint a = triangles[i + e];
+            GLuint b = triangles[i + (e + 1) % 3];
+
+            // Both directions are considered from the edge's twin as well,
+            // only open edges need the reverse added here
+            if (canCollapse(a, b, kind, openEdges))
+            {
+                collapses.push_back({ a, b, quadricError(quadrics[a], vertices[b]) });
+            }
+            if (openEdges.count(edgeKey(a, b)) && canCollapse(b, a, kind, openEdges))
+            {
+                collapses.push_back({ b, a, quadricError(quadrics[b], vertices[a]) });
+            }
+        }
+    }
+
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+    std::vector<GLuint> remap(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) remap[v] = (GLuint) v;
+
+    std::vector<bool> touched(vertexCount, false);
+    size_t collapseCount = 0;
+    size_t removedTriangles = 0;
+    size_t removeGoal = triangleCount > targetTriangleCount ? triangleCount - targetTriangleCount : 0;
+
+    for (const Collapse &collapse : collapses)
+    {
+        if (removedTriangles >= removeGoal) break;
+        if (collapse.error > maxError) break;
+        if (touched[collapse.from] || touched[collapse.to]) continue;
+
+        const uint32_t *adjacent = &adjacency[adjacencyOffset[collapse.from]];
+        size_t adjacentCount = adjacencyOffset[collapse.from + 1] - adjacencyOffset[collapse.from];
+        if (flipsTriangle(vertices, triangles, adjacent, adjacentCount, collapse.from, collapse.to)) continue;
+
+        remap[collapse.from] = collapse.to;
+        addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+        resultError = std::max(resultError, collapse.error);
+        collapseCount++;
+
+        // Freeze the whole neighbourhood, its flip checks assumed nothing else moves
+        for (size_t k = 0; k < adjacentCount; k++)
+        {
+            const GLuint *triangle = &triangles[adjacent[k] * 3];
+            bool shared = triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to;
+            if (shared) removedTriangles++;
+
+            touched[triangle[0]] = true;
+            touched[triangle[1]] = true;
+            touched[triangle[2]] = true;
+        }
+    }
+
+    if (collapseCount == 0) return 0;
+
+    // Apply and drop what became degenerate, keeping triangle order
+    size_t write = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        GLuint a = remap[triangles[t * 3]];
+        GLuint b = remap[triangles[t * 3 + 1]];
+        GLuint c = remap[triangles[t * 3 + 2]];
+        if (a == b || b == c || a == c) continue;
+
+        triangles[write * 3] = a;
+        triangles[write * 3 + 1] = b;
+        triangles[write * 3 + 2] = c;
+        triangleBatch[write] = triangleBatch[t];
+        write++;
+    }
+
+    triangles.resize(write * 3);
+    triangleBatch.resize(write);
+    return collapseCount;
+}
+
+float uam::simplifyBatches(const std::vector<CompleteVertex> &vertices, const std::vector<GLuint> &indices,
+    const std::vector<uint32_t> &materialBatchSizes, size_t targetIndexCount, float maxError,
+    std::vector<GLuint> &destination, std::vector<uint32_t> &destinationBatchSizes)
+{
+    // Batches are simplified together, they can't interfere since
+    // every vertex on a material boundary is locked
+    std::vector<GLuint> triangles(indices.begin(), indices.end());
+    std::vector<uint32_t> triangleBatch;
+    triangleBatch.reserve(indices.size() / 3);
+    for (size_t batch = 0; batch < materialBatchSizes.size(); batch++)
+    {
+        triangleBatch.insert(triangleBatch.end(), materialBatchSizes[batch] / 3, (uint32_t) batch);
+    }
+    triangles.resize(triangleBatch.size() * 3);
+
+    std::vector<bool> sharedPosition = findSharedPositions(vertices, indices);
+
+    std::unordered_set<uint64_t> openEdges;
+    std::vector<uint8_t> kind(vertices.size());
+    classifyVertices(triangles, sharedPosition, openEdges, kind);
+
+    std::vector<Quadric> quadrics;
+    buildQuadrics(vertices, triangles, openEdges, quadrics);
+
+    double resultError = 0.0;
+    double maxErrorSquared = (double) maxError * maxError;
+    size_t targetTriangleCount = targetIndexCount / 3;
+
+    while (triangles.size() / 3 > targetTriangleCount)
+    {
+        if (collapsePass(vertices, triangles, triangleBatch, sharedPosition, quadrics,
+            targetTriangleCount, maxErrorSquared, resultError) == 0)
+        {
+            break;
+        }
+    }
+
+    // Back into one contiguous range per batch
+    destinationBatchSizes.assign(materialBatchSizes.size(), 0);
+    for (uint32_t batch : triangleBatch) destinationBatchSizes[batch] += 3;
+
+    std::vector<uint32_t> batchWrite(materialBatchSizes.size(), 0);
+    for (size_t batch = 1; batch < batchWrite.size(); batch++)
+    {
+        batchWrite[batch] = batchWrite[batch - 1] + destinationBatchSizes[batch - 1];
+    }
+
+    destination.resize(triangles.size());
+    for (size_t t = 0; t < triangleBatch.size(); t++)
+    {
+        uint32_t write = batchWrite[triangleBatch[t]];
+        destination[write] = triangles[t * 3];
+        destination[write + 1] = triangles[t * 3 + 1];
+        destination[write + 2] = triangles[t * 3 + 2];
+        batchWrite[triangleBatch[t]] += 3;
+    }
+
+    return (float) std::sqrt(resultError);
+}
+
+/*************************** LOD CHAIN ***************************/
+
+void uam::buildLodChain(MeshBuildData &data, uint32_t maxLods)
+{
+    data.lodCount = 1;
+    data.lodErrors.assign(1, 0.0f);
+    if (data.vertices.empty() || maxLods <= 1) return;
+
+    float minimum[3] = { data.vertices[0].x, data.vertices[0].y, data.vertices[0].z };
+    float maximum[3] = { minimum[0], minimum[1], minimum[2] };
+    for (const CompleteVertex &vertex : data.vertices)
+    {
+        minimum[0] = std::min(minimum[0], vertex.x); maximum[0] = std::max(maximum[0], vertex.x);
+        minimum[1] = std::min(minimum[1], vertex.y); maximum[1] = std::max(maximum[1], vertex.y);
+        minimum[2] = std::min(minimum[2], vertex.z); maximum[2] = std::max(maximum[2], vertex.z);
+    }
+    float extent = std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+
+    std::vector<GLuint> previous(data.indices);
+    std::vector<uint32_t> previousBatchSizes(data.materialBatchSizes);
+
+    // Each LOD is simplified from the last, so errors add up
+    while (data.lodCount < maxLods)
+    {
+        size_t target = (size_t) (previous.size() / 3 * LOD_TRIANGLE_RATIO) * 3;
+
+        std::vector<GLuint> lod;
+        std::vector<uint32_t> lodBatchSizes;
+        float error = simplifyBatches(data.vertices, previous, previousBatchSizes, target,
+            extent * LOD_MAX_RELATIVE_ERROR, lod, lodBatchSizes);
+
+        if (lod.size() > previous.size() * LOD_MIN_REDUCTION) break;
+
+        optimizeVertexCacheBatches(lod, lodBatchSizes, data.vertices.size());
+
+        data.indices.insert(data.indices.end(), lod.begin(), lod.end());
+        data.materialBatchSizes.insert(data.materialBatchSizes.end(), lodBatchSizes.begin(), lodBatchSizes.end());
+        data.lodErrors.push_back(data.lodErrors.back() + error);
+        data.lodCount++;
+
+        previous.swap(lod);
+        previousBatchSizes.swap(lodBatchSizes);
+    }
+}
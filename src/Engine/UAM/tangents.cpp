@@ -0,0 +1,293 @@
+#include <cmath>
+#include <algorithm>
+
+#include "../../Common/cpu.hpp"
+#include "../jobs.hpp"
+#include "meshopt.hpp"
+
+using namespace uam;
+
+#define TANGENT_GRAIN_SIZE 8192
+
+// Per triangle, computed once and shared by all three corners
+struct FaceFrame
+{
+    float normal[3];    // unit
+    float tangent[3];   // along +u, unnormalized
+    float bitangent[3]; // along +v, unnormalized
+    float angle[3];     // at each corner, weights the normal
+    bool mirrored;      // UVs wound the other way
+};
+
+/*************************** FACE FRAMES ***************************/
+
+#ifdef COMMON_CPU_X86
+
+static __m128 loadPosition(const CompleteVertex &vertex)
+{
+    return _mm_set_ps(0.0f, vertex.z, vertex.y, vertex.x);
+}
+
+static __m128 cross(__m128 a, __m128 b)
+{
+    // (a.yzx * b.zxy) - (a.zxy * b.yzx)
+    __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 result = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+    return _mm_shuffle_ps(result, result, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static float dot(__m128 a, __m128 b)
+{
+    __m128 product = _mm_mul_ps(a, b);
+    __m128 shuffled = _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sum = _mm_add_ps(product, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sum);
+    return _mm_cvtss_f32(_mm_add_ss(sum, shuffled));
+}
+
+static void store3(float *out, __m128 value)
+{
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, value);
+    out[0] = lanes[0];
+    out[1] = lanes[1];
+    out[2] = lanes[2];
+}
+
+static float cornerAngle(__m128 toB, __m128 toC)
+{
+    float lengths = std::sqrt(dot(toB, toB) * dot(toC, toC));
+    if (lengths <= 0.0f) return 0.0f;
+    return std::acos(std::max(-1.0f, std::min(1.0f, dot(toB, toC) / lengths)));
+}
+
+static void computeFaceFrame(const CompleteVertex &v0, const CompleteVertex &v1, const CompleteVertex &v2, FaceFrame &frame)
+{
+    __m128 p0 = loadPosition(v0);
+    __m128 p1 = loadPosition(v1);
+    __m128 p2 = loadPosition(v2);
+
+    __m128 edge1 = _mm_sub_ps(p1, p0);
+    __m128 edge2 = _mm_sub_ps(p2, p0);
+    __m128 edge3 = _mm_sub_ps(p2, p1);
+
+    __m128 normal = cross(edge1, edge2);
+    float length = std::sqrt(dot(normal, normal));
+    normal = length > 0.0f ? _mm_div_ps(normal, _mm_set1_ps(length)) : _mm_setzero_ps();
+    store3(frame.normal, normal);
+
+    frame.angle[0] = cornerAngle(edge1, edge2);
+    frame.angle[1] = cornerAngle(_mm_sub_ps(_mm_setzero_ps(), edge1), edge3);
+    frame.angle[2] = cornerAngle(_mm_sub_ps(_mm_setzero_ps(), edge2), _mm_sub_ps(_mm_setzero_ps(), edge3));
+
+    float du1 = v1.u - v0.u, dv1 = v1.v - v0.v;
+    float du2 = v2.u - v0.u, dv2 = v2.v - v0.v;
+    float area = du1 * dv2 - du2 * dv1;
+    frame.mirrored = area < 0.0f;
+
+    // Only the direction matters, so skip dividing by the UV area
+    __m128 sign = _mm_set1_ps(frame.mirrored ? -1.0f : 1.0f);
+    __m128 tangent = _mm_sub_ps(_mm_mul_ps(edge1, _mm_set1_ps(dv2)), _mm_mul_ps(edge2, _mm_set1_ps(dv1)));
+    __m128 bitangent = _mm_sub_ps(_mm_mul_ps(edge2, _mm_set1_ps(du1)), _mm_mul_ps(edge1, _mm_set1_ps(du2)));
+    store3(frame.tangent, _mm_mul_ps(tangent, sign));
+    store3(frame.bitangent, _mm_mul_ps(bitangent, sign));
+}
+
+#else
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+static Vec3 sub(const Vec3 &a, const Vec3 &b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static float dot(const Vec3 &a, const Vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static Vec3 cross(const Vec3 &a, const Vec3 &b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static float cornerAngle(const Vec3 &toB, const Vec3 &toC)
+{
+    float lengths = std::sqrt(dot(toB, toB) * dot(toC, toC));
+    if (lengths <= 0.0f) return 0.0f;
+    return std::acos(std::max(-1.0f, std::min(1.0f, dot(toB, toC) / lengths)));
+}
+
+static void computeFaceFrame(const CompleteVertex &v0, const CompleteVertex &v1, const CompleteVertex &v2, FaceFrame &frame)
+{
+    Vec3 p0 = { v0.x, v0.y, v0.z }, p1 = { v1.x, v1.y, v1.z }, p2 = { v2.x, v2.y, v2.z };
+    Vec3 edge1 = sub(p1, p0), edge2 = sub(p2, p0), edge3 = sub(p2, p1);
+
+    Vec3 normal = cross(edge1, edge2);
+    float length = std::sqrt(dot(normal, normal));
+    if (length <= 0.0f) length = INFINITY;
+    frame.normal[0] = normal.x / length;
+    frame.normal[1] = normal.y / length;
+    frame.normal[2] = normal.z / length;
+
+    Vec3 zero = { 0.0f, 0.0f, 0.0f };
+    frame.angle[0] = cornerAngle(edge1, edge2);
+    frame.angle[1] = cornerAngle(sub(zero, edge1), edge3);
+    frame.angle[2] = cornerAngle(sub(zero, edge2), sub(zero, edge3));
+
+    float du1 = v1.u - v0.u, dv1 = v1.v - v0.v;
+    float du2 = v2.u - v0.u, dv2 = v2.v - v0.v;
+    float area = du1 * dv2 - du2 * dv1;
+    frame.mirrored = area < 0.0f;
+
+    float sign = frame.mirrored ? -1.0f : 1.0f;
+    frame.tangent[0] = (edge1.x * dv2 - edge2.x * dv1) * sign;
+    frame.tangent[1] = (edge1.y * dv2 - edge2.y * dv1) * sign;
+    frame.tangent[2] = (edge1.z * dv2 - edge2.z * dv1) * sign;
+    frame.bitangent[0] = (edge2.x * du1 - edge1.x * du2) * sign;
+    frame.bitangent[1] = (edge2.y * du1 - edge1.y * du2) * sign;
+    frame.bitangent[2] = (edge2.z * du1 - edge1.z * du2) * sign;
+}
+
+#endif
+
+/*************************** CORNERS ***************************/
+
+static void normalize3(float *v, const float *fallback)
+{
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length <= 1e-20f)
+    {
+        v[0] = fallback[0];
+        v[1] = fallback[1];
+        v[2] = fallback[2];
+        return;
+    }
+
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+}
+
+void uam::generateTangentFrames(const std::vector<PSK_Wedge> &wedges, std::vector<CompleteVertex> &vertices,
+    std::vector<GLuint> &indices, const std::vector<int32_t> &smoothingGroups)
+{
+    size_t triangleCount = indices.size() / 3;
+    JobSystem &jobs = JobSystem::Get();
+
+    std::vector<FaceFrame> frames(triangleCount);
+    jobs.ParallelFor(0, triangleCount, TANGENT_GRAIN_SIZE, [&](size_t begin, size_t end)
+    {
+        for (size_t t = begin; t < end; t++)
+        {
+            computeFaceFrame(vertices[indices[t * 3]], vertices[indices[t * 3 + 1]], vertices[indices[t * 3 + 2]], frames[t]);
+        }
+    });
+
+    // Exporters that don't write smoothing groups leave them all 0,
+    // which taken literally would facet the whole mesh
+    bool anyGroups = std::any_of(smoothingGroups.begin(), smoothingGroups.end(), [](int32_t groups) { return groups != 0; });
+    auto smoothTogether = [&](size_t a, size_t b)
+    {
+        return a == b || !anyGroups || (smoothingGroups[a] & smoothingGroups[b]) != 0;
+    };
+
+    // Corners around each point, by point rather than wedge so
+    // normals stay smooth across UV seams
+    uint32_t pointCount = 0;
+    for (const PSK_Wedge &wedge : wedges) pointCount = std::max(pointCount, wedge.pointIndex + 1);
+
+    std::vector<uint32_t> cornerOffset(pointCount + 1, 0);
+    for (GLuint index : indices) cornerOffset[wedges[index].pointIndex + 1]++;
+    for (uint32_t p = 0; p < pointCount; p++) cornerOffset[p + 1] += cornerOffset[p];
+
+    std::vector<uint32_t> corners(indices.size());
+    std::vector<uint32_t> fill(cornerOffset.begin(), cornerOffset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        corners[fill[wedges[indices[i]].pointIndex]++] = (uint32_t) i;
+    }
+
+    // One output vertex per corner, welding merges the identical ones back.
+    // Every corner walks its neighbours in the same order, so corners that
+    // should share a vertex come out bit identical.
+    std::vector<CompleteVertex> expanded(indices.size());
+    jobs.ParallelFor(0, triangleCount, TANGENT_GRAIN_SIZE, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin * 3; i < end * 3; i++)
+        {
+            size_t face = i / 3;
+            GLuint wedge = indices[i];
+            uint32_t point = wedges[wedge].pointIndex;
+            const FaceFrame &frame = frames[face];
+
+            float normal[3] = { 0.0f, 0.0f, 0.0f };
+            float tangent[3] = { 0.0f, 0.0f, 0.0f };
+            float bitangent[3] = { 0.0f, 0.0f, 0.0f };
+
+            for (uint32_t c = cornerOffset[point]; c < cornerOffset[point + 1]; c++)
+            {
+                uint32_t other = corners[c];
+                size_t otherFace = other / 3;
+                if (!smoothTogether(face, otherFace)) continue;
+
+                const FaceFrame &otherFrame = frames[otherFace];
+                float weight = otherFrame.angle[other % 3];
+                normal[0] += otherFrame.normal[0] * weight;
+                normal[1] += otherFrame.normal[1] * weight;
+                normal[2] += otherFrame.normal[2] * weight;
+
+                // Tangents split at UV seams and where the UVs mirror
+                if (indices[other] != wedge || otherFrame.mirrored != frame.mirrored) continue;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    tangent[k] += otherFrame.tangent[k] * weight;
+                    bitangent[k] += otherFrame.bitangent[k] * weight;
+                }
+            }
+
+            normalize3(normal, frame.normal);
+
+            // Gram-Schmidt against the normal, then handedness from the bitangent
+            float along = normal[0] * tangent[0] + normal[1] * tangent[1] + normal[2] * tangent[2];
+            tangent[0] -= normal[0] * along;
+            tangent[1] -= normal[1] * along;
+            tangent[2] -= normal[2] * along;
+
+            // Any perpendicular will do for faces without usable UVs
+            float perpendicular[3];
+            if (std::fabs(normal[0]) < 0.9f)
+            {
+                perpendicular[0] = 0.0f; perpendicular[1] = normal[2]; perpendicular[2] = -normal[1];
+            }
+            else
+            {
+                perpendicular[0] = -normal[2]; perpendicular[1] = 0.0f; perpendicular[2] = normal[0];
+            }
+            normalize3(perpendicular, perpendicular);
+            normalize3(tangent, perpendicular);
+
+            float crossed[3] =
+            {
+                normal[1] * tangent[2] - normal[2] * tangent[1],
+                normal[2] * tangent[0] - normal[0] * tangent[2],
+                normal[0] * tangent[1] - normal[1] * tangent[0]
+            };
+            float handedness = crossed[0] * bitangent[0] + crossed[1] * bitangent[1] + crossed[2] * bitangent[2];
+
+            CompleteVertex &vertex = expanded[i];
+            vertex = vertices[wedge];
+            vertex.nx = normal[0];
+            vertex.ny = normal[1];
+            vertex.nz = normal[2];
+            vertex.tx = tangent[0];
+            vertex.ty = tangent[1];
+            vertex.tz = tangent[2];
+            vertex.tw = handedness < 0.0f ? -1.0f : 1.0f;
+        }
+    });
+
+    vertices.swap(expanded);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        indices[i] = (GLuint) i;
+    }
+}
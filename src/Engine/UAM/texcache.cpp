@@ -0,0 +1,347 @@
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+#include "../../Common/settings.hpp"
+#include "../jobs.hpp"
+#include "texcache.hpp"
+#include "material.hpp"
+
+using namespace uam;
+
+// Mips start 16 byte aligned, same as the cooked mesh sections
+#define COOKED_IMAGE_ALIGN 16
+
+// Roughly how many pixels or blocks each job gets while cooking
+#define COOK_BAND_PIXELS (64 * 1024)
+#define COOK_BAND_BLOCKS 1024
+
+static uint64_t alignMip(uint64_t offset)
+{
+    return (offset + COOKED_IMAGE_ALIGN - 1) & ~(uint64_t) (COOKED_IMAGE_ALIGN - 1);
+}
+
+TextureUsage uam::textureUsageForRole(const std::string &role)
+{
+    if (role == "Normal") return TextureUsage::Normal;
+    if (role == "SpecPower") return TextureUsage::Mask;
+    return TextureUsage::Color;
+}
+
+std::string uam::cookedImagePath(const std::string &texPath)
+{
+    return std::filesystem::path(texPath).replace_extension(".ctex").generic_string();
+}
+
+// What the current settings cook at, kept in the header to spot a change
+static common::BlockQuality cookQuality()
+{
+    return (common::BlockQuality) std::min(common::settings::TEXTURE_COOK_QUALITY, (unsigned) common::BlockQuality::High);
+}
+
+static bool cookColorBC7(TextureUsage usage)
+{
+    return usage == TextureUsage::Color && common::settings::COLOR_TEXTURES_BC7;
+}
+
+bool uam::isCookedImageFresh(const std::string &texPath, TextureUsage usage)
+{
+    std::error_code error;
+    std::filesystem::path cookedPath = cookedImagePath(texPath);
+
+    if (!std::filesystem::exists(cookedPath, error)) return false;
+
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, error);
+    if (error) return false;
+
+    auto sourceTime = std::filesystem::last_write_time(texPath, error);
+    if (error || cookedTime < sourceTime) return false;
+
+    // Also catches an older version, another role, other settings or a corrupt file
+    CookedImage cooked;
+    return cooked.open(cookedPath.generic_string(), usage);
+}
+
+/*************************** MIP CHAIN ***************************/
+
+// 2x2 box filter, odd edges reuse the last row/column.
+// Normal maps get every texel renormalized so mips don't flatten out.
+static void downsampleRows(const uint8_t *source, int sourceWidth, int sourceHeight, uint8_t *destination,
+    int destinationWidth, size_t firstRow, size_t lastRow, bool renormalize)
+{
+    for (size_t y = firstRow; y < lastRow; y++)
+    {
+        const uint8_t *row0 = source + (size_t) std::min((int) y * 2, sourceHeight - 1) * sourceWidth * 4;
+        const uint8_t *row1 = source + (size_t) std::min((int) y * 2 + 1, sourceHeight - 1) * sourceWidth * 4;
+        uint8_t *out = destination + y * destinationWidth * 4;
+
+        for (int x = 0; x < destinationWidth; x++, out += 4)
+        {
+            int x0 = std::min(x * 2, sourceWidth - 1) * 4;
+            int x1 = std::min(x * 2 + 1, sourceWidth - 1) * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                out[c] = (uint8_t) ((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+
+            if (renormalize)
+            {
+                float nx = out[0] / 127.5f - 1.0f;
+                float ny = out[1] / 127.5f - 1.0f;
+                float nz = out[2] / 127.5f - 1.0f;
+                float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+                if (length < 1e-4f) continue;
+
+                out[0] = (uint8_t) std::lround((nx / length * 0.5f + 0.5f) * 255.0f);
+                out[1] = (uint8_t) std::lround((ny / length * 0.5f + 0.5f) * 255.0f);
+                out[2] = (uint8_t) std::lround((nz / length * 0.5f + 0.5f) * 255.0f);
+            }
+        }
+    }
+}
+
+static common::BlockFormat blockFormatFor(TextureUsage usage, const uint8_t *rgba, size_t pixelCount)
+{
+    if (usage == TextureUsage::Normal) return common::BlockFormat::BC5;
+    if (usage == TextureUsage::Mask) return common::BlockFormat::BC4;
+    if (common::settings::COLOR_TEXTURES_BC7) return common::BlockFormat::BC7;
+
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        if (rgba[i * 4 + 3] != 255) return common::BlockFormat::BC3;
+    }
+    return common::BlockFormat::BC1;
+}
+
+/*************************** WRITING ***************************/
+
+static void writeAt(std::ofstream &file, uint64_t offset, const void *data, size_t size)
+{
+    // Pad up to the mip start
+    static const char zeros[COOKED_IMAGE_ALIGN] = {};
+    uint64_t position = (uint64_t) file.tellp();
+    if (position < offset) file.write(zeros, (std::streamsize) (offset - position));
+
+    if (size) file.write((const char *) data, (std::streamsize) size);
+}
+
+bool uam::cookImage(const std::string &texPath, TextureUsage usage)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    TextureImage image;
+    if (!image.Load(texPath, 4))
+    {
+        std::cout << "Failed to load texture: " << texPath << std::endl;
+        return false;
+    }
+
+    JobSystem &jobs = JobSystem::Get();
+    common::BlockFormat format = blockFormatFor(usage, image.pixels, (size_t) image.width * image.height);
+    common::BlockQuality quality = cookQuality();
+
+    // levels[0] stays empty, mip 0 is read straight from the decoded image
+    std::vector<CookedImageMip> mips;
+    std::vector<std::vector<uint8_t>> levels;
+    mips.push_back({ (uint32_t) image.width, (uint32_t) image.height, 0, 0 });
+    levels.emplace_back();
+
+    const uint8_t *previous = image.pixels;
+    while (mips.back().width > 1 || mips.back().height > 1)
+    {
+        const CookedImageMip &source = mips.back();
+        CookedImageMip mip = { std::max(source.width / 2, 1u), std::max(source.height / 2, 1u), 0, 0 };
+
+        std::vector<uint8_t> level((size_t) mip.width * mip.height * 4);
+        size_t bandRows = std::max((size_t) 1, (size_t) COOK_BAND_PIXELS / mip.width);
+        jobs.ParallelFor(0, mip.height, bandRows, [&](size_t begin, size_t end)
+        {
+            downsampleRows(previous, (int) source.width, (int) source.height, level.data(), (int) mip.width,
+                begin, end, usage == TextureUsage::Normal);
+        });
+
+        mips.push_back(mip);
+        levels.push_back(std::move(level));
+        previous = levels.back().data();
+    }
+
+    // Every mip compresses into its own slice of one buffer
+    uint64_t offset = alignMip(sizeof(CookedImageHeader) + mips.size() * sizeof(CookedImageMip));
+    for (CookedImageMip &mip : mips)
+    {
+        mip.offset = offset;
+        mip.size = common::compressedSize(format, (int) mip.width, (int) mip.height);
+        offset = alignMip(offset + mip.size);
+    }
+
+    uint64_t dataStart = mips[0].offset;
+    std::vector<uint8_t> blocks(offset - dataStart);
+    for (size_t i = 0; i < mips.size(); i++)
+    {
+        const CookedImageMip &mip = mips[i];
+        const uint8_t *pixels = i == 0 ? image.pixels : levels[i].data();
+        uint8_t *out = blocks.data() + (mip.offset - dataStart);
+
+        int blocksWide = ((int) mip.width + 3) / 4;
+        int blocksHigh = ((int) mip.height + 3) / 4;
+        size_t bandRows = std::max((size_t) 1, (size_t) (COOK_BAND_BLOCKS / blocksWide));
+        jobs.ParallelFor(0, blocksHigh, bandRows, [&](size_t begin, size_t end)
+        {
+            common::compressBlocks(format, quality, pixels, (int) mip.width, (int) mip.height, out, (int) begin, (int) (end - begin));
+        });
+    }
+
+    CookedImageHeader header = {};
+    header.magic = COOKED_IMAGE_MAGIC;
+    header.version = COOKED_IMAGE_VERSION;
+    header.format = (uint32_t) format;
+    header.usage = (uint32_t) usage;
+    header.width = (uint32_t) image.width;
+    header.height = (uint32_t) image.height;
+    header.mipCount = (uint32_t) mips.size();
+    header.quality = (uint32_t) quality;
+    header.colorBC7 = cookColorBC7(usage) ? 1 : 0;
+
+    // Meshes loading side by side can cook the same texture at once,
+    // so each writer gets its own temporary file
+    std::string cookedPath = cookedImagePath(texPath);
+    std::string tempPath = cookedPath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "Failed to create cooked texture: " << cookedPath << "\n";
+        return false;
+    }
+
+    writeAt(file, 0, &header, sizeof(header));
+    writeAt(file, sizeof(header), mips.data(), mips.size() * sizeof(CookedImageMip));
+    writeAt(file, dataStart, blocks.data(), blocks.size());
+
+    file.close();
+    if (!file)
+    {
+        std::cout << "Failed to write cooked texture: " << cookedPath << "\n";
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cookedPath, error);
+    if (error)
+    {
+        std::cout << "Failed to write cooked texture: " << cookedPath << " (" << error.message() << ")\n";
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Cooked texture \"" << cookedPath << "\": " << image.width << "x" << image.height << ", "
+        << mips.size() << " mips, BC" << (uint32_t) format << ", " << (size_t) image.width * image.height * 4
+        << " -> " << blocks.size() << " bytes in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+
+    return true;
+}
+
+/*************************** READING ***************************/
+
+CookedImage::CookedImage(CookedImage &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+CookedImage &CookedImage::operator=(CookedImage &&other) noexcept
+{
+    if (this == &other) return *this;
+
+    file = std::move(other.file);
+    header = other.header;
+    other.header = nullptr;
+    return *this;
+}
+
+bool CookedImage::open(const std::string &cookedPath, TextureUsage usage)
+{
+    header = nullptr;
+
+    if (!file.open(cookedPath)) return false;
+    if (file.size() < sizeof(CookedImageHeader)) return false;
+
+    const CookedImageHeader *candidate = (const CookedImageHeader *) file.data();
+    if (candidate->magic != COOKED_IMAGE_MAGIC || candidate->version != COOKED_IMAGE_VERSION)
+    {
+        std::cout << "Cooked texture is out of date: " << cookedPath << "\n";
+        return false;
+    }
+
+    if (candidate->usage != (uint32_t) usage)
+    {
+        std::cout << "Cooked texture was cooked for another role: " << cookedPath << "\n";
+        return false;
+    }
+
+    if (candidate->quality != (uint32_t) cookQuality() || candidate->colorBC7 != (cookColorBC7(usage) ? 1u : 0u))
+    {
+        std::cout << "Cooked texture was cooked with other settings: " << cookedPath << "\n";
+        return false;
+    }
+
+    common::BlockFormat format = (common::BlockFormat) candidate->format;
+    bool knownFormat = format == common::BlockFormat::BC1 || format == common::BlockFormat::BC3
+        || format == common::BlockFormat::BC4 || format == common::BlockFormat::BC5
+        || format == common::BlockFormat::BC7;
+
+    // cookImage always writes the full chain down to 1x1
+    uint32_t chainLength = 1;
+    for (uint32_t size = std::max(candidate->width, candidate->height); size > 1; size /= 2) chainLength++;
+
+    if (!knownFormat || candidate->width == 0 || candidate->height == 0 || candidate->mipCount != chainLength
+        || sizeof(CookedImageHeader) + candidate->mipCount * sizeof(CookedImageMip) > file.size())
+    {
+        std::cout << "Cooked texture is corrupt: " << cookedPath << "\n";
+        return false;
+    }
+
+    // Each mip halves the one before, starts past the mip table and its
+    // predecessor's blocks and ends inside the file
+    const CookedImageMip *mips = (const CookedImageMip *) (file.data() + sizeof(CookedImageHeader));
+    uint64_t dataEnd = sizeof(CookedImageHeader) + candidate->mipCount * sizeof(CookedImageMip);
+    for (uint32_t i = 0; i < candidate->mipCount; i++)
+    {
+        uint32_t width = i == 0 ? candidate->width : std::max(mips[i - 1].width / 2, 1u);
+        uint32_t height = i == 0 ? candidate->height : std::max(mips[i - 1].height / 2, 1u);
+
+        if (mips[i].width != width || mips[i].height != height
+            || mips[i].offset < dataEnd || mips[i].offset > file.size() || mips[i].size > file.size() - mips[i].offset
+            || mips[i].size != common::compressedSize(format, (int) width, (int) height))
+        {
+            std::cout << "Cooked texture is corrupt: " << cookedPath << "\n";
+            return false;
+        }
+
+        dataEnd = mips[i].offset + mips[i].size;
+    }
+
+    header = candidate;
+    return true;
+}
+
+void CookedImage::close()
+{
+    header = nullptr;
+    file.close();
+}
+
+const CookedImageMip &CookedImage::mip(uint32_t level) const
+{
+    return ((const CookedImageMip *) (file.data() + sizeof(CookedImageHeader)))[level];
+}
+
+const uint8_t *CookedImage::mipData(uint32_t level) const
+{
+    return (const uint8_t *) file.data() + mip(level).offset;
+}
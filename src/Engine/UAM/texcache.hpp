@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "../../Common/bcn.hpp"
+#include "../../Common/mappedfile.hpp"
+
+namespace uam
+{
+    // Cooked textures (.ctex) sit next to their source image and hold the
+    // full mip chain, already block compressed, so loading is a mapping and
+    // one glCompressedTexSubImage2D per mip straight from it.
+    //
+    // [CookedImageHeader]
+    // [CookedImageMip * mipCount]
+    // [uint8_t * size] per mip, largest first, each 16 byte aligned
+
+#define COOKED_IMAGE_MAGIC 0x58455443 // "CTEX"
+#define COOKED_IMAGE_VERSION 2
+
+    // Decides the block format, every material role maps to one of these
+    enum class TextureUsage : uint32_t
+    {
+        Color,  // BC1, or BC3 if anything isn't opaque, BC7 if COLOR_TEXTURES_BC7
+        Normal, // BC5, blue is rebuilt in the shader
+        Mask    // BC4, red only
+    };
+
+    TextureUsage textureUsageForRole(const std::string &role);
+
+    struct CookedImageHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+
+        uint32_t format; // common::BlockFormat
+        uint32_t usage;  // TextureUsage
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipCount;
+        uint32_t quality;  // common::BlockQuality
+        uint32_t colorBC7; // COLOR_TEXTURES_BC7, only ever set for Color
+        uint32_t padding;
+    };
+
+    struct CookedImageMip
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    class CookedImage
+    {
+        common::MappedFile file;
+        const CookedImageHeader *header = nullptr;
+
+    public:
+        CookedImage() = default;
+        CookedImage(CookedImage &&other) noexcept;
+        CookedImage &operator=(CookedImage &&other) noexcept;
+
+        // Maps the file and validates every mip against its size.
+        // Fails if the file was cooked for a different usage or with
+        // another TEXTURE_COOK_QUALITY or COLOR_TEXTURES_BC7.
+        bool open(const std::string &cookedPath, TextureUsage usage);
+        void close();
+
+        bool isOpen() const { return header != nullptr; }
+        common::BlockFormat format() const { return (common::BlockFormat) header->format; }
+        uint32_t width() const { return header->width; }
+        uint32_t height() const { return header->height; }
+        uint32_t mipCount() const { return header->mipCount; }
+
+        const CookedImageMip &mip(uint32_t level) const;
+
+        // Blocks of a mip, in place inside the mapping
+        const uint8_t *mipData(uint32_t level) const;
+    };
+
+    // Where the cooked file for a texture lives
+    std::string cookedImagePath(const std::string &texPath);
+
+    // True if the cooked file is at least as new as the texture and opens
+    // for usage with the current settings, anything else wants a recook
+    bool isCookedImageFresh(const std::string &texPath, TextureUsage usage);
+
+    // Decodes the texture, builds its mip chain and compresses every mip,
+    // all of it spread over the job system, then writes the cooked file
+    bool cookImage(const std::string &texPath, TextureUsage usage);
+}
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <algorithm>
+
+#include "../../Common/settings.hpp"
+#include "texpool.hpp"
+
+using namespace uam;
+
+bool TexturePool::BucketKey::operator<(const BucketKey &other) const
+{
+    if (internalFormat != other.internalFormat) return internalFormat < other.internalFormat;
+    if (width != other.width) return width < other.width;
+    if (height != other.height) return height < other.height;
+    return levels < other.levels;
+}
+
+TexturePool &TexturePool::Get()
+{
+    static TexturePool pool;
+    return pool;
+}
+
+TexturePool::Page TexturePool::createPage(const BucketKey &key, size_t layerBytes, size_t pageIndex)
+{
+    if (maxLayers == 0) glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    // Doubles with every page the bucket already has, as long as it fits the array budget.
+    // At least one so oversized textures still get a home.
+    size_t budget = (size_t) common::settings::TEXTURE_POOL_ARRAY_MB * 1024 * 1024;
+    size_t layerCount = (size_t) 1 << std::min(pageIndex, (size_t) 16);
+    if (layerBytes) layerCount = std::min(layerCount, budget / layerBytes);
+    layerCount = std::min(layerCount, (size_t) common::settings::TEXTURE_POOL_LAYERS);
+    layerCount = std::max((size_t) 1, std::min(layerCount, (size_t) std::max(maxLayers, 1)));
+
+    Page page;
+    page.layerCount = (uint32_t) layerCount;
+
+    glGenTextures(1, &page.array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, page.array);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, key.levels, key.internalFormat, key.width, key.height, page.layerCount);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Whatever unit was active lost its array
+    ResetBindings();
+
+    // Lowest layer first
+    for (uint32_t layer = page.layerCount; layer > 0; layer--) page.freeLayers.push_back(layer - 1);
+
+    std::cout << "Texture pool: new " << key.width << "x" << key.height << " array of " << page.layerCount
+        << " layers (" << layerBytes * page.layerCount / (1024 * 1024) << " MB)\n";
+    return page;
+}
+
+TextureHandle TexturePool::Allocate(GLenum internalFormat, int width, int height, uint32_t levels, size_t layerBytes)
+{
+    std::vector<Page> &pages = buckets[{ internalFormat, width, height, levels }];
+
+    Page *page = nullptr;
+    for (Page &candidate : pages)
+    {
+        if (!candidate.freeLayers.empty())
+        {
+            page = &candidate;
+            break;
+        }
+    }
+
+    if (!page)
+    {
+        pages.push_back(createPage({ internalFormat, width, height, levels }, layerBytes, pages.size()));
+        page = &pages.back();
+    }
+
+    TextureHandle handle;
+    handle.array = page->array;
+    handle.layer = page->freeLayers.back();
+    page->freeLayers.pop_back();
+    return handle;
+}
+
+void TexturePool::Free(TextureHandle handle)
+{
+    if (!handle.IsValid()) return;
+
+    for (auto bucket = buckets.begin(); bucket != buckets.end(); ++bucket)
+    {
+        std::vector<Page> &pages = bucket->second;
+        for (auto page = pages.begin(); page != pages.end(); ++page)
+        {
+            if (page->array != handle.array) continue;
+
+            page->freeLayers.push_back(handle.layer);
+            if (page->freeLayers.size() < page->layerCount) return;
+
+            // Deleting unbinds it everywhere, the name may come back for another array
+            for (GLuint &unit : bound)
+            {
+                if (unit == page->array) unit = 0;
+            }
+
+            glDeleteTextures(1, &page->array);
+            pages.erase(page);
+            if (pages.empty()) buckets.erase(bucket);
+            return;
+        }
+    }
+
+    std::cout << "Warning! Attempt to free a texture layer the pool doesn't own\n";
+}
+
+void TexturePool::Bind(GLuint unit, GLuint array)
+{
+    if (unit < 16 && bound[unit] == array && array != 0) return;
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+    if (unit < 16) bound[unit] = array;
+}
+
+void TexturePool::ResetBindings()
+{
+    std::fill(std::begin(bound), std::end(bound), 0);
+}
+
+size_t TexturePool::ArrayCount() const
+{
+    size_t count = 0;
+    for (const auto &bucket : buckets) count += bucket.second.size();
+    return count;
+}
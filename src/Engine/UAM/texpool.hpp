@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include <GL/glew.h>
+
+namespace uam
+{
+    // A layer of one of the pool's arrays, array 0 means no texture
+    struct TextureHandle
+    {
+        GLuint array = 0;
+        uint32_t layer = 0;
+
+        bool IsValid() const { return array != 0; }
+        bool operator==(const TextureHandle &other) const { return array == other.array && layer == other.layer; }
+        bool operator!=(const TextureHandle &other) const { return !(*this == other); }
+    };
+
+    // Shares GL_TEXTURE_2D_ARRAYs between every material's textures.
+    //
+    // Textures are bucketed by format, size and mip count, so a texture always
+    // lands in an array its size matches (1024x1024 BC1, 2048x2048 BC5, ...).
+    // Each bucket is a list of immutable arrays, a new one is added once the
+    // others are full and deleted once its last layer is freed. A bucket's
+    // first array has one layer and each one after doubles, so what's
+    // reserved stays within about twice what's used.
+    // Bind skips units that already hold the array, characters end up
+    // touching a handful of arrays a frame instead of a texture per draw.
+    class TexturePool
+    {
+        struct BucketKey
+        {
+            GLenum internalFormat;
+            int width;
+            int height;
+            uint32_t levels;
+
+            bool operator<(const BucketKey &other) const;
+        };
+
+        struct Page
+        {
+            GLuint array;
+            uint32_t layerCount;
+            std::vector<uint32_t> freeLayers;
+        };
+
+        std::map<BucketKey, std::vector<Page>> buckets;
+
+        // What Bind last put on each unit, 0 if unknown
+        GLuint bound[16] = {};
+
+        GLint maxLayers = 0;
+
+        Page createPage(const BucketKey &key, size_t layerBytes, size_t pageIndex);
+
+    public:
+        TexturePool() = default;
+
+        TexturePool(const TexturePool &) = delete;
+        TexturePool &operator=(const TexturePool &) = delete;
+
+        // GL thread. A layer with storage for levels mips, layerBytes is
+        // the size of one layer's whole chain and caps how many layers the
+        // bucket's next array gets. Contents are undefined until uploaded.
+        TextureHandle Allocate(GLenum internalFormat, int width, int height, uint32_t levels, size_t layerBytes);
+
+        // GL thread. Hands the layer back, deleting its array if it was the last one used
+        void Free(TextureHandle handle);
+
+        // GL thread. Binds array to GL_TEXTURE_2D_ARRAY on unit unless it's already there
+        void Bind(GLuint unit, GLuint array);
+
+        // GL thread. For anything that binds arrays behind the pool's back
+        void ResetBindings();
+
+        size_t ArrayCount() const;
+
+        // Engine wide instance, created on first use
+        static TexturePool &Get();
+    };
+}
@@ -0,0 +1,372 @@
+#include <iostream>
+#include <algorithm>
+
+#include "../../Common/settings.hpp"
+#include "texstream.hpp"
+
+using namespace uam;
+
+// Slices start on this boundary, drivers copy aligned sources fastest
+#define STAGING_ALIGN 256
+
+static GLenum compressedInternalFormat(common::BlockFormat format)
+{
+    switch (format)
+    {
+        case common::BlockFormat::BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case common::BlockFormat::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case common::BlockFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case common::BlockFormat::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        case common::BlockFormat::BC7:
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return GL_NONE;
+}
+
+static GLenum uncompressedInternalFormat(int channelCount)
+{
+    switch (channelCount)
+    {
+        case 1:
+            return GL_R8;
+        case 2:
+            return GL_RG8;
+        case 3:
+            return GL_RGB8;
+        case 4:
+            return GL_RGBA8;
+    }
+    return GL_NONE;
+}
+
+// Uncompressed images keep only the channels their role needs
+static GLenum uncompressedFormat(int channelCount)
+{
+    switch (channelCount)
+    {
+        case 1:
+            return GL_RED;
+        case 2:
+            return GL_RG;
+        case 3:
+            return GL_RGB;
+        case 4:
+            return GL_RGBA;
+    }
+    return GL_NONE;
+}
+
+static uint32_t fullMipCount(int width, int height)
+{
+    uint32_t count = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2) count++;
+    return count;
+}
+
+// Cooked images issue every mip, the rest issue mip 0 and let the driver build the others
+static uint32_t issuedLevelCount(const TextureImage &image)
+{
+    return image.cooked.isOpen() ? image.cooked.mipCount() : 1;
+}
+
+TextureStreamer &TextureStreamer::Get()
+{
+    static TextureStreamer streamer;
+    return streamer;
+}
+
+void TextureStreamer::Init(size_t ringBytes)
+{
+    if (buffer || ringBytes == 0) return;
+
+    if (!GLEW_ARB_buffer_storage)
+    {
+        std::cout << "No ARB_buffer_storage, textures upload from client memory\n";
+        return;
+    }
+
+    // Coherent, so whatever workers write is visible to the GPU without a flush
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringBytes, nullptr, flags);
+    void *pointer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringBytes, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!pointer)
+    {
+        std::cout << "Failed to map the texture staging ring, textures upload from client memory\n";
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(ringMutex);
+    mapped = (uint8_t *) pointer;
+    capacity = ringBytes;
+    head = 0;
+
+    std::cout << "Texture staging ring: " << ringBytes / (1024 * 1024) << " MB\n";
+}
+
+/*************************** RING ***************************/
+
+StagingSlice TextureStreamer::Allocate(size_t bytes)
+{
+    size_t size = (bytes + STAGING_ALIGN - 1) & ~(size_t) (STAGING_ALIGN - 1);
+
+    std::lock_guard<std::mutex> lock(ringMutex);
+    if (!mapped || size == 0 || size > capacity) return StagingSlice();
+
+    // Free space runs from head up to the oldest live block, wrapping
+    // at the end. A slice never wraps, the leftover end is skipped.
+    size_t offset;
+    if (blocks.empty())
+    {
+        offset = 0;
+    }
+    else
+    {
+        size_t tail = blocks.front().offset;
+        if (head > tail)
+        {
+            if (head + size <= capacity) offset = head;
+            else if (size <= tail) offset = 0;
+            else return StagingSlice();
+        }
+        else if (head < tail && head + size <= tail)
+        {
+            offset = head;
+        }
+        else
+        {
+            return StagingSlice();
+        }
+    }
+
+    head = offset + size;
+    blocks.push_back({ offset, size, false });
+
+    StagingSlice slice;
+    slice.data = mapped + offset;
+    slice.offset = offset;
+    slice.size = bytes;
+    return slice;
+}
+
+void TextureStreamer::Release(const StagingSlice &slice)
+{
+    if (!slice.IsValid()) return;
+
+    std::lock_guard<std::mutex> lock(ringMutex);
+    for (RingBlock &block : blocks)
+    {
+        if (block.offset == slice.offset && !block.released)
+        {
+            block.released = true;
+            break;
+        }
+    }
+
+    // Slices come back in any order, the tail only moves past the oldest ones
+    while (!blocks.empty() && blocks.front().released) blocks.pop_front();
+    if (blocks.empty()) head = 0;
+}
+
+void TextureStreamer::retire()
+{
+    // Fences signal in the order they went in
+    while (!inFlight.empty())
+    {
+        InFlight &oldest = inFlight.front();
+        GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) break;
+
+        glDeleteSync(oldest.fence);
+        for (const StagingSlice &slice : oldest.slices) Release(slice);
+        inFlight.pop_front();
+    }
+}
+
+/*************************** UPLOADS ***************************/
+
+TextureHandle TextureStreamer::CreateTexture(const std::string &texPath, TextureImage &&image)
+{
+    TexturePool &pool = TexturePool::Get();
+
+    TextureHandle texture;
+    if (image.cooked.isOpen())
+    {
+        const CookedImageMip &last = image.cooked.mip(image.cooked.mipCount() - 1);
+        size_t chainBytes = (size_t) (last.offset + last.size - image.cooked.mip(0).offset);
+
+        texture = pool.Allocate(compressedInternalFormat(image.cooked.format()), image.width, image.height,
+            image.cooked.mipCount(), chainBytes);
+    }
+    else
+    {
+        GLenum internalFormat = uncompressedInternalFormat(image.channelCount);
+        if (internalFormat == GL_NONE)
+        {
+            std::cout << "Unsupported number of channels(" << image.channelCount << ")" <<  "in texture file " << texPath;
+            image.Free();
+            return TextureHandle();
+        }
+
+        // Mips add about a third
+        size_t levelBytes = (size_t) image.width * image.height * image.channelCount;
+        texture = pool.Allocate(internalFormat, image.width, image.height, fullMipCount(image.width, image.height),
+            levelBytes + levelBytes / 3);
+    }
+
+    Upload upload;
+    upload.texture = texture;
+    upload.image = std::move(image);
+    queue.push_back(std::move(upload));
+    return texture;
+}
+
+void TextureStreamer::Cancel(TextureHandle texture)
+{
+    for (auto upload = queue.begin(); upload != queue.end(); ++upload)
+    {
+        if (upload->texture != texture) continue;
+
+        // Mips already issued may still be reading the slice,
+        // the rest of it was never touched and goes back with the image
+        if (upload->nextLevel > 0 && upload->image.staging.IsValid())
+        {
+            inFlight.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), { upload->image.TakeStaging() } });
+        }
+        queue.erase(upload);
+        return;
+    }
+}
+
+// glGenerateMipmap on the array would rebuild every layer, a view of just this one keeps it to the new pixels
+static void generateLayerMipmaps(TextureHandle texture, const TextureImage &image)
+{
+    if (!GLEW_ARB_texture_view)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        return;
+    }
+
+    GLuint view;
+    glGenTextures(1, &view);
+    glTextureView(view, GL_TEXTURE_2D, texture.array, uncompressedInternalFormat(image.channelCount),
+        0, fullMipCount(image.width, image.height), texture.layer, 1);
+
+    glBindTexture(GL_TEXTURE_2D, view);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &view);
+}
+
+// Sources are offsets into the ring when staged, client pointers otherwise.
+// Returns the bytes the call read.
+size_t TextureStreamer::issueLevel(Upload &upload)
+{
+    const TextureImage &image = upload.image;
+    bool staged = image.staging.IsValid();
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, upload.texture.array);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staged ? buffer : 0);
+
+    uint32_t level = upload.nextLevel++;
+    if (image.cooked.isOpen())
+    {
+        const CookedImageMip &mip = image.cooked.mip(level);
+        const void *source = staged
+            ? (const void *) (uintptr_t) (image.staging.offset + (mip.offset - image.cooked.mip(0).offset))
+            : image.cooked.mipData(level);
+
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, upload.texture.layer, mip.width, mip.height, 1,
+            compressedInternalFormat(image.cooked.format()), (GLsizei) mip.size, source);
+        return mip.size;
+    }
+
+    const void *source = staged ? (const void *) (uintptr_t) image.staging.offset : image.pixels;
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, upload.texture.layer, image.width, image.height, 1,
+        uncompressedFormat(image.channelCount), GL_UNSIGNED_BYTE, source);
+    generateLayerMipmaps(upload.texture, image);
+    return (size_t) image.width * image.height * image.channelCount;
+}
+
+// budget of 0 issues everything
+void TextureStreamer::issue(size_t budget)
+{
+    if (queue.empty()) return;
+
+    // R, RG and RGB rows aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Always at least one mip, so a mip bigger than the budget still goes through
+    std::vector<StagingSlice> finished;
+    size_t issued = 0;
+    while (!queue.empty() && (budget == 0 || issued < budget))
+    {
+        Upload &upload = queue.front();
+        issued += issueLevel(upload);
+        if (upload.nextLevel < issuedLevelCount(upload.image)) continue;
+
+        // Its slice goes back to the ring once the fence below passes
+        StagingSlice slice = upload.image.TakeStaging();
+        if (slice.IsValid()) finished.push_back(slice);
+        queue.pop_front();
+        burstTextures++;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Whatever unit was active lost its array
+    TexturePool::Get().ResetBindings();
+
+    if (!finished.empty())
+    {
+        inFlight.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(finished) });
+    }
+
+    burstBytes += issued;
+    burstFrames++;
+    if (queue.empty())
+    {
+        std::cout << "Streamed " << burstTextures << " textures, " << burstBytes / (1024 * 1024) << " MB over "
+            << burstFrames << " frames\n";
+        burstTextures = 0;
+        burstBytes = 0;
+        burstFrames = 0;
+    }
+}
+
+void TextureStreamer::Update()
+{
+    retire();
+
+    float budgetMB = common::settings::TEXTURE_UPLOAD_BUDGET_MB;
+    issue(budgetMB > 0.0f ? std::max((size_t) 1, (size_t) (budgetMB * 1024.0f * 1024.0f)) : 0);
+}
+
+void TextureStreamer::Flush()
+{
+    retire();
+    issue(0);
+}
+
+bool TextureStreamer::IsPending(TextureHandle texture) const
+{
+    if (!texture.IsValid()) return false;
+
+    for (const Upload &upload : queue)
+    {
+        if (upload.texture == texture) return true;
+    }
+    return false;
+}
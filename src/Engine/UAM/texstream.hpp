@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "material.hpp"
+#include "texpool.hpp"
+
+namespace uam
+{
+    // Uploads textures a few mips per frame instead of all at once.
+    //
+    // Workers decode straight into slices of a persistently mapped pixel
+    // unpack buffer (see TextureImage::Load/LoadCooked with stage set), the GL
+    // thread only issues glTexSubImage3D calls from it into TexturePool layers, at most
+    // TEXTURE_UPLOAD_BUDGET_MB a frame. A fence after each frame's uploads
+    // hands their slices back to the ring once the GPU has read them.
+    // Images that didn't fit in the ring upload from client memory instead,
+    // under the same budget.
+    class TextureStreamer
+    {
+        // A texture whose mips haven't all been issued yet
+        struct Upload
+        {
+            TextureHandle texture;
+            TextureImage image;
+            uint32_t nextLevel = 0;
+        };
+
+        // Ring space in allocation order, so the oldest one is the tail
+        struct RingBlock
+        {
+            size_t offset;
+            size_t size;
+            bool released;
+        };
+
+        // Slices the GPU may still be reading
+        struct InFlight
+        {
+            GLsync fence;
+            std::vector<StagingSlice> slices;
+        };
+
+        GLuint buffer = 0;
+        uint8_t *mapped = nullptr;
+        size_t capacity = 0;
+
+        std::mutex ringMutex;
+        std::deque<RingBlock> blocks;
+        size_t head = 0;
+
+        // GL thread only
+        std::deque<Upload> queue;
+        std::deque<InFlight> inFlight;
+
+        // Stats of the current burst, logged when the queue drains
+        size_t burstTextures = 0;
+        size_t burstBytes = 0;
+        size_t burstFrames = 0;
+
+        size_t issueLevel(Upload &upload);
+        void issue(size_t budget);
+        void retire();
+
+    public:
+        TextureStreamer() = default;
+
+        TextureStreamer(const TextureStreamer &) = delete;
+        TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+        // GL thread, once the context exists. Maps ringBytes of unpack buffer,
+        // without ARB_buffer_storage nothing is staged and uploads read client memory.
+        void Init(size_t ringBytes);
+
+        // Any thread. Reserves bytes of the ring, an empty slice if it's full or not mapped.
+        StagingSlice Allocate(size_t bytes);
+
+        // Any thread. Hands a slice back, only for slices the GPU never read
+        void Release(const StagingSlice &slice);
+
+        // GL thread. Takes a TexturePool layer for the texture's whole mip chain
+        // and queues its pixels, consuming the image. Invalid if the image can't be uploaded.
+        // Until every mip is issued IsPending is true and its contents are undefined.
+        TextureHandle CreateTexture(const std::string &texPath, TextureImage &&image);
+
+        // GL thread. Drops the texture's queued uploads before its layer is freed.
+        void Cancel(TextureHandle texture);
+
+        // GL thread, once a frame. Recycles slices the GPU is done with
+        // and issues queued mips up to the frame budget.
+        void Update();
+
+        // GL thread. Issues everything queued, ignoring the budget
+        void Flush();
+
+        bool IsPending(TextureHandle texture) const;
+        size_t PendingCount() const { return queue.size(); }
+
+        // Engine wide instance, created on first use
+        static TextureStreamer &Get();
+    };
+}
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <map>
 
 #include <GL/glew.h>
 
@@ -61,4 +62,158 @@ namespace uam
         std::vector<PSK_Face> faces;
         std::vector<PSK_Material> materials;
     };
+
+    // Final interleaved vertex as uploaded to the GPU
+    struct CompleteVertex
+    {
+        float x;
+        float y;
+        float z;
+
+        float u;
+        float v;
+        int32_t materialIndex;
+
+        float nx;
+        float ny;
+        float nz;
+
+        // w is the bitangent sign, bitangent = cross(normal, tangent) * w
+        float tx;
+        float ty;
+        float tz;
+        float tw;
+    };
+
+    // Quantized vertex, 20 bytes.
+    // Position is unorm16 relative to the mesh bounds, UVs are half floats,
+    // the tangent frame is a snorm16 QTangent: a quaternion rotating
+    // (tangent, cross(normal, tangent), normal) with the handedness in the sign of w.
+    struct CompactVertex
+    {
+        uint16_t x;
+        uint16_t y;
+        uint16_t z;
+        uint16_t materialIndex;
+
+        uint16_t u;
+        uint16_t v;
+
+        int16_t qtangent[4];
+    };
+
+    enum class VertexFormat
+    {
+        Full,   // CompleteVertex
+        Compact // CompactVertex
+    };
+
+    enum class VertexLayout
+    {
+        Interleaved, // one stream with everything
+        Split        // positions in their own stream for depth only passes
+    };
+
+    // Split layout streams.
+    // Compact keeps the material index in the position stream's
+    // padding so the other stream is just UVs and the tangent frame.
+    struct SplitPosition
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    struct SplitAttributes
+    {
+        float u;
+        float v;
+        int32_t materialIndex;
+
+        float nx;
+        float ny;
+        float nz;
+
+        float tx;
+        float ty;
+        float tz;
+        float tw;
+    };
+
+    struct CompactSplitPosition
+    {
+        uint16_t x;
+        uint16_t y;
+        uint16_t z;
+        uint16_t materialIndex;
+    };
+
+    struct CompactSplitAttributes
+    {
+        uint16_t u;
+        uint16_t v;
+
+        int16_t qtangent[4];
+    };
+
+    // Maps unorm16 positions back to mesh space: position = quantized * scale + offset
+    struct VertexDequantization
+    {
+        float scale[3];
+        float offset[3];
+    };
+
+    // Bounding sphere in mesh space, for LOD selection
+    struct MeshBounds
+    {
+        float center[3];
+        float radius;
+    };
+
+    // Range of the index buffer drawn with one call.
+    // Indices are relative to baseVertex so they fit in 16 bits.
+    struct IndexSection
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        int32_t baseVertex;
+        uint32_t batchIndex; // material batch it belongs to
+    };
+
+    // Small cluster of triangles, a contiguous range inside one index section.
+    // Culled as a whole against the frustum (sphere) and for backfacing (cone).
+    struct Meshlet
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t section;
+
+        float center[3];
+        float radius;
+
+        // Backfacing from everywhere dot(center - camera, coneAxis) >= coneCutoff * distance + radius.
+        // coneCutoff above 1 means the normals spread too much to ever cull.
+        float coneAxis[3];
+        float coneCutoff;
+    };
+
+    // Everything a MeshAsset needs before touching GL
+    struct MeshBuildData
+    {
+        std::vector<CompleteVertex> vertices;
+        std::vector<GLuint> indices;
+        std::vector<uint32_t> materialBatchSizes;
+
+        // LODs follow LOD0 in indices and each has its own set of batches,
+        // materialBatchSizes holds lodCount * (batches per LOD) entries.
+        // lodErrors is the simplification error in mesh units, 0 for LOD0.
+        uint32_t lodCount = 1;
+        std::vector<float> lodErrors = { 0.0f };
+
+        // One [ROLE] = [TEXTURE PATH] map per material
+        std::vector<std::map<std::string, std::string>> materials;
+
+        // .mat files those came from, the cooked mesh goes stale with them
+        std::vector<std::string> materialFiles;
+    };
 }
\ No newline at end of file
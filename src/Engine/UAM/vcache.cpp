@@ -0,0 +1,252 @@
+#include <cmath>
+#include <algorithm>
+
+#include "../jobs.hpp"
+#include "meshopt.hpp"
+
+using namespace uam;
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation"
+#define VCACHE_SIZE 32
+#define VCACHE_DECAY_POWER 1.5f
+#define VCACHE_LAST_TRI_SCORE 0.75f
+#define VCACHE_VALENCE_BOOST_SCALE 2.0f
+#define VCACHE_VALENCE_BOOST_POWER 0.5f
+
+// Scores are looked up rather than recomputed with powf every time
+#define VCACHE_MAX_VALENCE 32
+
+struct VertexScoreTable
+{
+    float cache[VCACHE_SIZE];
+    float valence[VCACHE_MAX_VALENCE];
+
+    VertexScoreTable()
+    {
+        for (int i = 0; i < VCACHE_SIZE; i++)
+        {
+            if (i < 3)
+            {
+                // The last triangle's vertices get a fixed score so we
+                // don't keep picking neighbours of the one just emitted
+                cache[i] = VCACHE_LAST_TRI_SCORE;
+                continue;
+            }
+
+            float scaler = 1.0f / (VCACHE_SIZE - 3);
+            cache[i] = std::pow(1.0f - (i - 3) * scaler, VCACHE_DECAY_POWER);
+        }
+
+        valence[0] = 0.0f;
+        for (int i = 1; i < VCACHE_MAX_VALENCE; i++)
+        {
+            valence[i] = VCACHE_VALENCE_BOOST_SCALE * std::pow((float) i, -VCACHE_VALENCE_BOOST_POWER);
+        }
+    }
+};
+
+static const VertexScoreTable SCORE_TABLE;
+
+static float vertexScore(int cachePosition, uint32_t remainingValence)
+{
+    // No triangles left to use it
+    if (remainingValence == 0) return -1.0f;
+
+    float score = cachePosition >= 0 ? SCORE_TABLE.cache[cachePosition] : 0.0f;
+    score += SCORE_TABLE.valence[std::min<uint32_t>(remainingValence, VCACHE_MAX_VALENCE - 1)];
+    return score;
+}
+
+VertexCacheStats uam::analyzeVertexCache(const GLuint *indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (indexCount < 3) return stats;
+
+    // FIFO, like the hardware post transform caches these metrics model
+    std::vector<uint32_t> cacheTimestamp(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t time = cacheSize + 1;
+
+    size_t misses = 0;
+    size_t uniqueVertices = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        GLuint vertex = indices[i];
+        if (!referenced[vertex])
+        {
+            referenced[vertex] = true;
+            uniqueVertices++;
+        }
+
+        if (time - cacheTimestamp[vertex] > cacheSize)
+        {
+            cacheTimestamp[vertex] = time++;
+            misses++;
+        }
+    }
+
+    stats.acmr = (float) misses / (float) (indexCount / 3);
+    stats.atvr = uniqueVertices ? (float) misses / (float) uniqueVertices : 0.0f;
+    return stats;
+}
+
+void uam::optimizeVertexCache(GLuint *indices, size_t indexCount, size_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) return;
+
+    // Triangles touching each vertex, as offsets into one shared list
+    std::vector<uint32_t> valence(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) valence[indices[i]]++;
+
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) adjacencyStart[v + 1] = adjacencyStart[v] + valence[v];
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++) adjacency[cursor[indices[t * 3 + k]]++] = (uint32_t) t;
+        }
+    }
+
+    // valence now counts triangles not yet emitted
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) score[v] = vertexScore(-1, valence[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+
+    // LRU with room for one extra triangle while it's being inserted
+    uint32_t cache[VCACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    // Vertices we've emitted, most recent last. When the cache runs dry
+    // we restart next to one of them rather than somewhere random (Tipsify's dead-end stack)
+    std::vector<uint32_t> deadEndStack;
+    deadEndStack.reserve(triangleCount * 3);
+
+    size_t scanCursor = 0;
+    int64_t bestTriangle = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (bestTriangle < 0)
+        {
+            // Nothing in the cache has triangles left. Try the recently used
+            // vertices, then carry on from the next unemitted triangle in input
+            // order. Searching all triangles for the best score would make this quadratic.
+            while (!deadEndStack.empty())
+            {
+                uint32_t vertex = deadEndStack.back();
+                deadEndStack.pop_back();
+
+                if (valence[vertex] > 0)
+                {
+                    bestTriangle = adjacency[adjacencyStart[vertex]];
+                    break;
+                }
+            }
+
+            if (bestTriangle < 0)
+            {
+                while (emitted[scanCursor]) scanCursor++;
+                bestTriangle = (int64_t) scanCursor;
+            }
+        }
+
+        const uint32_t triangle = (uint32_t) bestTriangle;
+        emitted[triangle] = true;
+
+        uint32_t triangleVertices[3] = { indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2] };
+        output.insert(output.end(), triangleVertices, triangleVertices + 3);
+        deadEndStack.insert(deadEndStack.end(), triangleVertices, triangleVertices + 3);
+
+        // Drop the triangle from each vertex's adjacency
+        for (uint32_t vertex : triangleVertices)
+        {
+            uint32_t *begin = adjacency.data() + adjacencyStart[vertex];
+            uint32_t *end = begin + valence[vertex];
+            uint32_t *found = std::find(begin, end, triangle);
+            if (found != end)
+            {
+                std::swap(*found, *(end - 1));
+                valence[vertex]--;
+            }
+        }
+
+        // Move the triangle's vertices to the front of the cache
+        uint32_t newCache[VCACHE_SIZE + 3];
+        int newCount = 0;
+        for (uint32_t vertex : triangleVertices) newCache[newCount++] = vertex;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            uint32_t vertex = cache[i];
+            if (vertex == triangleVertices[0] || vertex == triangleVertices[1] || vertex == triangleVertices[2]) continue;
+            newCache[newCount++] = vertex;
+        }
+
+        // Whatever fell out of the cache loses its cache score
+        for (int i = VCACHE_SIZE; i < newCount; i++)
+        {
+            uint32_t vertex = newCache[i];
+            cachePosition[vertex] = -1;
+            score[vertex] = vertexScore(-1, valence[vertex]);
+        }
+
+        cacheCount = std::min(newCount, VCACHE_SIZE);
+        for (int i = 0; i < cacheCount; i++)
+        {
+            cache[i] = newCache[i];
+            cachePosition[cache[i]] = i;
+            score[cache[i]] = vertexScore(i, valence[cache[i]]);
+        }
+
+        // Rescore the triangles around the cache and pick the best one
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            uint32_t vertex = cache[i];
+            const uint32_t *begin = adjacency.data() + adjacencyStart[vertex];
+            for (uint32_t k = 0; k < valence[vertex]; k++)
+            {
+                uint32_t t = begin[k];
+                float newScore = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+                if (newScore > bestScore)
+                {
+                    bestScore = newScore;
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void uam::optimizeVertexCacheBatches(std::vector<GLuint> &indices, const std::vector<uint32_t> &materialBatchSizes, size_t vertexCount)
+{
+    // Each batch is drawn on its own, so reorder within batches only
+    std::vector<size_t> batchStart;
+    size_t offset = 0;
+    for (uint32_t batchSize : materialBatchSizes)
+    {
+        batchStart.push_back(std::min(offset, indices.size()));
+        offset += batchSize;
+    }
+    batchStart.push_back(std::min(offset, indices.size()));
+
+    JobSystem::Get().ParallelFor(0, materialBatchSizes.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t batch = begin; batch < end; batch++)
+        {
+            optimizeVertexCache(indices.data() + batchStart[batch], batchStart[batch + 1] - batchStart[batch], vertexCount);
+        }
+    });
+}
@@ -0,0 +1,148 @@
+#include <cstring>
+#include <algorithm>
+
+#include "../jobs.hpp"
+#include "meshopt.hpp"
+
+using namespace uam;
+
+// Meshes with more vertices than this are split into hash partitions
+// that are welded in parallel
+#define WELD_PARALLEL_THRESHOLD 65536
+#define WELD_PARTITION_COUNT 64
+#define WELD_GRAIN_SIZE 16384
+
+static uint32_t hashVertex(const CompleteVertex &vertex)
+{
+    // FNV-1a over the raw bytes, bit identical is what we merge on
+    uint32_t words[sizeof(CompleteVertex) / 4];
+    std::memcpy(words, &vertex, sizeof(words));
+
+    uint32_t hash = 2166136261u;
+    for (uint32_t word : words)
+    {
+        hash ^= word;
+        hash *= 16777619u;
+        hash ^= hash >> 15;
+    }
+    return hash;
+}
+
+static bool sameVertex(const CompleteVertex &a, const CompleteVertex &b)
+{
+    return std::memcmp(&a, &b, sizeof(CompleteVertex)) == 0;
+}
+
+// Points every vertex in the list at the first identical one.
+// The list is in ascending order so "first" is the lowest index.
+static void weldPartition(const CompleteVertex *vertices, const uint32_t *hashes,
+    const uint32_t *members, size_t memberCount, uint32_t *remap)
+{
+    size_t tableSize = 1;
+    while (tableSize < memberCount * 2) tableSize <<= 1;
+
+    const uint32_t EMPTY = 0xFFFFFFFFu;
+    std::vector<uint32_t> table(tableSize, EMPTY);
+    const size_t mask = tableSize - 1;
+
+    for (size_t i = 0; i < memberCount; i++)
+    {
+        uint32_t vertex = members[i];
+
+        // Partitions use the low bits of the hash, probe with the high ones
+        size_t slot = (hashes[vertex] >> 6) & mask;
+        while (true)
+        {
+            uint32_t existing = table[slot];
+            if (existing == EMPTY)
+            {
+                table[slot] = vertex;
+                remap[vertex] = vertex;
+                break;
+            }
+
+            if (hashes[existing] == hashes[vertex] && sameVertex(vertices[existing], vertices[vertex]))
+            {
+                remap[vertex] = existing;
+                break;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+}
+
+WeldResult uam::weldVertices(std::vector<CompleteVertex> &vertices, std::vector<GLuint> &indices)
+{
+    WeldResult result;
+    result.vertexCountBefore = vertices.size();
+    result.vertexCountAfter = vertices.size();
+
+    const size_t vertexCount = vertices.size();
+    if (vertexCount == 0) return result;
+
+    JobSystem &jobs = JobSystem::Get();
+    const size_t partitionCount = vertexCount > WELD_PARALLEL_THRESHOLD ? WELD_PARTITION_COUNT : 1;
+
+    std::vector<uint32_t> hashes(vertexCount);
+    jobs.ParallelFor(0, vertexCount, WELD_GRAIN_SIZE, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++) hashes[i] = hashVertex(vertices[i]);
+    });
+
+    // Bucket vertex indices by partition, keeping them in ascending order
+    std::vector<uint32_t> partitionStart(partitionCount + 1, 0);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        partitionStart[(hashes[i] % partitionCount) + 1]++;
+    }
+    for (size_t p = 0; p < partitionCount; p++)
+    {
+        partitionStart[p + 1] += partitionStart[p];
+    }
+
+    std::vector<uint32_t> members(vertexCount);
+    std::vector<uint32_t> cursor(partitionStart.begin(), partitionStart.end() - 1);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        members[cursor[hashes[i] % partitionCount]++] = (uint32_t) i;
+    }
+
+    // Partitions never share a vertex so they can be welded independently
+    std::vector<uint32_t> remap(vertexCount);
+    jobs.ParallelFor(0, partitionCount, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t p = begin; p < end; p++)
+        {
+            weldPartition(vertices.data(), hashes.data(), members.data() + partitionStart[p],
+                partitionStart[p + 1] - partitionStart[p], remap.data());
+        }
+    });
+
+    // Compact the survivors in their original order
+    std::vector<uint32_t> newIndex(vertexCount);
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        if (remap[i] == i)
+        {
+            newIndex[i] = (uint32_t) uniqueCount;
+            vertices[uniqueCount++] = vertices[i];
+        }
+    }
+
+    result.vertexCountAfter = uniqueCount;
+    if (uniqueCount == vertexCount) return result;
+
+    vertices.resize(uniqueCount);
+
+    jobs.ParallelFor(0, indices.size(), WELD_GRAIN_SIZE, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            indices[i] = newIndex[remap[indices[i]]];
+        }
+    });
+
+    return result;
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+
+#include "jobs.hpp"
+
+// Which system and queue the current thread works for, -1 off the pool
+static thread_local JobSystem *currentSystem = nullptr;
+static thread_local int currentWorker = -1;
+
+JobSystem::JobSystem(int workerCount)
+{
+    mainThreadId = std::this_thread::get_id();
+
+    if (workerCount < 0)
+    {
+        int hardwareThreads = (int) std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        queues.push_back(new WorkerQueue);
+    }
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCondition.notify_all();
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    for (WorkerQueue *queue : queues)
+    {
+        delete queue;
+    }
+}
+
+JobSystem &JobSystem::Get()
+{
+    static JobSystem system;
+    return system;
+}
+
+/*************************** SCHEDULING ***************************/
+
+void JobSystem::enqueue(Job job, JobAffinity affinity)
+{
+    if (affinity == JobAffinity::MainThread || queues.empty())
+    {
+        std::lock_guard<std::mutex> lock(mainQueueMutex);
+        mainQueue.push_back(std::move(job));
+        return;
+    }
+
+    // Workers push onto their own deque, everyone else spreads jobs around
+    size_t queueIndex;
+    if (currentSystem == this && currentWorker >= 0)
+    {
+        queueIndex = (size_t) currentWorker;
+    }
+    else
+    {
+        queueIndex = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->jobs.push_back(std::move(job));
+    }
+
+    queuedJobs.fetch_add(1, std::memory_order_release);
+
+    // Taking the lock orders this against a worker about to sleep
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+bool JobSystem::popJob(Job &job)
+{
+    if (queues.empty()) return false;
+
+    // Own work first, newest first while it's still in cache
+    size_t start = 0;
+    if (currentSystem == this && currentWorker >= 0)
+    {
+        WorkerQueue *own = queues[(size_t) currentWorker];
+        std::lock_guard<std::mutex> lock(own->mutex);
+        if (!own->jobs.empty())
+        {
+            job = std::move(own->jobs.back());
+            own->jobs.pop_back();
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        start = (size_t) currentWorker + 1;
+    }
+
+    // Steal the oldest job from someone else
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        WorkerQueue *victim = queues[(start + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->jobs.empty())
+        {
+            job = std::move(victim->jobs.front());
+            victim->jobs.pop_front();
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool JobSystem::popMainJob(Job &job)
+{
+    std::lock_guard<std::mutex> lock(mainQueueMutex);
+    if (mainQueue.empty()) return false;
+
+    job = std::move(mainQueue.front());
+    mainQueue.pop_front();
+    return true;
+}
+
+void JobSystem::execute(Job &job)
+{
+    job.function();
+    finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter *counter)
+{
+    if (!counter) return;
+
+    // The counter can die as soon as Wait sees zero, so the last job drops it
+    // and takes the continuations under the lock Wait goes through before returning.
+    // Nothing touches the counter after the unlock.
+    std::vector<JobCounter::Continuation> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->continuationMutex);
+        if (counter->count.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        // Last job of the group, release anything waiting on it
+        ready.swap(counter->continuations);
+    }
+
+    for (JobCounter::Continuation &continuation : ready)
+    {
+        // Already counted when RunAfter was called
+        enqueue({ std::move(continuation.function), continuation.counter }, continuation.affinity);
+    }
+}
+
+void JobSystem::workerLoop(size_t workerIndex)
+{
+    currentSystem = this;
+    currentWorker = (int) workerIndex;
+
+    while (true)
+    {
+        Job job;
+        if (popJob(job))
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this]()
+        {
+            return stopping.load() || queuedJobs.load(std::memory_order_acquire) > 0;
+        });
+
+        if (stopping && queuedJobs.load() <= 0) return;
+    }
+}
+
+/*************************** PUBLIC API ***************************/
+
+void JobSystem::Run(JobFunction function, JobCounter *counter, JobAffinity affinity)
+{
+    if (counter) counter->count.fetch_add(1, std::memory_order_relaxed);
+    enqueue({ std::move(function), counter }, affinity);
+}
+
+void JobSystem::RunAfter(JobCounter &dependency, JobFunction function, JobCounter *counter, JobAffinity affinity)
+{
+    if (counter) counter->count.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(dependency.continuationMutex);
+        if (!dependency.IsDone())
+        {
+            dependency.continuations.push_back({ std::move(function), counter, affinity });
+            return;
+        }
+    }
+
+    enqueue({ std::move(function), counter }, affinity);
+}
+
+void JobSystem::Wait(JobCounter &counter)
+{
+    bool onMainThread = IsMainThread();
+
+    while (!counter.IsDone())
+    {
+        Job job;
+        if (onMainThread && popMainJob(job))
+        {
+            execute(job);
+            continue;
+        }
+
+        if (popJob(job))
+        {
+            execute(job);
+            continue;
+        }
+
+        std::this_thread::yield();
+    }
+
+    // Whoever dropped it to zero may still be in finish, wait it out
+    // so the caller can destroy the counter
+    std::lock_guard<std::mutex> lock(counter.continuationMutex);
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &function)
+{
+    if (begin >= end) return;
+    if (grainSize == 0) grainSize = 1;
+
+    // Not worth a round trip through the queues
+    if (end - begin <= grainSize)
+    {
+        function(begin, end);
+        return;
+    }
+
+    JobCounter counter;
+    for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+    {
+        size_t chunkEnd = std::min(end, chunkBegin + grainSize);
+        Run([&function, chunkBegin, chunkEnd]() { function(chunkBegin, chunkEnd); }, &counter);
+    }
+
+    Wait(counter);
+}
+
+size_t JobSystem::RunMainThreadJobs(size_t maxJobs)
+{
+    size_t ran = 0;
+
+    Job job;
+    while (ran < maxJobs && popMainJob(job))
+    {
+        execute(job);
+        ran++;
+    }
+
+    return ran;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <stdint.h>
+
+enum class JobAffinity
+{
+    Any,
+    MainThread // GL work, only ever runs inside RunMainThreadJobs or Wait on the main thread
+};
+
+class JobSystem;
+
+// Tracks a group of jobs. Jobs started with a counter bump it and drop it
+// again when they finish, other jobs can be held back until it hits zero.
+class JobCounter
+{
+    friend class JobSystem;
+
+    struct Continuation
+    {
+        std::function<void()> function;
+        JobCounter *counter;
+        JobAffinity affinity;
+    };
+
+    std::atomic<int64_t> count{0};
+
+    std::mutex continuationMutex;
+    std::vector<Continuation> continuations;
+
+public:
+    bool IsDone() const { return count.load(std::memory_order_acquire) == 0; }
+};
+
+// Work stealing scheduler. Each worker owns a deque, pops its own work
+// from the back and steals from the front of the others when it runs dry.
+class JobSystem
+{
+public:
+    typedef std::function<void()> JobFunction;
+
+private:
+    struct Job
+    {
+        JobFunction function;
+        JobCounter *counter;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<WorkerQueue *> queues;
+
+    std::mutex mainQueueMutex;
+    std::deque<Job> mainQueue;
+    std::thread::id mainThreadId;
+
+    // Sleeping workers wake when queuedJobs goes above zero
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<int64_t> queuedJobs{0};
+    std::atomic<bool> stopping{false};
+
+    std::atomic<uint32_t> nextQueue{0};
+
+    void workerLoop(size_t workerIndex);
+    void enqueue(Job job, JobAffinity affinity);
+    bool popJob(Job &job);
+    bool popMainJob(Job &job);
+    void execute(Job &job);
+    void finish(JobCounter *counter);
+
+public:
+    // -1 means one worker per hardware thread minus the main thread,
+    // 0 runs everything on the main thread inside Wait.
+    // The thread constructing the system is the main thread.
+    JobSystem(int workerCount = -1);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    void Run(JobFunction function, JobCounter *counter = nullptr, JobAffinity affinity = JobAffinity::Any);
+
+    // Starts the job only after dependency reaches zero
+    void RunAfter(JobCounter &dependency, JobFunction function, JobCounter *counter = nullptr, JobAffinity affinity = JobAffinity::Any);
+
+    // Executes other jobs until the counter reaches zero
+    void Wait(JobCounter &counter);
+
+    // Splits [begin, end) into chunks of at most grainSize and
+    // blocks until every chunk has run
+    void ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &function);
+
+    // Main thread only, runs queued GL jobs. Returns how many ran.
+    size_t RunMainThreadJobs(size_t maxJobs = SIZE_MAX);
+
+    size_t WorkerCount() const { return workers.size(); }
+    bool IsMainThread() const { return std::this_thread::get_id() == mainThreadId; }
+
+    // Engine wide instance, created on first use
+    static JobSystem &Get();
+};
@@ -1,8 +1,11 @@
 #include <glm.hpp>
 #include <string>
+#include <chrono>
 #include <iostream>
+#include <algorithm>
 
 #include "shader.hpp"
+#include "jobs.hpp"
 #include "UAM/mesh.hpp"
 
 #include "model.hpp"
@@ -16,6 +19,19 @@ Model::Model()
 
 Model::~Model()
 {
+    // Workers still hold on to this model until they've queued their result
+    std::vector<PendingUpload> uploads;
+    {
+        std::unique_lock<std::mutex> lock(uploadMutex);
+        uploadCondition.wait(lock, [this]() { return pendingLoads == 0; });
+        uploads.swap(uploadQueue);
+    }
+
+    for (PendingUpload &upload : uploads)
+    {
+        delete upload.prepared;
+    }
+
     for (uam::MeshAsset *mesh : meshes)
     {
         delete mesh;
@@ -34,6 +50,40 @@ void Model::Draw(ShaderProgram &shader)
     }
 }
 
+void Model::Draw(ShaderProgram &shader, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, float viewportHeight)
+{
+    shader.setMat4("modelMatrix", modelMatrix);
+
+    glm::mat4 modelViewMatrix = viewMatrix * modelMatrix;
+    float pixelsPerUnit = projectionMatrix[1][1] * viewportHeight * 0.5f;
+    // Cones are built from cross(b - a, c - a), the same side GL_CCW calls front
+    bool cullBackfaces = common::settings::MESHLET_CONE_CULLING;
+    uam::CullView view = uam::makeCullView(modelViewMatrix, projectionMatrix, cullBackfaces);
+    if (cullBackfaces)
+    {
+        glEnable(GL_CULL_FACE);
+        glFrontFace(GL_CCW);
+    }
+
+    for (uam::MeshAsset *mesh : meshes)
+    {
+        uint32_t lod = mesh->SelectLod(modelViewMatrix, pixelsPerUnit);
+        if (common::settings::MESHLET_CULLING) mesh->Draw(shader, lod, view);
+        else mesh->Draw(shader, lod);
+    }
+
+    if (cullBackfaces) glDisable(GL_CULL_FACE);
+}
+
+void Model::DrawPositions(ShaderProgram &shader)
+{
+    shader.setMat4("modelMatrix", modelMatrix);
+    for (uam::MeshAsset *mesh : meshes)
+    {
+        mesh->DrawPositions(shader);
+    }
+}
+
 void Model::AddMesh(std::string pskPath)
 {
     uam::MeshAsset *mesh = new uam::MeshAsset(pskPath); 
@@ -41,4 +91,96 @@ void Model::AddMesh(std::string pskPath)
 
     meshes.push_back(mesh);
     return;
-}
\ No newline at end of file
+}
+
+void Model::AddMeshAsync(std::string pskPath)
+{
+    // Take the slot now so draw order matches call order
+    uam::MeshAsset *mesh = new uam::MeshAsset(pskPath);
+    meshes.push_back(mesh);
+
+    {
+        std::lock_guard<std::mutex> lock(uploadMutex);
+        pendingLoads++;
+    }
+
+    // Textures already up need no decoding, anything released before
+    // the upload is decoded then
+    std::set<std::string> registeredTextures = uam::registeredTexturePaths();
+
+    JobSystem::Get().Run([this, mesh, pskPath, registeredTextures]()
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        uam::PreparedMesh *prepared = new uam::PreparedMesh;
+        try
+        {
+            uam::prepareMesh(pskPath, *prepared, mesh->Format(), mesh->Layout(), &registeredTextures);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Failed to load mesh " << pskPath << ": " << e.what() << "\n";
+            delete prepared;
+            prepared = nullptr;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        std::cout << "Prepared " << pskPath << " in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+
+        // Notify while still locked, ~Model can destroy the condition
+        // as soon as it sees pendingLoads hit zero
+        std::lock_guard<std::mutex> lock(uploadMutex);
+        uploadQueue.push_back({ mesh, prepared });
+        pendingLoads--;
+        uploadCondition.notify_all();
+    });
+}
+
+void Model::uploadPending(std::vector<PendingUpload> &uploads)
+{
+    for (PendingUpload &upload : uploads)
+    {
+        if (!upload.prepared)
+        {
+            meshes.erase(std::remove(meshes.begin(), meshes.end(), upload.mesh), meshes.end());
+            delete upload.mesh;
+            continue;
+        }
+
+        upload.mesh->Upload(*upload.prepared);
+        delete upload.prepared;
+    }
+}
+
+bool Model::ProcessUploads()
+{
+    std::vector<PendingUpload> uploads;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(uploadMutex);
+        uploads.swap(uploadQueue);
+        done = pendingLoads == 0;
+    }
+
+    uploadPending(uploads);
+    return done;
+}
+
+void Model::WaitForMeshes()
+{
+    while (true)
+    {
+        std::vector<PendingUpload> uploads;
+        bool done;
+        {
+            std::unique_lock<std::mutex> lock(uploadMutex);
+            uploadCondition.wait(lock, [this]() { return pendingLoads == 0 || !uploadQueue.empty(); });
+            uploads.swap(uploadQueue);
+            done = pendingLoads == 0;
+        }
+
+        uploadPending(uploads);
+        if (done) return;
+    }
+}
@@ -2,14 +2,30 @@
 
 #include <vector>
 #include <string>
+#include <mutex>
+#include <condition_variable>
 
 #include <glm.hpp>
 
-namespace uam { class MeshAsset; }
+namespace uam { class MeshAsset; struct PreparedMesh; }
 class ShaderProgram;
 
 class Model
 {
+    // A mesh whose CPU side work finished on a worker
+    // and is waiting for the GL thread to upload it
+    struct PendingUpload
+    {
+        uam::MeshAsset *mesh;
+        uam::PreparedMesh *prepared; // nullptr if loading failed
+    };
+
+    std::mutex uploadMutex;
+    std::condition_variable uploadCondition;
+    std::vector<PendingUpload> uploadQueue;
+    size_t pendingLoads = 0;
+
+    void uploadPending(std::vector<PendingUpload> &uploads);
 
 public:
     glm::mat4 modelMatrix;
@@ -18,6 +34,26 @@ public:
     Model();
     ~Model();
 
+    // Loads and uploads on the calling (GL) thread
     void AddMesh(std::string pskPath);
+
+    // Parses, builds and decodes textures on the job system.
+    // The mesh draws once ProcessUploads has uploaded it.
+    void AddMeshAsync(std::string pskPath);
+
+    // GL thread only. Uploads every mesh that finished loading
+    // and returns true once nothing is outstanding.
+    bool ProcessUploads();
+
+    // GL thread only. Blocks, uploading as meshes finish, until all are loaded.
+    void WaitForMeshes();
+
+    // Full detail
     void Draw(ShaderProgram &shader);
-};
\ No newline at end of file
+
+    // Picks each mesh's LOD from how big it ends up on screen
+    void Draw(ShaderProgram &shader, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, float viewportHeight);
+
+    // For depth, shadow and picking passes, binds no materials
+    void DrawPositions(ShaderProgram &shader);
+};
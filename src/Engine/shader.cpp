@@ -80,12 +80,16 @@ ShaderProgram::ShaderProgram(const std::string &vertPath, const std::string &fra
     glDeleteShader(fragShader);
 
     // Set up texture locations
-    GLint texLocation = glGetUniformLocation(programID, "otherTextures");
-    GLint texIndices[15] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    glUniform1iv(texLocation, 16, texIndices);
+    // Units 0-2 are diffuse/normal/specpower, the rest of the guaranteed 16 go to otherTextures
+    glUseProgram(programID);
 
-    GLint texArrayLocation = glGetUniformLocation(programID, "mainTextureArray");
-    glUniform1i(texArrayLocation, 0);
+    glUniform1i(glGetUniformLocation(programID, "diffuseTexture"), 0);
+    glUniform1i(glGetUniformLocation(programID, "normalTexture"), 1);
+    glUniform1i(glGetUniformLocation(programID, "specPowerTexture"), 2);
+
+    GLint texLocation = glGetUniformLocation(programID, "otherTextures");
+    GLint texIndices[13] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    glUniform1iv(texLocation, 13, texIndices);
 
 }
 
@@ -8,8 +8,11 @@
 #include <gtc/type_ptr.hpp>
 
 #include "Engine/camera.hpp"
+#include "Engine/jobs.hpp"
 #include "Engine/model.hpp"
 #include "Engine/shader.hpp"
+#include "Engine/UAM/texstream.hpp"
+#include "Common/settings.hpp"
 
 const int WINDOW_WIDTH = 1920;
 const int WINDOW_HEIGHT = 1080;
@@ -57,6 +60,13 @@ int main()
 
     /******************** END WINDOW INITIALIZATION  ********************/
 
+    // Start the workers here so this thread owns main thread (GL) jobs
+    JobSystem &jobs = JobSystem::Get();
+
+    // Before any loading, workers decode textures straight into it
+    uam::TextureStreamer &textureStreamer = uam::TextureStreamer::Get();
+    textureStreamer.Init((size_t) common::settings::TEXTURE_STAGING_RING_MB * 1024 * 1024);
+
     // View and projection matrices
     Camera camera = Camera(-90.0f, 0.0f, glm::vec3(0.0f, 50.0f, 150.0f));    
     glm::mat4 projectionMatrix = glm::perspective(glm::radians(45.0f), (float) WINDOW_WIDTH / (float) WINDOW_HEIGHT, 0.1f, 1000.0f);
@@ -76,11 +86,15 @@ int main()
     SDL_Event e;
 
     // Test Model
+    // Parts load in parallel and pop in as they finish uploading
+    Uint64 loadStart = SDL_GetTicks();
+    bool modelLoading = true;
+
     Model hwoModel;
-    hwoModel.AddMesh(std::string("assets/Game/Character/Item/Meshes/hwo/Face/hwo_fac/Meshes/SK_CH_hwo_fac.psk"));
-    hwoModel.AddMesh(std::string("assets/Game/Character/Item/Meshes/hwo/Hair/hwo_har_1p/Meshes/SK_CH_hwo_har_1p.psk"));
-    hwoModel.AddMesh(std::string("assets/Game/Character/Item/Meshes/hwo/Lower/hwo_bdl_taekwondo/Meshes/SK_CH_hwo_bdl_taekwondo.psk"));
-    hwoModel.AddMesh(std::string("assets/Game/Character/Item/Meshes/hwo/Upper/hwo_bdu_1p/Meshes/SK_CH_hwo_bdu_1p.psk"));
+    hwoModel.AddMeshAsync(std::string("assets/Game/Character/Item/Meshes/hwo/Face/hwo_fac/Meshes/SK_CH_hwo_fac.psk"));
+    hwoModel.AddMeshAsync(std::string("assets/Game/Character/Item/Meshes/hwo/Hair/hwo_har_1p/Meshes/SK_CH_hwo_har_1p.psk"));
+    hwoModel.AddMeshAsync(std::string("assets/Game/Character/Item/Meshes/hwo/Lower/hwo_bdl_taekwondo/Meshes/SK_CH_hwo_bdl_taekwondo.psk"));
+    hwoModel.AddMeshAsync(std::string("assets/Game/Character/Item/Meshes/hwo/Upper/hwo_bdu_1p/Meshes/SK_CH_hwo_bdu_1p.psk"));
 
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     // Main loop start
@@ -114,10 +128,19 @@ int main()
             }
         }
 
+        jobs.RunMainThreadJobs();
+        textureStreamer.Update();
+
+        if (modelLoading && hwoModel.ProcessUploads())
+        {
+            modelLoading = false;
+            std::cout << "Model loaded in " << SDL_GetTicks() - loadStart << " ms\n";
+        }
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glm::mat4 viewMatrix = camera.getView();
         meshShader.setMat4("viewMatrix", viewMatrix);
-        hwoModel.Draw(meshShader);
+        hwoModel.Draw(meshShader, viewMatrix, projectionMatrix, (float) WINDOW_HEIGHT);
         SDL_GL_SwapWindow(window);
     }
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+// Cooks the block compressed mip chains (.ctex) of every texture the given
+// meshes use, so the viewer never has to on first launch. Every texture is
+// its own job and each one spreads its mips and blocks over the pool too.
+//
+// Usage: texture-cooker [-f] [-q quality] [-bc7] [file.psk | directory]...
+// With no paths given the asset directory is scanned for .psk files.
+// Textures whose cooked file is up to date, and was cooked with the same
+// quality and -bc7, are skipped unless -f is given.
+// quality is 0 fast, 1 normal, 2 high, -bc7 cooks color textures as BC7.
+// Run from the same directory as the viewer, texture paths are relative to it.
+
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <filesystem>
+#include <stdexcept>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <string>
+
+#include "../src/Common/settings.hpp"
+#include "../src/Common/util.hpp"
+#include "../src/Engine/jobs.hpp"
+#include "../src/Engine/UAM/psk.hpp"
+#include "../src/Engine/UAM/mesh.hpp"
+#include "../src/Engine/UAM/texcache.hpp"
+
+using namespace uam;
+
+int main(int argc, char **argv)
+{
+    bool force = false;
+    std::vector<std::string> roots;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-f") == 0)
+        {
+            force = true;
+            continue;
+        }
+        if (std::strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+        {
+            common::settings::TEXTURE_COOK_QUALITY = (unsigned) std::max(0, std::atoi(argv[++i]));
+            continue;
+        }
+        if (std::strcmp(argv[i], "-bc7") == 0)
+        {
+            common::settings::COLOR_TEXTURES_BC7 = true;
+            continue;
+        }
+        roots.push_back(argv[i]);
+    }
+
+    if (roots.empty()) roots.push_back(common::settings::ASSET_DIR);
+
+    std::vector<std::string> meshes;
+    for (const std::string &root : roots)
+    {
+        if (std::filesystem::is_directory(root))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".psk")
+                {
+                    meshes.push_back(entry.path().generic_string());
+                }
+            }
+        }
+        else if (std::filesystem::is_regular_file(root))
+        {
+            meshes.push_back(root);
+        }
+    }
+
+    if (meshes.empty())
+    {
+        std::cout << "No .psk files found\n";
+        return 1;
+    }
+
+    // Only the material names are needed, so the meshes are never decoded
+    std::map<std::string, TextureUsage> textures;
+    for (const std::string &pskPath : meshes)
+    {
+        PSK_MappedMesh mesh;
+        if (!mesh.open(pskPath))
+        {
+            std::cout << "Skipping unreadable mesh: " << pskPath << "\n";
+            continue;
+        }
+
+        std::vector<std::string> materialNames;
+        for (const PSK_RawMaterial &material : mesh.materials)
+        {
+            std::string name(material.name, sizeof(material.name));
+            rtrim(name);
+            materialNames.push_back(name);
+        }
+
+        try
+        {
+            for (const auto &material : resolveMeshMaterials(pskPath, materialNames))
+            {
+                for (const auto &texture : material)
+                {
+                    textures.emplace(texture.second, textureUsageForRole(texture.first));
+                }
+            }
+        }
+        catch (const std::exception &error)
+        {
+            std::cout << "Skipping mesh with missing material files: " << pskPath << " (" << error.what() << ")\n";
+        }
+    }
+
+    std::vector<const std::pair<const std::string, TextureUsage> *> pending;
+    for (const auto &texture : textures)
+    {
+        if (force || !isCookedImageFresh(texture.first, texture.second)) pending.push_back(&texture);
+    }
+
+    std::cout << meshes.size() << " meshes, " << textures.size() << " textures, "
+        << pending.size() << " to cook\n";
+
+    auto start = std::chrono::steady_clock::now();
+
+    JobSystem &jobs = JobSystem::Get();
+    JobCounter counter;
+    std::atomic<size_t> failed{0};
+    for (const auto *texture : pending)
+    {
+        jobs.Run([texture, &failed]()
+        {
+            if (!cookImage(texture->first, texture->second)) failed++;
+        }, &counter);
+    }
+    jobs.Wait(counter);
+
+    auto end = std::chrono::steady_clock::now();
+
+    uint64_t sourceBytes = 0;
+    uint64_t cookedBytes = 0;
+    for (const auto *texture : pending)
+    {
+        std::error_code error;
+        uint64_t source = std::filesystem::file_size(texture->first, error);
+        if (error) continue;
+        uint64_t cooked = std::filesystem::file_size(cookedImagePath(texture->first), error);
+        if (error) continue;
+
+        sourceBytes += source;
+        cookedBytes += cooked;
+    }
+
+    std::cout << "\nCooked " << pending.size() - failed << " textures in "
+        << std::chrono::duration<double, std::milli>(end - start).count() << " ms on "
+        << jobs.WorkerCount() + 1 << " threads, " << sourceBytes << " -> " << cookedBytes << " bytes";
+    if (failed) std::cout << ", " << failed << " failed";
+    std::cout << "\n";
+
+    return failed ? 2 : 0;
+}